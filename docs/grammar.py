@@ -13,7 +13,8 @@ Name <- [a-zA-Z] [a-zA-Z0-9_]*
 RuleSet <- Comment* (Rule Comment*)* EndOfInput
 Rule <- Name "<-" Expression (Comment / EndOfLine)
 Expression <- Sequence ("/" Sequence)*
-Sequence <- Prefix*
+Sequence <- (Prefix / Cut)*
+Cut <- "^"
 Prefix <- ("&" / "!")? Suffix
 Suffix <- Primary ("*" / "+" / "?")?
 Primary <- Group / Name / Literal / Bracket / AnyChar
@@ -0,0 +1,44 @@
+"""
+Rules for generating C++ parsers from kero_peg grammars.
+"""
+
+def peg_cc_library(name, grammar, namespace, deps = [], **kwargs):
+    """Generates `<name>.h` and `<name>.cc` from `grammar` and builds them.
+
+    For each rule `Name` of the grammar, the header declares
+    `ParseName(std::string_view input, size_t max_depth)` in `namespace`.
+    See src/internal/codegen.h.
+
+    Args:
+        name: Name of the cc_library, and of the generated files.
+        grammar: The grammar file.
+        namespace: C++ namespace of the generated code, e.g. `my::grammar`.
+        deps: Extra deps of the cc_library.
+        **kwargs: Passed to the cc_library.
+    """
+    header = name + ".h"
+    source = name + ".cc"
+    package = native.package_name()
+    include = package + "/" + header if package else header
+    native.genrule(
+        name = name + "_codegen",
+        srcs = [grammar],
+        outs = [header, source],
+        cmd = " ".join([
+            "$(location //:kero_peg_codegen)",
+            "--grammar=$(location " + grammar + ")",
+            "--header=$(location " + header + ")",
+            "--source=$(location " + source + ")",
+            "--namespace=" + namespace,
+            "--include=" + include,
+        ]),
+        tools = ["//:kero_peg_codegen"],
+    )
+    native.cc_library(
+        name = name,
+        srcs = [source],
+        hdrs = [header],
+        copts = ["-std=c++20"],
+        deps = ["//:kero_peg"] + deps,
+        **kwargs
+    )
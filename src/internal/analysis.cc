@@ -0,0 +1,291 @@
+#include "./analysis.h"
+
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+auto GetAllBytes() noexcept -> LookaheadSet {
+  LookaheadSet bytes;
+  bytes.set();
+  bytes.reset(kEndOfInput);
+  return bytes;
+}
+
+auto GetAllLookaheads() noexcept -> LookaheadSet {
+  LookaheadSet lookaheads;
+  lookaheads.set();
+  return lookaheads;
+}
+
+// Bytes `expression` surely matches, for a single-byte terminal; empty for
+// anything else.
+auto GetSingleByteSet(const ast::Node& expression) noexcept -> LookaheadSet {
+  return ast::Visit(expression, [](const auto& node) noexcept {
+    using T = std::decay_t<decltype(node)>;
+    LookaheadSet bytes;
+    if constexpr (std::is_same_v<T, ast::QuotedTerminal>) {
+      if (node.GetValue().size() == 1) {
+        bytes.set(static_cast<unsigned char>(node.GetValue()[0]));
+      }
+    } else if constexpr (std::is_same_v<T, ast::BracketedTerminal>) {
+      for (size_t byte{}; byte < 256; ++byte) {
+        bytes[byte] = node.GetCharClass().Contains(static_cast<char>(byte));
+      }
+    } else if constexpr (std::is_same_v<T, ast::AnyCharacter>) {
+      bytes = GetAllBytes();
+    } else if constexpr (std::is_same_v<T, ast::Group>) {
+      bytes = GetSingleByteSet(*node.GetExpression());
+    }
+    return bytes;
+  });
+}
+
+// Appends the rules `expression` calls anywhere in it.
+auto AddCalls(const ast::RuleSet& rule_set, const ast::Node& expression,
+              std::vector<uint32_t>& calls) noexcept -> void {
+  ast::Visit(expression, [&rule_set, &calls](const auto& node) noexcept {
+    using T = std::decay_t<decltype(node)>;
+    if constexpr (std::is_same_v<T, ast::Sequence>) {
+      for (const auto child : node.GetExpressions()) {
+        AddCalls(rule_set, *child, calls);
+      }
+    } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+      for (const auto child : node.GetAlternatives()) {
+        AddCalls(rule_set, *child, calls);
+      }
+    } else if constexpr (std::is_same_v<T, ast::NonTerminal>) {
+      calls.push_back(rule_set.GetRuleIndex(node.GetSymbol()));
+    } else if constexpr (requires { node.GetExpression(); } &&
+                         !std::is_same_v<T, ast::Rule>) {
+      AddCalls(rule_set, *node.GetExpression(), calls);
+    }
+  });
+}
+
+// Calls `update` on rules until it returns false for every one. A rule is
+// revisited only after `update` changed one it calls, so a fixed point costs
+// the number of changes rather than sweeps times rules.
+template <typename Update>
+auto SolveFixedPoint(const std::vector<std::vector<uint32_t>>& callers,
+                     Update&& update) noexcept -> void {
+  // Popped from the back, so the last rules, which top-down grammars call
+  // rather than the other way around, settle first.
+  std::vector<uint32_t> worklist(callers.size());
+  std::iota(worklist.begin(), worklist.end(), uint32_t{});
+  std::vector<bool> queued(callers.size(), true);
+  while (!worklist.empty()) {
+    const auto rule = worklist.back();
+    worklist.pop_back();
+    queued[rule] = false;
+    if (!update(rule)) {
+      continue;
+    }
+
+    for (const auto caller : callers[rule]) {
+      if (!queued[caller]) {
+        queued[caller] = true;
+        worklist.push_back(caller);
+      }
+    }
+  }
+}
+
+} // namespace
+
+GrammarAnalysis::GrammarAnalysis(const ast::RuleSet& rule_set) noexcept
+    : rule_set_{rule_set}, nullable_(rule_set.GetRules().size(), false),
+      first_sets_(rule_set.GetRules().size()) {
+  const auto rules = rule_set.GetRules();
+  std::vector<std::vector<uint32_t>> callers(rules.size());
+  std::vector<uint32_t> calls;
+  for (uint32_t i{}; i < rules.size(); ++i) {
+    const auto& rule = static_cast<const ast::Rule&>(*rules[i]);
+    calls.clear();
+    AddCalls(rule_set, *rule.GetExpression(), calls);
+    for (const auto callee : calls) {
+      callers[callee].push_back(i);
+    }
+  }
+
+  // Rules only ever become nullable, so iterate to the fixed point.
+  SolveFixedPoint(callers, [this, rules](const uint32_t i) noexcept {
+    const auto& rule = static_cast<const ast::Rule&>(*rules[i]);
+    if (nullable_[i] || !IsNullable(*rule.GetExpression())) {
+      return false;
+    }
+    nullable_[i] = true;
+    return true;
+  });
+
+  // Likewise first sets only grow: every operator is monotonic in the sets
+  // of its operands, and `!e` only looks at single-byte terminals.
+  SolveFixedPoint(callers, [this, rules](const uint32_t i) noexcept {
+    const auto& rule = static_cast<const ast::Rule&>(*rules[i]);
+    auto first_set = GetFirstSet(*rule.GetExpression());
+    if (first_set == first_sets_[i]) {
+      return false;
+    }
+    first_sets_[i] = first_set;
+    return true;
+  });
+}
+
+auto GrammarAnalysis::IsNullable(const ast::Node& expression) const noexcept
+    -> bool {
+  return ast::Visit(expression, [this](const auto& node) noexcept -> bool {
+    using T = std::decay_t<decltype(node)>;
+    if constexpr (std::is_same_v<T, ast::Sequence>) {
+      for (const auto child : node.GetExpressions()) {
+        if (!IsNullable(*child)) {
+          return false;
+        }
+      }
+      return true;
+    } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+      for (const auto child : node.GetAlternatives()) {
+        if (IsNullable(*child)) {
+          return true;
+        }
+      }
+      return false;
+    } else if constexpr (std::is_same_v<T, ast::OneOrMore> ||
+                         std::is_same_v<T, ast::Group>) {
+      return IsNullable(*node.GetExpression());
+    } else if constexpr (std::is_same_v<T, ast::NonTerminal>) {
+      return nullable_[rule_set_.GetRuleIndex(node.GetSymbol())];
+    } else if constexpr (std::is_same_v<T, ast::QuotedTerminal>) {
+      return node.GetValue().empty();
+    } else if constexpr (std::is_same_v<T, ast::BracketedTerminal> ||
+                         std::is_same_v<T, ast::AnyCharacter> ||
+                         std::is_same_v<T, ast::RuleSet> ||
+                         std::is_same_v<T, ast::Rule>) {
+      return false;
+    } else {
+      // ZeroOrMore, Optional, the predicates and Cut.
+      return true;
+    }
+  });
+}
+
+auto GrammarAnalysis::GetFirstSet(const ast::Node& expression) const noexcept
+    -> FirstSet {
+  return ast::Visit(expression, [this](const auto& node) noexcept {
+    using T = std::decay_t<decltype(node)>;
+    FirstSet first_set;
+    if constexpr (std::is_same_v<T, ast::Sequence>) {
+      // Later expressions can start the match while earlier ones are empty.
+      first_set.empty = GetAllLookaheads();
+      for (const auto child : node.GetExpressions()) {
+        const auto child_set = GetFirstSet(*child);
+        first_set.consuming |= first_set.empty & child_set.consuming;
+        first_set.empty &= child_set.empty;
+      }
+    } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+      for (const auto child : node.GetAlternatives()) {
+        const auto child_set = GetFirstSet(*child);
+        first_set.consuming |= child_set.consuming;
+        first_set.empty |= child_set.empty;
+      }
+    } else if constexpr (std::is_same_v<T, ast::ZeroOrMore> ||
+                         std::is_same_v<T, ast::Optional>) {
+      first_set.consuming = GetFirstSet(*node.GetExpression()).consuming;
+      first_set.empty = GetAllLookaheads();
+    } else if constexpr (std::is_same_v<T, ast::OneOrMore> ||
+                         std::is_same_v<T, ast::Group>) {
+      first_set = GetFirstSet(*node.GetExpression());
+    } else if constexpr (std::is_same_v<T, ast::AndPredicate>) {
+      first_set.empty = GetFirstSet(*node.GetExpression()).GetStart();
+    } else if constexpr (std::is_same_v<T, ast::NotPredicate>) {
+      first_set.empty = ~GetSingleByteSet(*node.GetExpression());
+    } else if constexpr (std::is_same_v<T, ast::NonTerminal>) {
+      first_set = first_sets_[rule_set_.GetRuleIndex(node.GetSymbol())];
+    } else if constexpr (std::is_same_v<T, ast::QuotedTerminal>) {
+      if (node.GetValue().empty()) {
+        first_set.empty = GetAllLookaheads();
+      } else {
+        first_set.consuming.set(static_cast<unsigned char>(node.GetValue()[0]));
+      }
+    } else if constexpr (std::is_same_v<T, ast::BracketedTerminal> ||
+                         std::is_same_v<T, ast::AnyCharacter>) {
+      first_set.consuming = GetSingleByteSet(node);
+    } else if constexpr (std::is_same_v<T, ast::Cut>) {
+      first_set.empty = GetAllLookaheads();
+    }
+    return first_set;
+  });
+}
+
+auto GrammarAnalysis::AddLeftCalls(const ast::Node& expression,
+                                   std::vector<uint32_t>& calls) const noexcept
+    -> void {
+  ast::Visit(expression, [this, &calls](const auto& node) noexcept {
+    using T = std::decay_t<decltype(node)>;
+    if constexpr (std::is_same_v<T, ast::Sequence>) {
+      for (const auto child : node.GetExpressions()) {
+        AddLeftCalls(*child, calls);
+        if (!IsNullable(*child)) {
+          break;
+        }
+      }
+    } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+      for (const auto child : node.GetAlternatives()) {
+        AddLeftCalls(*child, calls);
+      }
+    } else if constexpr (std::is_same_v<T, ast::NonTerminal>) {
+      calls.push_back(rule_set_.GetRuleIndex(node.GetSymbol()));
+    } else if constexpr (requires { node.GetExpression(); } &&
+                         !std::is_same_v<T, ast::Rule>) {
+      AddLeftCalls(*node.GetExpression(), calls);
+    }
+  });
+}
+
+auto GrammarAnalysis::FindLeftRecursion() const noexcept
+    -> std::optional<uint32_t> {
+  const auto rules = rule_set_.GetRules();
+  std::vector<std::vector<uint32_t>> left_calls(rules.size());
+  for (size_t i{}; i < rules.size(); ++i) {
+    const auto& rule = static_cast<const ast::Rule&>(*rules[i]);
+    AddLeftCalls(*rule.GetExpression(), left_calls[i]);
+  }
+
+  // Depth-first search for a cycle, with an explicit stack of (rule, next
+  // edge) so long call chains do not recurse.
+  enum class Mark : uint8_t { kUnvisited, kOnPath, kDone };
+  std::vector<Mark> marks(rules.size(), Mark::kUnvisited);
+  std::vector<std::pair<uint32_t, size_t>> path;
+  for (uint32_t root{}; root < rules.size(); ++root) {
+    if (marks[root] != Mark::kUnvisited) {
+      continue;
+    }
+
+    marks[root] = Mark::kOnPath;
+    path.emplace_back(root, 0);
+    while (!path.empty()) {
+      auto& [rule, edge] = path.back();
+      if (edge == left_calls[rule].size()) {
+        marks[rule] = Mark::kDone;
+        path.pop_back();
+        continue;
+      }
+
+      const auto callee = left_calls[rule][edge++];
+      if (marks[callee] == Mark::kOnPath) {
+        return callee;
+      }
+      if (marks[callee] == Mark::kUnvisited) {
+        marks[callee] = Mark::kOnPath;
+        path.emplace_back(callee, 0);
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace peg
+} // namespace kero
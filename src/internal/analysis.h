@@ -0,0 +1,78 @@
+#ifndef KERO_PEG_INTERNAL_ANALYSIS_H
+#define KERO_PEG_INTERNAL_ANALYSIS_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "./ast.h"
+
+namespace kero {
+namespace peg {
+
+// A set of next input bytes, with kEndOfInput standing for being at the end
+// of the input.
+using LookaheadSet = std::bitset<257>;
+
+constexpr size_t kEndOfInput = 256;
+
+// Where an expression can succeed, by the next input byte. The sets may hold
+// lookaheads the expression fails on, never the other way around.
+struct FirstSet {
+  // Lookaheads at which the expression can succeed consuming input, i.e. the
+  // first bytes of its matches.
+  LookaheadSet consuming;
+  // Lookaheads at which it can succeed without consuming input.
+  LookaheadSet empty;
+
+  // At any other lookahead the expression fails.
+  auto GetStart() const noexcept -> LookaheadSet { return consuming | empty; }
+
+  friend auto operator==(const FirstSet&, const FirstSet&) noexcept
+      -> bool = default;
+};
+
+// Static properties of the rules of a grammar, by rule index.
+class GrammarAnalysis {
+public:
+  explicit GrammarAnalysis(const ast::RuleSet& rule_set) noexcept;
+
+  // Whether the rule at `rule_index` can succeed without consuming input.
+  auto IsNullable(const uint32_t rule_index) const noexcept -> bool {
+    return nullable_[rule_index];
+  }
+
+  // Whether `expression`, a part of a rule of the analyzed set, can succeed
+  // without consuming input.
+  auto IsNullable(const ast::Node& expression) const noexcept -> bool;
+
+  auto GetFirstSet(const uint32_t rule_index) const noexcept
+      -> const FirstSet& {
+    return first_sets_[rule_index];
+  }
+
+  // The FirstSet of `expression`, a part of a rule of the analyzed set.
+  // Predicates narrow it: `&'a' .` can only start at 'a' and `!'a'` anywhere
+  // else.
+  auto GetFirstSet(const ast::Node& expression) const noexcept -> FirstSet;
+
+  // A rule that can call itself without consuming input, which no top-down
+  // parser in this library terminates on.
+  auto FindLeftRecursion() const noexcept -> std::optional<uint32_t>;
+
+private:
+  // Appends the rules `expression` may call at its start position.
+  auto AddLeftCalls(const ast::Node& expression,
+                    std::vector<uint32_t>& calls) const noexcept -> void;
+
+  const ast::RuleSet& rule_set_;
+  std::vector<bool> nullable_;
+  std::vector<FirstSet> first_sets_;
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_ANALYSIS_H
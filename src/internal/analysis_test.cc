@@ -0,0 +1,135 @@
+#include "./analysis.h"
+
+#include <string>
+#include <string_view>
+
+#include "./testing/grammar.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Owns a parsed grammar and its analysis.
+class Analyzed {
+public:
+  explicit Analyzed(const std::string_view source) noexcept
+      : grammar_{source} {
+    EXPECT_TRUE(grammar_.IsOk());
+  }
+
+  auto Get() const noexcept -> kero::peg::GrammarAnalysis {
+    return kero::peg::GrammarAnalysis{grammar_.GetRuleSet()};
+  }
+
+private:
+  kero::peg::ParsedGrammar grammar_;
+};
+
+auto Lookaheads(const std::string_view bytes, const bool end = false) noexcept
+    -> kero::peg::LookaheadSet {
+  kero::peg::LookaheadSet lookaheads;
+  for (const auto byte : bytes) {
+    lookaheads.set(static_cast<unsigned char>(byte));
+  }
+  lookaheads[kero::peg::kEndOfInput] = end;
+  return lookaheads;
+}
+
+} // namespace
+
+TEST(AnalysisTest, Nullable) {
+  Analyzed grammar{"A <- 'a' B\n"
+                   "B <- 'b'* C\n"
+                   "C <- 'c'? / 'd'\n"
+                   "D <- !'a' &'b' ^\n"
+                   "E <- B+ [x]\n"
+                   "F <- (B / 'f')\n"};
+  const auto analysis = grammar.Get();
+  EXPECT_FALSE(analysis.IsNullable(0));
+  EXPECT_TRUE(analysis.IsNullable(1));
+  EXPECT_TRUE(analysis.IsNullable(2));
+  EXPECT_TRUE(analysis.IsNullable(3));
+  EXPECT_FALSE(analysis.IsNullable(4));
+  EXPECT_TRUE(analysis.IsNullable(5));
+}
+
+TEST(AnalysisTest, NullableThroughLaterRules) {
+  // A is only known nullable once C, defined after it, is.
+  Analyzed grammar{"A <- B C\nB <- C C\nC <- 'c'*\n"};
+  const auto analysis = grammar.Get();
+  EXPECT_TRUE(analysis.IsNullable(0));
+  EXPECT_TRUE(analysis.IsNullable(1));
+  EXPECT_TRUE(analysis.IsNullable(2));
+}
+
+TEST(AnalysisTest, LongChains) {
+  // Each rule calls the next, or the previous one, so facts travel the whole
+  // chain in either direction.
+  constexpr size_t kRuleCount = 2000;
+  std::string down;
+  std::string up{"R0 <- 'z'?\n"};
+  for (size_t i{}; i < kRuleCount; ++i) {
+    const auto name = "R" + std::to_string(i);
+    down += name + " <- R" + std::to_string(i + 1) + " 'x' / 'y'\n";
+    if (i != 0) {
+      up += name + " <- R" + std::to_string(i - 1) + " 'x' / 'y'\n";
+    }
+  }
+  down += "R" + std::to_string(kRuleCount) + " <- 'z'?\n";
+
+  const Analyzed down_grammar{down};
+  const auto down_analysis = down_grammar.Get();
+  EXPECT_FALSE(down_analysis.IsNullable(0));
+  EXPECT_EQ(down_analysis.GetFirstSet(0).consuming, Lookaheads("xyz"));
+  const Analyzed up_grammar{up};
+  const auto up_analysis = up_grammar.Get();
+  EXPECT_FALSE(up_analysis.IsNullable(kRuleCount - 1));
+  EXPECT_EQ(up_analysis.GetFirstSet(kRuleCount - 1).consuming,
+            Lookaheads("xyz"));
+}
+
+TEST(AnalysisTest, NoLeftRecursion) {
+  Analyzed grammar{"Sum <- Value ('+' Sum)?\n"
+                   "Value <- [0-9]+ / '(' Sum ')'\n"};
+  EXPECT_FALSE(grammar.Get().FindLeftRecursion().has_value());
+}
+
+TEST(AnalysisTest, DirectLeftRecursion) {
+  Analyzed grammar{"A <- 'x' / A 'a'"};
+  EXPECT_EQ(grammar.Get().FindLeftRecursion(), 0u);
+}
+
+TEST(AnalysisTest, IndirectLeftRecursion) {
+  // C reaches itself through B, past the nullable D and predicate.
+  Analyzed grammar{"A <- 'a'\nB <- D &'x' C\nC <- B 'c'\nD <- 'd'?\n"};
+  const auto rule = grammar.Get().FindLeftRecursion();
+  ASSERT_TRUE(rule.has_value());
+  EXPECT_TRUE(*rule == 1 || *rule == 2);
+}
+
+TEST(AnalysisTest, RecursionAfterInput) {
+  Analyzed grammar{"A <- 'a' A / B\nB <- 'b'* 'c' B?\n"};
+  EXPECT_FALSE(grammar.Get().FindLeftRecursion().has_value());
+}
+
+TEST(AnalysisTest, FirstSets) {
+  Analyzed grammar{"A <- 'if' / 'while' / Ident\n"
+                   "Ident <- [a-c]+\n"
+                   "B <- 'x'? 'y'* ('z' / '')\n"
+                   "C <- &'a' . / !.\n"
+                   "D <- !'b' / ',' D\n"};
+  const auto analysis = grammar.Get();
+  EXPECT_EQ(analysis.GetFirstSet(0).consuming, Lookaheads("iwabc"));
+  EXPECT_EQ(analysis.GetFirstSet(0).empty, Lookaheads(""));
+  EXPECT_EQ(analysis.GetFirstSet(1).consuming, Lookaheads("abc"));
+
+  // B can match nothing at any lookahead.
+  EXPECT_EQ(analysis.GetFirstSet(2).consuming, Lookaheads("xyz"));
+  EXPECT_TRUE(analysis.GetFirstSet(2).empty.all());
+
+  EXPECT_EQ(analysis.GetFirstSet(3).consuming, Lookaheads("a"));
+  EXPECT_EQ(analysis.GetFirstSet(3).empty, Lookaheads("", true));
+
+  // Every lookahead but 'b', then ',' through the recursion.
+  EXPECT_EQ(analysis.GetFirstSet(4).consuming, Lookaheads(","));
+  EXPECT_EQ(analysis.GetFirstSet(4).GetStart(), ~Lookaheads("b"));
+}
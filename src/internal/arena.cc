@@ -0,0 +1,55 @@
+#include "./arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace kero {
+namespace peg {
+
+Arena::Arena(Arena&& other) noexcept
+    : blocks_{std::exchange(other.blocks_, {})},
+      current_{std::exchange(other.current_, nullptr)},
+      end_{std::exchange(other.end_, nullptr)},
+      next_block_size_{
+          std::exchange(other.next_block_size_, kArenaMinBlockSize)},
+      bytes_used_{std::exchange(other.bytes_used_, 0)} {}
+
+auto Arena::operator=(Arena&& other) noexcept -> Arena& {
+  if (this != &other) {
+    blocks_ = std::exchange(other.blocks_, {});
+    current_ = std::exchange(other.current_, nullptr);
+    end_ = std::exchange(other.end_, nullptr);
+    next_block_size_ =
+        std::exchange(other.next_block_size_, kArenaMinBlockSize);
+    bytes_used_ = std::exchange(other.bytes_used_, 0);
+  }
+  return *this;
+}
+
+auto Arena::Allocate(const size_t size, const size_t alignment) noexcept
+    -> void* {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+  assert(alignment <= alignof(std::max_align_t));
+
+  const auto address = reinterpret_cast<uintptr_t>(current_);
+  const auto padding = (alignment - address % alignment) % alignment;
+  if (current_ == nullptr ||
+      static_cast<size_t>(end_ - current_) < padding + size) {
+    // A request larger than the next block gets a block of its own size.
+    const auto block_size = std::max(next_block_size_, size);
+    blocks_.push_back(std::make_unique_for_overwrite<std::byte[]>(block_size));
+    current_ = blocks_.back().get();
+    end_ = current_ + block_size;
+    next_block_size_ = std::min(next_block_size_ * 2, kArenaMaxBlockSize);
+    bytes_used_ += size;
+    return std::exchange(current_, current_ + size);
+  }
+
+  bytes_used_ += padding + size;
+  current_ += padding;
+  return std::exchange(current_, current_ + size);
+}
+
+} // namespace peg
+} // namespace kero
@@ -0,0 +1,74 @@
+#ifndef KERO_PEG_INTERNAL_ARENA_H
+#define KERO_PEG_INTERNAL_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace kero {
+namespace peg {
+
+constexpr size_t kArenaMinBlockSize = 4 * 1024;
+constexpr size_t kArenaMaxBlockSize = 1024 * 1024;
+
+// Bump allocator owning every object allocated from it. Objects are never
+// destroyed one by one: the arena releases its blocks all at once, so it only
+// accepts trivially destructible types. Block sizes double from
+// kArenaMinBlockSize up to kArenaMaxBlockSize, so n bytes take O(log n)
+// blocks plus one per kArenaMaxBlockSize.
+class Arena {
+public:
+  Arena() noexcept = default;
+  // The moved-from arena is left empty, as if default constructed.
+  Arena(Arena&& other) noexcept;
+  ~Arena() noexcept = default;
+  auto operator=(Arena&& other) noexcept -> Arena&;
+
+  Arena(const Arena&) = delete;
+  auto operator=(const Arena&) -> Arena& = delete;
+
+  auto Allocate(const size_t size, const size_t alignment) noexcept -> void*;
+
+  template <typename T, typename... Args>
+  auto New(Args&&... args) noexcept -> T* {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Arena never runs destructors");
+    return new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Copies `values` into the arena.
+  template <typename T>
+  auto Copy(const std::span<const T> values) noexcept -> std::span<T> {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (values.empty()) {
+      return {};
+    }
+
+    auto data =
+        static_cast<T*>(Allocate(sizeof(T) * values.size(), alignof(T)));
+    std::uninitialized_copy(values.begin(), values.end(), data);
+    return {data, values.size()};
+  }
+
+  auto GetBlockCount() const noexcept -> size_t { return blocks_.size(); }
+
+  // Bytes handed out by Allocate, including alignment padding.
+  auto GetBytesUsed() const noexcept -> size_t { return bytes_used_; }
+
+private:
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  std::byte* current_{};
+  std::byte* end_{};
+  size_t next_block_size_{kArenaMinBlockSize};
+  size_t bytes_used_{};
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_ARENA_H
@@ -0,0 +1,94 @@
+#include "./arena.h"
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+TEST(ArenaTest, Empty) {
+  const kero::peg::Arena arena;
+  EXPECT_EQ(arena.GetBlockCount(), 0);
+  EXPECT_EQ(arena.GetBytesUsed(), 0);
+}
+
+TEST(ArenaTest, New) {
+  struct Point {
+    int32_t x;
+    int32_t y;
+  };
+
+  kero::peg::Arena arena;
+  const auto a = arena.New<Point>(1, 2);
+  const auto b = arena.New<Point>(3, 4);
+  EXPECT_EQ(a->x, 1);
+  EXPECT_EQ(a->y, 2);
+  EXPECT_EQ(b->x, 3);
+  EXPECT_EQ(b->y, 4);
+  EXPECT_EQ(arena.GetBlockCount(), 1);
+  EXPECT_EQ(arena.GetBytesUsed(), 2 * sizeof(Point));
+}
+
+TEST(ArenaTest, Alignment) {
+  kero::peg::Arena arena;
+  arena.New<char>('a');
+  const auto value = arena.New<uint64_t>(1);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(value) % alignof(uint64_t), 0);
+  arena.New<char>('b');
+  const auto max_aligned = arena.Allocate(1, alignof(std::max_align_t));
+  EXPECT_EQ(
+      reinterpret_cast<uintptr_t>(max_aligned) % alignof(std::max_align_t), 0);
+}
+
+TEST(ArenaTest, Grow) {
+  kero::peg::Arena arena;
+  for (size_t i{}; i < kero::peg::kArenaMinBlockSize; ++i) {
+    arena.New<uint32_t>(static_cast<uint32_t>(i));
+  }
+  // 4 * kArenaMinBlockSize bytes fill blocks of 1, 2 and 4 times the minimum.
+  EXPECT_EQ(arena.GetBlockCount(), 3);
+}
+
+TEST(ArenaTest, LargeAllocation) {
+  kero::peg::Arena arena;
+  arena.New<char>('a');
+  const auto size = 3 * kero::peg::kArenaMaxBlockSize;
+  const auto data = static_cast<char*>(arena.Allocate(size, 1));
+  data[0] = 'b';
+  data[size - 1] = 'c';
+  EXPECT_EQ(arena.GetBlockCount(), 2);
+}
+
+TEST(ArenaTest, Copy) {
+  kero::peg::Arena arena;
+  const auto values = std::array<int32_t, 3>{1, 2, 3};
+  const auto copy = arena.Copy<int32_t>(values);
+  ASSERT_EQ(copy.size(), 3);
+  EXPECT_NE(copy.data(), values.data());
+  EXPECT_EQ(copy[0], 1);
+  EXPECT_EQ(copy[1], 2);
+  EXPECT_EQ(copy[2], 3);
+  EXPECT_TRUE(arena.Copy<int32_t>({}).empty());
+}
+
+TEST(ArenaTest, Move) {
+  kero::peg::Arena arena;
+  const auto value = arena.New<int32_t>(1);
+  kero::peg::Arena moved{std::move(arena)};
+  EXPECT_EQ(*value, 1);
+  EXPECT_EQ(moved.GetBlockCount(), 1);
+  EXPECT_EQ(moved.GetBytesUsed(), sizeof(int32_t));
+
+  // The moved-from arena starts over in a block of its own.
+  EXPECT_EQ(arena.GetBlockCount(), 0);
+  EXPECT_EQ(arena.GetBytesUsed(), 0);
+  const auto other = arena.New<int32_t>(2);
+  EXPECT_EQ(arena.GetBlockCount(), 1);
+  EXPECT_EQ(*value, 1);
+  EXPECT_EQ(*other, 2);
+
+  moved = std::move(arena);
+  EXPECT_EQ(moved.GetBlockCount(), 1);
+  EXPECT_EQ(*other, 2);
+  EXPECT_EQ(arena.GetBlockCount(), 0);
+}
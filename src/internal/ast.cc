@@ -1,9 +1,215 @@
-#include "ast.h"
+#include "./ast.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <type_traits>
 
 namespace kero {
 namespace peg {
 namespace ast {
 
+namespace {
+
+// Whether `kind` can start a Prefix in docs/grammar.py.
+auto IsExpressionFirstToken(const TokenKind kind) noexcept -> bool {
+  switch (kind) {
+  case TokenKind::kAmpersand:
+  case TokenKind::kExclamationMark:
+  case TokenKind::kLeftParenthesis:
+  case TokenKind::kNonTerminal:
+  case TokenKind::kQuotedTerminal:
+  case TokenKind::kBracketedTerminal:
+  case TokenKind::kDot:
+    return true;
+  default:
+    return false;
+  }
+}
+
+template <typename T>
+auto NewWithExpression(Arena& arena, Node* expression) noexcept -> Node* {
+  auto node = arena.New<T>();
+  node->SetExpression(expression);
+  return node;
+}
+
+struct NodePrinter {
+  std::ostream& os;
+
+  auto Children(const std::span<Node* const> nodes) noexcept -> void {
+    os << "{";
+    for (size_t i{}; i < nodes.size(); ++i) {
+      os << (i == 0 ? "" : ", ");
+      Visit(*nodes[i], *this);
+    }
+    os << "}";
+  }
+
+  auto operator()(const RuleSet& node) noexcept -> void {
+    os << node.Kind();
+    Children(node.GetRules());
+  }
+
+  auto operator()(const Rule& node) noexcept -> void {
+    os << node.Kind();
+    Children(std::array{node.GetNonTerminal(), node.GetExpression()});
+  }
+
+  auto operator()(const Sequence& node) noexcept -> void {
+    os << node.Kind();
+    Children(node.GetExpressions());
+  }
+
+  auto operator()(const OrderedChoice& node) noexcept -> void {
+    os << node.Kind();
+    Children(node.GetAlternatives());
+  }
+
+  // Group, the suffixes and the predicates.
+  template <typename T>
+    requires requires(const T& node) { node.GetExpression(); }
+  auto operator()(const T& node) noexcept -> void {
+    os << node.Kind();
+    Children(std::array{node.GetExpression()});
+  }
+
+  auto operator()(const AnyCharacter& node) noexcept -> void {
+    os << node.Kind();
+  }
+
+  auto operator()(const Cut& node) noexcept -> void { os << node.Kind(); }
+
+  auto operator()(const NonTerminal& node) noexcept -> void {
+    os << node.Kind() << "{" << node.GetName() << "}";
+  }
+
+  template <typename T>
+    requires requires(const T& node) { node.GetValue(); }
+  auto operator()(const T& node) noexcept -> void {
+    os << node.Kind() << "{" << node.GetValue() << "}";
+  }
+};
+
+auto PrintFlatNode(std::ostream& os, const FlatTree& tree,
+                   const FlatNode& node) noexcept -> void {
+  os << node.kind;
+  switch (node.kind) {
+  case NodeKind::kAnyCharacter:
+  case NodeKind::kCut:
+    break;
+  case NodeKind::kNonTerminal:
+  case NodeKind::kQuotedTerminal:
+  case NodeKind::kBracketedTerminal:
+    os << "{" << tree.GetValue(node) << "}";
+    break;
+  default: {
+    const auto children = tree.GetChildren(node);
+    os << "{";
+    for (size_t i{}; i < children.size(); ++i) {
+      os << (i == 0 ? "" : ", ");
+      PrintFlatNode(os, tree, children[i]);
+    }
+    os << "}";
+    break;
+  }
+  }
+}
+
+} // namespace
+
+auto operator<<(std::ostream& os, const ErrorCode error_code) noexcept
+    -> std::ostream& {
+  switch (error_code) {
+  case ErrorCode::kTokenizeError:
+    os << "TokenizeError";
+    break;
+  case ErrorCode::kLookaheadNotExist:
+    os << "LookaheadNotExist";
+    break;
+  case ErrorCode::kTokenNotNonTerminal:
+    os << "TokenNotNonTerminal";
+    break;
+  case ErrorCode::kTokenNotLeftArrow:
+    os << "TokenNotLeftArrow";
+    break;
+  case ErrorCode::kTokenNotRightParenthesis:
+    os << "TokenNotRightParenthesis";
+    break;
+  case ErrorCode::kTokenNotEndOfInput:
+    os << "TokenNotEndOfInput";
+    break;
+  case ErrorCode::kTokenNotEndOfLine:
+    os << "TokenNotEndOfLine";
+    break;
+  case ErrorCode::kTokenNotPrimary:
+    os << "TokenNotPrimary";
+    break;
+  case ErrorCode::kNonTerminalUndefined:
+    os << "NonTerminalUndefined";
+    break;
+  case ErrorCode::kNonTerminalRedefined:
+    os << "NonTerminalRedefined";
+    break;
+  case ErrorCode::kNestingTooDeep:
+    os << "NestingTooDeep";
+    break;
+  }
+  return os;
+}
+
+auto operator<<(std::ostream& os, const NodeKind kind) noexcept
+    -> std::ostream& {
+  switch (kind) {
+  case NodeKind::kRuleSet:
+    os << "RuleSet";
+    break;
+  case NodeKind::kRule:
+    os << "Rule";
+    break;
+  case NodeKind::kSequence:
+    os << "Sequence";
+    break;
+  case NodeKind::kOrderedChoice:
+    os << "OrderedChoice";
+    break;
+  case NodeKind::kZeroOrMore:
+    os << "ZeroOrMore";
+    break;
+  case NodeKind::kOneOrMore:
+    os << "OneOrMore";
+    break;
+  case NodeKind::kOptional:
+    os << "Optional";
+    break;
+  case NodeKind::kAndPredicate:
+    os << "AndPredicate";
+    break;
+  case NodeKind::kNotPredicate:
+    os << "NotPredicate";
+    break;
+  case NodeKind::kGroup:
+    os << "Group";
+    break;
+  case NodeKind::kAnyCharacter:
+    os << "AnyCharacter";
+    break;
+  case NodeKind::kNonTerminal:
+    os << "NonTerminal";
+    break;
+  case NodeKind::kQuotedTerminal:
+    os << "QuotedTerminal";
+    break;
+  case NodeKind::kBracketedTerminal:
+    os << "BracketedTerminal";
+    break;
+  case NodeKind::kCut:
+    os << "Cut";
+    break;
+  }
+  return os;
+}
+
 auto IsExpressionNodeKind(const NodeKind kind) noexcept -> bool {
   switch (kind) {
   case NodeKind::kSequence:
@@ -18,200 +224,522 @@ auto IsExpressionNodeKind(const NodeKind kind) noexcept -> bool {
   case NodeKind::kNonTerminal:
   case NodeKind::kQuotedTerminal:
   case NodeKind::kBracketedTerminal:
+  case NodeKind::kCut:
     return true;
   case NodeKind::kRuleSet:
   case NodeKind::kRule:
     return false;
   }
+
+  return false;
 }
 
-Parser::Parser(Lexer&& lexer) noexcept : lexer_{std::move(lexer)} {}
+auto PushChildren(const Node& node, std::vector<const Node*>& stack) noexcept
+    -> void {
+  Visit(node, [&stack](const auto& concrete) noexcept {
+    using T = std::decay_t<decltype(concrete)>;
+    if constexpr (std::is_same_v<T, Sequence>) {
+      stack.insert(stack.end(), concrete.GetExpressions().begin(),
+                   concrete.GetExpressions().end());
+    } else if constexpr (std::is_same_v<T, OrderedChoice>) {
+      stack.insert(stack.end(), concrete.GetAlternatives().begin(),
+                   concrete.GetAlternatives().end());
+    } else if constexpr (requires { concrete.GetExpression(); }) {
+      stack.push_back(concrete.GetExpression());
+    }
+  });
+}
+
+auto Contains(const Node& expression, const NodeKind kind) noexcept -> bool {
+  std::vector<const Node*> stack{&expression};
+  while (!stack.empty()) {
+    const auto node = stack.back();
+    stack.pop_back();
+    if (node->Kind() == kind) {
+      return true;
+    }
+    PushChildren(*node, stack);
+  }
+  return false;
+}
+
+auto operator<<(std::ostream& os, const Node& node) noexcept
+    -> std::ostream& {
+  Visit(node, NodePrinter{os});
+  return os;
+}
+
+auto GetFlatNodeValue(const NodeKind kind,
+                      const std::string_view original) noexcept
+    -> std::string_view {
+  switch (kind) {
+  case NodeKind::kQuotedTerminal:
+  case NodeKind::kBracketedTerminal:
+    return original.substr(1, original.size() - 2);
+  default:
+    return original;
+  }
+}
+
+FlatTree::FlatTree(const std::string_view source,
+                   std::vector<FlatNode>&& nodes, SymbolTable&& symbols,
+                   std::vector<uint32_t>&& rule_indices,
+                   std::vector<CharClass>&& char_classes) noexcept
+    : source_{source}, nodes_{std::move(nodes)}, symbols_{std::move(symbols)},
+      rule_indices_{std::move(rule_indices)},
+      char_classes_{std::move(char_classes)} {
+  assert(!nodes_.empty());
+  assert(rule_indices_.size() == symbols_.Size());
+}
+
+auto FlatTree::ToNode(Arena& arena) const noexcept -> Node* {
+  return ToNode(GetRoot(), arena);
+}
+
+auto FlatTree::ToNode(const FlatNode& node, Arena& arena) const noexcept
+    -> Node* {
+  const auto children = GetChildren(node);
+  const auto child = [this, &arena, children](const size_t index) noexcept {
+    return ToNode(children[index], arena);
+  };
+  const auto all_children = [&arena, children,
+                             &child]() noexcept -> std::span<Node* const> {
+    if (children.empty()) {
+      return {};
+    }
+
+    auto nodes = static_cast<Node**>(
+        arena.Allocate(sizeof(Node*) * children.size(), alignof(Node*)));
+    for (size_t i{}; i < children.size(); ++i) {
+      nodes[i] = child(i);
+    }
+    return {nodes, children.size()};
+  };
+
+  switch (node.kind) {
+  case NodeKind::kRuleSet:
+    return arena.New<RuleSet>(all_children(),
+                              arena.Copy<uint32_t>(rule_indices_));
+  case NodeKind::kRule:
+    return arena.New<Rule>(child(0), child(1));
+  case NodeKind::kSequence:
+    return arena.New<Sequence>(all_children());
+  case NodeKind::kOrderedChoice:
+    return arena.New<OrderedChoice>(all_children());
+  case NodeKind::kZeroOrMore:
+    return NewWithExpression<ZeroOrMore>(arena, child(0));
+  case NodeKind::kOneOrMore:
+    return NewWithExpression<OneOrMore>(arena, child(0));
+  case NodeKind::kOptional:
+    return NewWithExpression<Optional>(arena, child(0));
+  case NodeKind::kAndPredicate:
+    return NewWithExpression<AndPredicate>(arena, child(0));
+  case NodeKind::kNotPredicate:
+    return NewWithExpression<NotPredicate>(arena, child(0));
+  case NodeKind::kGroup:
+    return arena.New<Group>(child(0));
+  case NodeKind::kAnyCharacter:
+    return arena.New<AnyCharacter>();
+  case NodeKind::kCut:
+    return arena.New<Cut>();
+  case NodeKind::kNonTerminal: {
+    const auto original = GetOriginal(node);
+    return arena.New<NonTerminal>(
+        Token{node.start, node.start + node.length, original, original,
+              TokenKind::kNonTerminal},
+        node.symbol);
+  }
+  case NodeKind::kQuotedTerminal: {
+    auto terminal = arena.New<QuotedTerminal>();
+    terminal->SetValue(GetValue(node));
+    return terminal;
+  }
+  case NodeKind::kBracketedTerminal: {
+    auto terminal = arena.New<BracketedTerminal>();
+    terminal->SetValue(GetValue(node));
+    return terminal;
+  }
+  }
+
+  return nullptr;
+}
+
+auto operator<<(std::ostream& os, const FlatTree& tree) noexcept
+    -> std::ostream& {
+  PrintFlatNode(os, tree, tree.GetRoot());
+  return os;
+}
+
+Parser::Parser(Lexer&& lexer, const size_t max_depth) noexcept
+    : lexer_{std::move(lexer)}, max_depth_{max_depth} {
+  frames_.reserve(std::min(max_depth_ + 1, kParserDefaultMaxDepth));
+}
 
 auto Parser::NextToken() noexcept -> Result<void, Error> {
   if (auto res = lexer_.Next(); res.IsErr()) {
     return Result<void, Error>{Error{*res.Err()}};
   } else {
+    if (lookahead_) {
+      consumed_end_ = lookahead_->original_end;
+    }
     lookahead_ = *res.Ok();
     return Result<void, Error>{};
   }
 }
 
-auto Parser::ParseRuleSet() noexcept -> Result<NodePtr, Error> {
+auto Parser::ErrorAtLookahead(const ErrorCode error_code) const noexcept
+    -> Error {
+  if (!lookahead_) {
+    return Error{ErrorCode::kLookaheadNotExist};
+  }
+
+  return Error{Token{*lookahead_}, error_code};
+}
+
+auto Parser::Emit(const NodeKind kind, const uint32_t child_count,
+                  const size_t start) noexcept -> void {
+  assert(child_count <= pending_.size());
+  const auto first_child = static_cast<uint32_t>(nodes_.size());
+  const auto children = pending_.end() - child_count;
+  nodes_.insert(nodes_.end(), children, pending_.end());
+  pending_.erase(children, pending_.end());
+
+  // An empty Sequence ends before it starts.
+  const auto end = std::max(consumed_end_, start);
+  pending_.push_back(FlatNode{kind, first_child, child_count,
+                              static_cast<uint32_t>(start),
+                              static_cast<uint32_t>(end - start)});
+}
+
+auto Parser::ParseRuleSet() noexcept -> Result<FlatTree, Error> {
+  lookahead_.reset();
+  consumed_end_ = 0;
+  pending_.clear();
+  nodes_.clear();
+  symbols_.Clear();
+  rule_indices_.clear();
+  symbol_starts_.clear();
+  char_classes_.clear();
+  // FlatNode and the TokenBuffer hold 32-bit offsets into the source.
+  if (lexer_.GetSource().size() > std::numeric_limits<uint32_t>::max()) {
+    return Result<FlatTree, Error>{Error{TokenizeError{
+        TokenizeErrorCode::kSourceTooLarge, Location{0, 1, 1}}}};
+  }
+
+  // The root comes first; its record is filled in once its rules are placed.
+  nodes_.emplace_back();
+
   if (auto res = NextToken(); res.IsErr()) {
-    return Result<NodePtr, Error>{std::move(*res.Err())};
+    return Result<FlatTree, Error>{std::move(*res.Err())};
   }
 
-  auto rules{std::vector<NodePtr>{}};
+  uint32_t rule_count{};
   while (true) {
-    auto res = ParseRule();
-    if (res.IsErr()) {
-      return res;
-    }
-    rules.push_back(std::move(*res.Ok()));
-
     if (!lookahead_) {
-      return Result<NodePtr, Error>{Error{ErrorCode::kLookaheadNotExist}};
+      return Result<FlatTree, Error>{Error{ErrorCode::kLookaheadNotExist}};
     }
 
     if (lookahead_->kind == TokenKind::kEndOfInput) {
       break;
     }
-  }
 
-  return Result<NodePtr, Error>{std::make_unique<RuleSet>(std::move(rules))};
-}
+    // Blank lines between rules.
+    if (lookahead_->kind == TokenKind::kNewLine) {
+      if (auto res = NextToken(); res.IsErr()) {
+        return Result<FlatTree, Error>{std::move(*res.Err())};
+      }
+      continue;
+    }
 
-auto Parser::ParseRule() noexcept -> Result<NodePtr, Error> {
-  if (auto non_terminal_res = ParseNonTerminal(); non_terminal_res.IsErr()) {
-    return non_terminal_res;
-  } else {
-    auto non_terminal = std::move(*non_terminal_res.Ok());
-    if (auto res = ConsumeLeftArrowToken(); res.IsErr()) {
-      return Result<NodePtr, Error>{std::move(*res.Err())};
+    if (auto res = ParseRule(rule_count); res.IsErr()) {
+      return Result<FlatTree, Error>{std::move(*res.Err())};
     }
+    ++rule_count;
+  }
 
-    if (auto expr_res = ParseOrderedChoice(); expr_res.IsErr()) {
-      return expr_res;
-    } else {
-      return Result<NodePtr, Error>{std::make_unique<Rule>(
-          std::move(non_terminal), std::move(*expr_res.Ok()))};
+  const auto source = lexer_.GetSource();
+  for (uint32_t symbol{}; symbol < rule_indices_.size(); ++symbol) {
+    if (rule_indices_[symbol] == kNoSymbol) {
+      const auto start = symbol_starts_[symbol];
+      const auto name = symbols_.GetName(symbol);
+      return Result<FlatTree, Error>{
+          Error{Token{start, start + name.size(), name, name,
+                      TokenKind::kNonTerminal},
+                ErrorCode::kNonTerminalUndefined}};
     }
   }
+
+  consumed_end_ = lookahead_->original_end;
+  Emit(NodeKind::kRuleSet, rule_count, 0);
+  assert(pending_.size() == 1);
+  nodes_.front() = pending_.back();
+  pending_.clear();
+
+  return Result<FlatTree, Error>{
+      FlatTree{source, std::move(nodes_), std::move(symbols_),
+               std::move(rule_indices_), std::move(char_classes_)}};
 }
 
-auto Parser::ParseNonTerminal() noexcept -> Result<NodePtr, Error> {
+auto Parser::ParseRule(const uint32_t index) noexcept -> Result<void, Error> {
+  auto name = Token{*lookahead_};
+  if (auto res = ParseNonTerminal(); res.IsErr()) {
+    return res;
+  }
+
+  const auto symbol = pending_.back().symbol;
+  if (rule_indices_[symbol] != kNoSymbol) {
+    return Result<void, Error>{
+        Error{std::move(name), ErrorCode::kNonTerminalRedefined}};
+  }
+  rule_indices_[symbol] = index;
+
+  if (auto res = ConsumeLeftArrowToken(); res.IsErr()) {
+    return res;
+  }
+
+  if (auto res = ParseOrderedChoice(); res.IsErr()) {
+    return res;
+  }
+
+  // A rule ends at the end of its line.
+  if (lookahead_->kind != TokenKind::kNewLine &&
+      lookahead_->kind != TokenKind::kEndOfInput) {
+    return Result<void, Error>{ErrorAtLookahead(ErrorCode::kTokenNotEndOfLine)};
+  }
+
+  Emit(NodeKind::kRule, 2, name.original_start);
+  return Result<void, Error>{};
+}
+
+auto Parser::ParseNonTerminal() noexcept -> Result<void, Error> {
   if (!lookahead_) {
-    return Result<NodePtr, Error>{Error{ErrorCode::kLookaheadNotExist}};
+    return Result<void, Error>{Error{ErrorCode::kLookaheadNotExist}};
   }
 
   if (lookahead_->kind != TokenKind::kNonTerminal) {
-    return Result<NodePtr, Error>{
+    return Result<void, Error>{
         Error{std::move(*lookahead_), ErrorCode::kTokenNotNonTerminal}};
   }
 
-  auto non_terminal = std::move(*lookahead_);
+  const auto start = lookahead_->original_start;
+  const auto symbol = symbols_.Intern(lookahead_->value);
+  if (symbol == rule_indices_.size()) {
+    rule_indices_.push_back(kNoSymbol);
+    symbol_starts_.push_back(static_cast<uint32_t>(start));
+  }
+
   if (auto res = NextToken(); res.IsErr()) {
-    return Result<NodePtr, Error>{std::move(*res.Err())};
+    return res;
   }
 
-  return Result<NodePtr, Error>{
-      std::make_unique<NonTerminal>(std::move(non_terminal))};
+  Emit(NodeKind::kNonTerminal, 0, start);
+  pending_.back().symbol = symbol;
+  return Result<void, Error>{};
 }
 
 auto Parser::ConsumeLeftArrowToken() noexcept -> Result<void, Error> {
-  if (auto res = lexer_.Next(); res.IsErr()) {
-    return Result<void, Error>{Error{*res.Err()}};
-  } else {
-    auto left_arrow = *res.Ok();
-    if (left_arrow.kind != TokenKind::kLeftArrow) {
-      return Result<void, Error>{
-          Error{std::move(left_arrow), ErrorCode::kTokenNotLeftArrow}};
-    }
-    return Result<void, Error>{};
+  if (!lookahead_) {
+    return Result<void, Error>{Error{ErrorCode::kLookaheadNotExist}};
   }
-}
 
-auto Parser::ParseExpression() noexcept -> Result<NodePtr, Error> {
-  if (!lookahead_) {
-    return Result<NodePtr, Error>{Error{ErrorCode::kLookaheadNotExist}};
+  if (lookahead_->kind != TokenKind::kLeftArrow) {
+    return Result<void, Error>{
+        ErrorAtLookahead(ErrorCode::kTokenNotLeftArrow)};
   }
 
-  auto expr_res = ParseSequence();
-  if (expr_res.IsErr()) {
-    return expr_res;
+  return NextToken();
+}
+
+auto Parser::ParseTerminal() noexcept -> Result<void, Error> {
+  auto kind = NodeKind{};
+  switch (lookahead_->kind) {
+  case TokenKind::kQuotedTerminal:
+    kind = NodeKind::kQuotedTerminal;
+    break;
+  case TokenKind::kBracketedTerminal:
+    kind = NodeKind::kBracketedTerminal;
+    break;
+  case TokenKind::kDot:
+    kind = NodeKind::kAnyCharacter;
+    break;
+  default:
+    return Result<void, Error>{ErrorAtLookahead(ErrorCode::kTokenNotPrimary)};
   }
 
-  while (true) {
-    if (!lookahead_) {
-      return Result<NodePtr, Error>{Error{ErrorCode::kLookaheadNotExist}};
-    }
+  const auto start = lookahead_->original_start;
+  const auto value = lookahead_->value;
+  if (auto res = NextToken(); res.IsErr()) {
+    return res;
+  }
 
-    if (lookahead_->kind == TokenKind::kSlash) {
-      if (auto res = NextToken(); res.IsErr()) {
-        return Result<NodePtr, Error>{std::move(*res.Err())};
-      }
+  Emit(kind, 0, start);
+  if (kind == NodeKind::kBracketedTerminal) {
+    pending_.back().char_class = static_cast<uint32_t>(char_classes_.size());
+    char_classes_.push_back(CharClass::Compile(value));
+  }
+  return Result<void, Error>{};
+}
 
-      if (auto right_expr_res = ParseSequence(); right_expr_res.IsErr()) {
-        return right_expr_res;
-      }
+// Suffix <- Primary ("*" / "+" / "?")?
+// Prefix <- ("&" / "!")? Suffix
+auto Parser::FinishPrefix(const TokenKind prefix, const size_t prefix_start,
+                          const size_t primary_start) noexcept
+    -> Result<void, Error> {
+  auto suffix = std::optional<NodeKind>{};
+  switch (lookahead_->kind) {
+  case TokenKind::kAsterisk:
+    suffix = NodeKind::kZeroOrMore;
+    break;
+  case TokenKind::kPlus:
+    suffix = NodeKind::kOneOrMore;
+    break;
+  case TokenKind::kQuestionMark:
+    suffix = NodeKind::kOptional;
+    break;
+  default:
+    break;
+  }
 
-      expr_res = std::make_unique<OrderedChoice>(
-          std::move(*expr_res.Ok()), std::move(*right_expr_res.Ok()));
-    } else {
-      break;
+  if (suffix) {
+    if (auto res = NextToken(); res.IsErr()) {
+      return res;
     }
+    Emit(*suffix, 1, primary_start);
+  }
+
+  if (prefix == TokenKind::kAmpersand) {
+    Emit(NodeKind::kAndPredicate, 1, prefix_start);
+  } else if (prefix == TokenKind::kExclamationMark) {
+    Emit(NodeKind::kNotPredicate, 1, prefix_start);
   }
+
+  return Result<void, Error>{};
 }
 
-auto Parser::ParseGroup() noexcept -> Result<NodePtr, Error> {
-  if (auto expr_res = ParseExpression(); expr_res.IsErr()) {
-    return expr_res;
-  } else {
-    if (auto right_paren_res = lexer_.Next(); right_paren_res.IsErr()) {
-      return Result<NodePtr, Error>{Error{*right_paren_res.Err()}};
-    } else {
-      auto right_paren = *right_paren_res.Ok();
-      if (right_paren.kind != TokenKind::kRightParenthesis) {
-        return Result<NodePtr, Error>{Error{
-            std::move(right_paren), ErrorCode::kTokenNotRightParenthesis}};
+// Expression <- Sequence ("/" Sequence)*
+// Sequence <- (Prefix / Cut)*
+// Cut <- "^"
+// Primary <- Group / Name / Literal / Bracket / AnyChar
+// Group <- "(" Expression ")"
+//
+// A Group pushes a Frame instead of recursing, and popping it at ")" resumes
+// the enclosing Sequence. The Prefixes of a Sequence and the Sequences of an
+// Expression stay pending until it ends, then become the children of one
+// n-ary node.
+auto Parser::ParseOrderedChoice() noexcept -> Result<void, Error> {
+  if (!lookahead_) {
+    return Result<void, Error>{Error{ErrorCode::kLookaheadNotExist}};
+  }
+
+  const auto start = lookahead_->original_start;
+  frames_.clear();
+  frames_.push_back(
+      Frame{start, start, 0, 0, TokenKind::kEndOfInput, start, start});
+  while (true) {
+    auto& frame = frames_.back();
+    if (lookahead_->kind == TokenKind::kCaret) {
+      const auto cut_start = lookahead_->original_start;
+      if (auto res = NextToken(); res.IsErr()) {
+        return res;
       }
-      return Result<NodePtr, Error>{
-          std::make_unique<Group>(std::move(*expr_res.Ok()))};
+      Emit(NodeKind::kCut, 0, cut_start);
+      ++frame.sequence_size;
+      continue;
     }
-  }
-}
 
-auto Parser::ParseSequence() noexcept -> Result<NodePtr, Error> {
-  if (auto expr_res = ParseGroup(); expr_res.IsErr()) {
-    return expr_res;
-  } else {
-    while (true) {
-      if (!lookahead_) {
-        return Result<NodePtr, Error>{Error{ErrorCode::kLookaheadNotExist}};
+    if (IsExpressionFirstToken(lookahead_->kind)) {
+      const auto prefix = lookahead_->kind;
+      const auto prefix_start = lookahead_->original_start;
+      if (prefix == TokenKind::kAmpersand ||
+          prefix == TokenKind::kExclamationMark) {
+        if (auto res = NextToken(); res.IsErr()) {
+          return res;
+        }
       }
 
-      if (IsExpressionNodeKind(lookahead_->kind)) {
-        if (auto right_expr_res = ParseGroup(); right_expr_res.IsErr()) {
-          return right_expr_res;
+      const auto primary_start = lookahead_->original_start;
+      switch (lookahead_->kind) {
+      case TokenKind::kLeftParenthesis: {
+        if (frames_.size() > max_depth_) {
+          return Result<void, Error>{
+              ErrorAtLookahead(ErrorCode::kNestingTooDeep)};
+        }
+
+        if (auto res = NextToken(); res.IsErr()) {
+          return res;
         }
 
-        expr_res = std::make_unique<Sequence>(std::move(*expr_res.Ok()),
-                                              std::move(*right_expr_res.Ok()));
-      } else {
+        const auto expression_start = lookahead_->original_start;
+        frames_.push_back(Frame{expression_start, expression_start, 0, 0,
+                                prefix, prefix_start, primary_start});
+        continue;
+      }
+      case TokenKind::kNonTerminal:
+        if (auto res = ParseNonTerminal(); res.IsErr()) {
+          return res;
+        }
+        break;
+      case TokenKind::kQuotedTerminal:
+      case TokenKind::kBracketedTerminal:
+      case TokenKind::kDot:
+        if (auto res = ParseTerminal(); res.IsErr()) {
+          return res;
+        }
         break;
+      default:
+        return Result<void, Error>{
+            ErrorAtLookahead(ErrorCode::kTokenNotPrimary)};
       }
+
+      if (auto res = FinishPrefix(prefix, prefix_start, primary_start);
+          res.IsErr()) {
+        return res;
+      }
+      ++frame.sequence_size;
+      continue;
     }
 
-    return expr_res;
-  }
-}
+    // The current Sequence ends here. A single Prefix stands for itself.
+    if (frame.sequence_size != 1) {
+      Emit(NodeKind::kSequence, frame.sequence_size, frame.sequence_start);
+    }
+    ++frame.choice_size;
 
-auto Parser::ParseOrderedChoice() noexcept -> Result<NodePtr, Error> {
-  if (auto expr_res = ParseSequence(); expr_res.IsErr()) {
-    return expr_res;
-  } else {
-    while (true) {
-      if (!lookahead_) {
-        return Result<NodePtr, Error>{Error{ErrorCode::kLookaheadNotExist}};
+    if (lookahead_->kind == TokenKind::kSlash) {
+      if (auto res = NextToken(); res.IsErr()) {
+        return res;
       }
+      frame.sequence_start = lookahead_->original_start;
+      frame.sequence_size = 0;
+      continue;
+    }
 
-      if (lookahead_->kind == TokenKind::kSlash) {
-        if (auto res = NextToken(); res.IsErr()) {
-          return Result<NodePtr, Error>{std::move(*res.Err())};
-        }
+    // The current Expression ends here. A single Sequence stands for itself.
+    if (frame.choice_size > 1) {
+      Emit(NodeKind::kOrderedChoice, frame.choice_size, frame.expression_start);
+    }
+    if (frames_.size() == 1) {
+      return Result<void, Error>{};
+    }
 
-        if (auto right_expr_res = ParseSequence(); right_expr_res.IsErr()) {
-          return right_expr_res;
-        } else {
-          expr_res = std::make_unique<OrderedChoice>(
-              std::move(*expr_res.Ok()), std::move(*right_expr_res.Ok()));
-        }
-      } else {
-        break;
-      }
+    if (lookahead_->kind != TokenKind::kRightParenthesis) {
+      return Result<void, Error>{
+          ErrorAtLookahead(ErrorCode::kTokenNotRightParenthesis)};
+    }
+
+    if (auto res = NextToken(); res.IsErr()) {
+      return res;
     }
 
-    return expr_res;
+    const auto group = frame;
+    frames_.pop_back();
+    Emit(NodeKind::kGroup, 1, group.group_start);
+    if (auto res = FinishPrefix(group.prefix, group.prefix_start,
+                                group.group_start);
+        res.IsErr()) {
+      return res;
+    }
+    ++frames_.back().sequence_size;
   }
 }
 
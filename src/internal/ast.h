@@ -3,12 +3,19 @@
 
 #include <cassert>
 #include <cstdint>
-#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
 #include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
+#include "./arena.h"
+#include "./char_class.h"
+#include "./core.h"
 #include "./lexer.h"
+#include "./symbol_table.h"
 
 namespace kero {
 namespace peg {
@@ -21,8 +28,16 @@ enum class ErrorCode : int32_t {
   kTokenNotLeftArrow,
   kTokenNotRightParenthesis,
   kTokenNotEndOfInput,
+  kTokenNotEndOfLine,
+  kTokenNotPrimary,
+  kNonTerminalUndefined,
+  kNonTerminalRedefined,
+  kNestingTooDeep,
 };
 
+auto operator<<(std::ostream& os, const ErrorCode error_code) noexcept
+    -> std::ostream&;
+
 struct Error {
   std::variant<std::monostate, TokenizeError, Token> value;
   ErrorCode error_code;
@@ -51,228 +66,482 @@ enum class NodeKind : int32_t {
   kNonTerminal,
   kQuotedTerminal,
   kBracketedTerminal,
+  kCut,
 };
 
+auto operator<<(std::ostream& os, const NodeKind kind) noexcept
+    -> std::ostream&;
+
 auto IsExpressionNodeKind(const NodeKind kind) noexcept -> bool;
 
+// Nodes store their kind rather than having a vtable. Use Visit to dispatch
+// on it.
 class Node {
 public:
-  virtual ~Node() noexcept = default;
-  virtual auto Kind() const noexcept -> NodeKind = 0;
-};
+  auto Kind() const noexcept -> NodeKind { return kind_; }
 
-using NodePtr = std::unique_ptr<Node>;
+protected:
+  constexpr Node(const NodeKind kind) noexcept : kind_{kind} {}
 
-class RuleSet : public Node {
+  // Nodes live in an Arena and are never destroyed one by one.
+  ~Node() noexcept = default;
+
+private:
+  NodeKind kind_;
+};
+
+class RuleSet final : public Node {
 public:
-  RuleSet(std::vector<NodePtr>&& rules) noexcept : rules_{std::move(rules)} {}
+  // `rule_indices[symbol]` is the index in `rules` of the rule defining
+  // `symbol`.
+  RuleSet(std::span<Node* const> rules,
+          std::span<const uint32_t> rule_indices) noexcept
+      : Node{NodeKind::kRuleSet}, rules_{rules}, rule_indices_{rule_indices} {}
 
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kRuleSet;
+  auto GetRules() const noexcept -> std::span<Node* const> { return rules_; }
+
+  auto GetRule(const uint32_t symbol) const noexcept -> Node* {
+    return rules_[rule_indices_[symbol]];
+  }
+
+  auto GetRuleIndex(const uint32_t symbol) const noexcept -> uint32_t {
+    return rule_indices_[symbol];
+  }
+
+  auto GetRuleIndices() const noexcept -> std::span<const uint32_t> {
+    return rule_indices_;
   }
 
 private:
-  std::vector<NodePtr> rules_;
+  std::span<Node* const> rules_;
+  std::span<const uint32_t> rule_indices_;
 };
 
-class Rule : public Node {
+class Rule final : public Node {
 public:
-  Rule(NodePtr&& non_terminal, NodePtr&& expression) noexcept
-      : non_terminal_{std::move(non_terminal)},
-        expression_{std::move(expression)} {}
+  Rule(Node* non_terminal, Node* expression) noexcept
+      : Node{NodeKind::kRule}, non_terminal_{non_terminal},
+        expression_{expression} {}
 
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kRule;
-  }
+  auto GetNonTerminal() const noexcept -> Node* { return non_terminal_; }
+
+  auto GetExpression() const noexcept -> Node* { return expression_; }
 
 private:
-  NodePtr non_terminal_;
-  NodePtr expression_;
+  Node* non_terminal_;
+  Node* expression_;
 };
 
-class Sequence : public Node {
+class Sequence final : public Node {
 public:
-  Sequence(std::vector<NodePtr>&& expressions) noexcept
-      : expressions_{std::move(expressions)} {}
+  // No expressions, or at least two.
+  Sequence(std::span<Node* const> expressions) noexcept
+      : Node{NodeKind::kSequence}, expressions_{expressions} {}
 
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kSequence;
+  auto GetExpressions() const noexcept -> std::span<Node* const> {
+    return expressions_;
   }
 
 private:
-  std::vector<NodePtr> expressions_;
+  std::span<Node* const> expressions_;
 };
 
-class OrderedChoice : public Node {
+class OrderedChoice final : public Node {
 public:
-  OrderedChoice(NodePtr&& expression) noexcept
-      : expression_{std::move(expression)} {}
+  // At least two alternatives, tried in order.
+  OrderedChoice(std::span<Node* const> alternatives) noexcept
+      : Node{NodeKind::kOrderedChoice}, alternatives_{alternatives} {}
 
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kOrderedChoice;
+  auto GetAlternatives() const noexcept -> std::span<Node* const> {
+    return alternatives_;
   }
 
 private:
-  NodePtr expression_;
+  std::span<Node* const> alternatives_;
 };
 
-class ZeroOrMore : public Node {
+class ZeroOrMore final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kZeroOrMore;
-  }
+  ZeroOrMore() noexcept : Node{NodeKind::kZeroOrMore} {}
 
-  auto SetExpression(NodePtr&& expression) noexcept -> void {
+  auto SetExpression(Node* expression) noexcept -> void {
     assert(expression);
     assert(IsExpressionNodeKind(expression->Kind()));
-    expression_ = std::move(expression);
+    expression_ = expression;
   }
 
+  auto GetExpression() const noexcept -> Node* { return expression_; }
+
 private:
-  NodePtr expression_;
+  Node* expression_{};
 };
 
-class OneOrMore : public Node {
+class OneOrMore final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kOneOrMore;
-  }
+  OneOrMore() noexcept : Node{NodeKind::kOneOrMore} {}
 
-  auto SetExpression(NodePtr&& expression) noexcept -> void {
+  auto SetExpression(Node* expression) noexcept -> void {
     assert(expression);
     assert(IsExpressionNodeKind(expression->Kind()));
-    expression_ = std::move(expression);
+    expression_ = expression;
   }
 
+  auto GetExpression() const noexcept -> Node* { return expression_; }
+
 private:
-  NodePtr expression_;
+  Node* expression_{};
 };
 
-class Optional : public Node {
+class Optional final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kOptional;
-  }
+  Optional() noexcept : Node{NodeKind::kOptional} {}
 
-  auto SetExpression(NodePtr&& expression) noexcept -> void {
+  auto SetExpression(Node* expression) noexcept -> void {
     assert(expression);
     assert(IsExpressionNodeKind(expression->Kind()));
-    expression_ = std::move(expression);
+    expression_ = expression;
   }
 
+  auto GetExpression() const noexcept -> Node* { return expression_; }
+
 private:
-  NodePtr expression_;
+  Node* expression_{};
 };
 
-class AndPredicate : public Node {
+class AndPredicate final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kAndPredicate;
-  }
+  AndPredicate() noexcept : Node{NodeKind::kAndPredicate} {}
 
-  auto SetExpression(NodePtr&& expression) noexcept -> void {
+  auto SetExpression(Node* expression) noexcept -> void {
     assert(expression);
     assert(IsExpressionNodeKind(expression->Kind()));
-    expression_ = std::move(expression);
+    expression_ = expression;
   }
 
+  auto GetExpression() const noexcept -> Node* { return expression_; }
+
 private:
-  NodePtr expression_;
+  Node* expression_{};
 };
 
-class NotPredicate : public Node {
+class NotPredicate final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kNotPredicate;
-  }
+  NotPredicate() noexcept : Node{NodeKind::kNotPredicate} {}
 
-  auto SetExpression(NodePtr&& expression) noexcept -> void {
+  auto SetExpression(Node* expression) noexcept -> void {
     assert(expression);
     assert(IsExpressionNodeKind(expression->Kind()));
-    expression_ = std::move(expression);
+    expression_ = expression;
   }
 
+  auto GetExpression() const noexcept -> Node* { return expression_; }
+
 private:
-  NodePtr expression_;
+  Node* expression_{};
 };
 
-class Group : public Node {
+class Group final : public Node {
 public:
-  Group(NodePtr&& expression) noexcept : expression_{std::move(expression)} {}
+  Group(Node* expression) noexcept
+      : Node{NodeKind::kGroup}, expression_{expression} {}
 
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kGroup;
-  }
+  auto GetExpression() const noexcept -> Node* { return expression_; }
 
 private:
-  NodePtr expression_;
+  Node* expression_;
 };
 
-class QuotedTerminal : public Node {
+class QuotedTerminal final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kQuotedTerminal;
-  }
+  QuotedTerminal() noexcept : Node{NodeKind::kQuotedTerminal} {}
 
   auto SetValue(const std::string_view value) noexcept -> void {
     value_ = value;
   }
 
+  auto GetValue() const noexcept -> std::string_view { return value_; }
+
 private:
   std::string_view value_;
 };
 
-class BracketedTerminal : public Node {
+class BracketedTerminal final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kBracketedTerminal;
-  }
+  BracketedTerminal() noexcept : Node{NodeKind::kBracketedTerminal} {}
 
   auto SetValue(const std::string_view value) noexcept -> void {
     value_ = value;
+    char_class_ = CharClass::Compile(value);
   }
 
+  auto GetValue() const noexcept -> std::string_view { return value_; }
+
+  auto GetCharClass() const noexcept -> const CharClass& { return char_class_; }
+
 private:
   std::string_view value_;
+  CharClass char_class_;
+};
+
+class AnyCharacter final : public Node {
+public:
+  AnyCharacter() noexcept : Node{NodeKind::kAnyCharacter} {}
+};
+
+// `^`: commits the innermost enclosing choice, repetition or option, so it no
+// longer backtracks past this point.
+class Cut final : public Node {
+public:
+  Cut() noexcept : Node{NodeKind::kCut} {}
 };
 
-class AnyCharacter : public Node {
+class NonTerminal final : public Node {
 public:
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kAnyCharacter;
+  NonTerminal(Token&& token, const uint32_t symbol) noexcept
+      : Node{NodeKind::kNonTerminal}, token_{std::move(token)},
+        symbol_{symbol} {}
+
+  auto GetToken() const noexcept -> const Token& { return token_; }
+
+  auto GetName() const noexcept -> std::string_view { return token_.value; }
+
+  // See RuleSet::GetRule.
+  auto GetSymbol() const noexcept -> uint32_t { return symbol_; }
+
+private:
+  Token token_;
+  uint32_t symbol_;
+};
+
+// Calls `visitor` with `node` cast to its concrete class, so overloads are
+// resolved at compile time and can be inlined, e.g.
+// `Visit(node, [](const auto& concrete) { ... })`.
+template <typename Visitor>
+auto Visit(const Node& node, Visitor&& visitor) -> decltype(auto) {
+  switch (node.Kind()) {
+  case NodeKind::kRuleSet:
+    return visitor(static_cast<const RuleSet&>(node));
+  case NodeKind::kRule:
+    return visitor(static_cast<const Rule&>(node));
+  case NodeKind::kSequence:
+    return visitor(static_cast<const Sequence&>(node));
+  case NodeKind::kOrderedChoice:
+    return visitor(static_cast<const OrderedChoice&>(node));
+  case NodeKind::kZeroOrMore:
+    return visitor(static_cast<const ZeroOrMore&>(node));
+  case NodeKind::kOneOrMore:
+    return visitor(static_cast<const OneOrMore&>(node));
+  case NodeKind::kOptional:
+    return visitor(static_cast<const Optional&>(node));
+  case NodeKind::kAndPredicate:
+    return visitor(static_cast<const AndPredicate&>(node));
+  case NodeKind::kNotPredicate:
+    return visitor(static_cast<const NotPredicate&>(node));
+  case NodeKind::kGroup:
+    return visitor(static_cast<const Group&>(node));
+  case NodeKind::kAnyCharacter:
+    return visitor(static_cast<const AnyCharacter&>(node));
+  case NodeKind::kNonTerminal:
+    return visitor(static_cast<const NonTerminal&>(node));
+  case NodeKind::kQuotedTerminal:
+    return visitor(static_cast<const QuotedTerminal&>(node));
+  case NodeKind::kCut:
+    return visitor(static_cast<const Cut&>(node));
+  case NodeKind::kBracketedTerminal:
+  default:
+    assert(node.Kind() == NodeKind::kBracketedTerminal);
+    return visitor(static_cast<const BracketedTerminal&>(node));
   }
+}
+
+// `node` as a `T`, or nullptr if it is of another class, e.g.
+// `if (const auto sequence = As<Sequence>(node)) { ... }`.
+template <typename T>
+auto As(const Node& node) noexcept -> const T* {
+  return Visit(node, [](const auto& concrete) noexcept -> const T* {
+    if constexpr (std::is_same_v<std::decay_t<decltype(concrete)>, T>) {
+      return &concrete;
+    } else {
+      return nullptr;
+    }
+  });
+}
+
+// Appends the subexpressions of `node`, not following NonTerminals.
+auto PushChildren(const Node& node, std::vector<const Node*>& stack) noexcept
+    -> void;
+
+// Whether `expression` or an expression below it is of `kind`, not following
+// NonTerminals. Walks with an explicit stack since the parser accepts
+// arbitrarily deep nesting.
+auto Contains(const Node& expression, const NodeKind kind) noexcept -> bool;
+
+// Prints the tree as nested `Kind{...}`, e.g.
+// `Rule{NonTerminal{A}, Sequence{QuotedTerminal{a}, AnyCharacter}}`.
+auto operator<<(std::ostream& os, const Node& node) noexcept -> std::ostream&;
+
+// One fixed-size record of a FlatTree. The children of a node are the
+// records [first_child, first_child + child_count), and [start, start +
+// length) is the source text it was parsed from. A NonTerminal or
+// BracketedTerminal has no children and holds its symbol id or the index of
+// its compiled CharClass instead.
+struct FlatNode {
+  NodeKind kind;
+  union {
+    uint32_t first_child;
+    uint32_t symbol;
+    uint32_t char_class;
+  };
+  uint32_t child_count;
+  uint32_t start;
+  uint32_t length;
 };
 
-class NonTerminal : public Node {
+static_assert(sizeof(FlatNode) == 20);
+
+// `original` without the quotes or brackets if `kind` is a terminal.
+auto GetFlatNodeValue(const NodeKind kind,
+                      const std::string_view original) noexcept
+    -> std::string_view;
+
+// The tree as one contiguous array of FlatNode, root first. Siblings are
+// adjacent, so visiting every node is a linear scan of GetNodes().
+class FlatTree {
 public:
-  NonTerminal(Token&& token) noexcept : token_{std::move(token)} {}
+  FlatTree(const std::string_view source, std::vector<FlatNode>&& nodes,
+           SymbolTable&& symbols, std::vector<uint32_t>&& rule_indices,
+           std::vector<CharClass>&& char_classes) noexcept;
+  FlatTree(FlatTree&&) noexcept = default;
+  ~FlatTree() = default;
+  auto operator=(FlatTree&&) noexcept -> FlatTree& = default;
+
+  FlatTree(const FlatTree&) = delete;
+  auto operator=(const FlatTree&) -> FlatTree& = delete;
+
+  auto GetSource() const noexcept -> std::string_view { return source_; }
+
+  auto GetNodes() const noexcept -> std::span<const FlatNode> {
+    return nodes_;
+  }
+
+  auto GetRoot() const noexcept -> const FlatNode& { return nodes_.front(); }
 
-  virtual auto Kind() const noexcept -> NodeKind override {
-    return NodeKind::kNonTerminal;
+  auto GetChildren(const FlatNode& node) const noexcept
+      -> std::span<const FlatNode> {
+    if (node.child_count == 0) {
+      return {};
+    }
+    return std::span{nodes_}.subspan(node.first_child, node.child_count);
   }
 
+  // Names of every NonTerminal, each defined by exactly one rule.
+  auto GetSymbols() const noexcept -> const SymbolTable& { return symbols_; }
+
+  // The Rule defining `symbol`.
+  auto GetRule(const uint32_t symbol) const noexcept -> const FlatNode& {
+    return nodes_[GetRoot().first_child + rule_indices_[symbol]];
+  }
+
+  auto GetRuleIndices() const noexcept -> std::span<const uint32_t> {
+    return rule_indices_;
+  }
+
+  auto GetCharClass(const FlatNode& node) const noexcept -> const CharClass& {
+    assert(node.kind == NodeKind::kBracketedTerminal);
+    return char_classes_[node.char_class];
+  }
+
+  // One per BracketedTerminal, in source order.
+  auto GetCharClasses() const noexcept -> std::span<const CharClass> {
+    return char_classes_;
+  }
+
+  auto GetOriginal(const FlatNode& node) const noexcept -> std::string_view {
+    return source_.substr(node.start, node.length);
+  }
+
+  auto GetValue(const FlatNode& node) const noexcept -> std::string_view {
+    return GetFlatNodeValue(node.kind, GetOriginal(node));
+  }
+
+  // Builds the equivalent Node tree in `arena`.
+  auto ToNode(Arena& arena) const noexcept -> Node*;
+
 private:
-  Token token_;
+  auto ToNode(const FlatNode& node, Arena& arena) const noexcept -> Node*;
+
+  std::string_view source_;
+  std::vector<FlatNode> nodes_;
+  SymbolTable symbols_;
+  // Index among the root's children of the rule defining each symbol.
+  std::vector<uint32_t> rule_indices_;
+  std::vector<CharClass> char_classes_;
 };
 
+// Prints the same text as operator<< of the equivalent Node tree.
+auto operator<<(std::ostream& os, const FlatTree& tree) noexcept
+    -> std::ostream&;
+
+constexpr size_t kParserDefaultMaxDepth = 1024;
+
+// Parses the grammar in docs/grammar.py into a FlatTree, interning every
+// NonTerminal name and resolving it to the rule defining it. Expressions are
+// parsed without recursion, and Groups nested deeper than `max_depth` are
+// reported as kNestingTooDeep.
 class Parser {
 public:
-  Parser(Lexer&& lexer) noexcept;
+  Parser(Lexer&& lexer,
+         const size_t max_depth = kParserDefaultMaxDepth) noexcept;
 
-  auto ParseRuleSet() noexcept -> Result<NodePtr, Error>;
+  auto ParseRuleSet() noexcept -> Result<FlatTree, Error>;
 
 private:
   auto NextToken() noexcept -> Result<void, Error>;
-  auto ParseRule() noexcept -> Result<NodePtr, Error>;
-  auto ParseNonTerminal() noexcept -> Result<NodePtr, Error>;
+  auto ParseRule(const uint32_t index) noexcept -> Result<void, Error>;
+  auto ParseNonTerminal() noexcept -> Result<void, Error>;
   auto ConsumeLeftArrowToken() noexcept -> Result<void, Error>;
-  auto ParseExpression() noexcept -> Result<NodePtr, Error>;
-  auto ParseGroup() noexcept -> Result<NodePtr, Error>;
-  auto ParseSequence() noexcept -> Result<NodePtr, Error>;
-  auto ParseOrderedChoice() noexcept -> Result<NodePtr, Error>;
+  auto ParseTerminal() noexcept -> Result<void, Error>;
+  auto ParseOrderedChoice() noexcept -> Result<void, Error>;
+  auto ErrorAtLookahead(const ErrorCode error_code) const noexcept -> Error;
+
+  // An Expression being parsed: the one of a Rule at the bottom, then one per
+  // open Group.
+  struct Frame {
+    size_t expression_start;
+    size_t sequence_start;
+    // Prefixes in the current Sequence and Sequences in the Expression.
+    uint32_t sequence_size;
+    uint32_t choice_size;
+    // The Prefix whose Primary is this frame's Group.
+    TokenKind prefix;
+    size_t prefix_start;
+    size_t group_start;
+  };
+
+  // Wraps the pending Primary in its Suffix, if any, then in `prefix`.
+  auto FinishPrefix(const TokenKind prefix, const size_t prefix_start,
+                    const size_t primary_start) noexcept
+      -> Result<void, Error>;
+
+  // Pops the last `child_count` pending nodes into nodes_ and pushes a
+  // pending `kind` node over them, spanning from `start` to the end of the
+  // last consumed token.
+  auto Emit(const NodeKind kind, const uint32_t child_count,
+            const size_t start) noexcept -> void;
 
   Lexer lexer_;
+  size_t max_depth_;
+  std::vector<Frame> frames_;
   std::optional<Token> lookahead_;
+  size_t consumed_end_{};
+  // Parsed nodes whose parent is not finished yet, in source order.
+  std::vector<FlatNode> pending_;
+  std::vector<FlatNode> nodes_;
+  SymbolTable symbols_;
+  std::vector<uint32_t> rule_indices_;
+  // Start of the first NonTerminal token of each symbol, for errors.
+  std::vector<uint32_t> symbol_starts_;
+  std::vector<CharClass> char_classes_;
 };
 
 } // namespace ast
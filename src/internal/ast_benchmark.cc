@@ -0,0 +1,294 @@
+#include "./ast.h"
+
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "./testing/allocation_counter.h"
+#include "benchmark/benchmark.h"
+
+static auto MakeGrammar(const size_t rule_count) noexcept -> std::string {
+  std::string source;
+  for (size_t i{}; i < rule_count; ++i) {
+    source += "Rule" + std::to_string(i) + " <- Rule" +
+              std::to_string((i + 1) % rule_count) + " ('kw" +
+              std::to_string(i) +
+              "' / \"op\" / [a-zA-Z0-9_]+) (Space / Tab)* !Eof .?\n";
+  }
+  source += "Space <- ' '\nTab <- '\t'\nEof <- !.\n";
+  return source;
+}
+
+// The tree refers to `source`, which must outlive it.
+static auto ParseOrDie(const std::string_view source) noexcept
+    -> kero::peg::ast::FlatTree {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto res = parser.ParseRuleSet();
+  if (res.IsErr()) {
+    std::abort();
+  }
+  return std::move(*res.Ok());
+}
+
+// A node of the tree as it was before Arena: each node is its own heap block,
+// owned by its parent through a unique_ptr.
+struct HeapNode {
+  kero::peg::ast::NodeKind kind;
+  std::vector<std::unique_ptr<HeapNode>> children;
+};
+
+static auto ToHeapNode(const kero::peg::ast::FlatTree& tree,
+                       const kero::peg::ast::FlatNode& node) noexcept
+    -> std::unique_ptr<HeapNode> {
+  auto heap_node = std::make_unique<HeapNode>(HeapNode{node.kind, {}});
+  const auto children = tree.GetChildren(node);
+  heap_node->children.reserve(children.size());
+  for (const auto& child : children) {
+    heap_node->children.push_back(ToHeapNode(tree, child));
+  }
+  return heap_node;
+}
+
+struct NonTerminalCounter {
+  auto Sum(const std::span<kero::peg::ast::Node* const> nodes) noexcept
+      -> size_t {
+    size_t count{};
+    for (const auto node : nodes) {
+      count += kero::peg::ast::Visit(*node, *this);
+    }
+    return count;
+  }
+
+  auto operator()(const kero::peg::ast::RuleSet& node) noexcept -> size_t {
+    return Sum(node.GetRules());
+  }
+
+  auto operator()(const kero::peg::ast::Rule& node) noexcept -> size_t {
+    return kero::peg::ast::Visit(*node.GetNonTerminal(), *this) +
+           kero::peg::ast::Visit(*node.GetExpression(), *this);
+  }
+
+  auto operator()(const kero::peg::ast::Sequence& node) noexcept -> size_t {
+    return Sum(node.GetExpressions());
+  }
+
+  auto operator()(const kero::peg::ast::OrderedChoice& node) noexcept
+      -> size_t {
+    return Sum(node.GetAlternatives());
+  }
+
+  template <typename T>
+    requires requires(const T& node) { node.GetExpression(); }
+  auto operator()(const T& node) noexcept -> size_t {
+    return kero::peg::ast::Visit(*node.GetExpression(), *this);
+  }
+
+  auto operator()(const kero::peg::ast::NonTerminal&) noexcept -> size_t {
+    return 1;
+  }
+
+  auto operator()(const kero::peg::ast::Node&) noexcept -> size_t {
+    return 0;
+  }
+};
+
+// The baseline for Visit: one virtual call per node, as if each Node class
+// overrode a virtual Count. kKindCounters holds a counter per NodeKind.
+class KindCounter {
+public:
+  virtual auto Count(const kero::peg::ast::Node& node) const noexcept
+      -> size_t = 0;
+
+protected:
+  ~KindCounter() = default;
+};
+
+static auto CountVirtual(const kero::peg::ast::Node& node) noexcept -> size_t;
+
+static auto SumVirtual(const std::span<kero::peg::ast::Node* const> nodes)
+    -> size_t {
+  size_t count{};
+  for (const auto node : nodes) {
+    count += CountVirtual(*node);
+  }
+  return count;
+}
+
+template <typename T> class TypedCounter final : public KindCounter {
+public:
+  auto Count(const kero::peg::ast::Node& node) const noexcept
+      -> size_t override {
+    using namespace kero::peg::ast;
+    const auto& typed = static_cast<const T&>(node);
+    if constexpr (std::is_same_v<T, RuleSet>) {
+      return SumVirtual(typed.GetRules());
+    } else if constexpr (std::is_same_v<T, Rule>) {
+      return CountVirtual(*typed.GetNonTerminal()) +
+             CountVirtual(*typed.GetExpression());
+    } else if constexpr (std::is_same_v<T, Sequence>) {
+      return SumVirtual(typed.GetExpressions());
+    } else if constexpr (std::is_same_v<T, OrderedChoice>) {
+      return SumVirtual(typed.GetAlternatives());
+    } else if constexpr (requires { typed.GetExpression(); }) {
+      return CountVirtual(*typed.GetExpression());
+    } else {
+      return std::is_same_v<T, NonTerminal>;
+    }
+  }
+};
+
+template <typename T> constexpr TypedCounter<T> kTypedCounter{};
+
+// In NodeKind order.
+constexpr std::array<const KindCounter*, 15> kKindCounters{
+    &kTypedCounter<kero::peg::ast::RuleSet>,
+    &kTypedCounter<kero::peg::ast::Rule>,
+    &kTypedCounter<kero::peg::ast::Sequence>,
+    &kTypedCounter<kero::peg::ast::OrderedChoice>,
+    &kTypedCounter<kero::peg::ast::ZeroOrMore>,
+    &kTypedCounter<kero::peg::ast::OneOrMore>,
+    &kTypedCounter<kero::peg::ast::Optional>,
+    &kTypedCounter<kero::peg::ast::AndPredicate>,
+    &kTypedCounter<kero::peg::ast::NotPredicate>,
+    &kTypedCounter<kero::peg::ast::Group>,
+    &kTypedCounter<kero::peg::ast::AnyCharacter>,
+    &kTypedCounter<kero::peg::ast::NonTerminal>,
+    &kTypedCounter<kero::peg::ast::QuotedTerminal>,
+    &kTypedCounter<kero::peg::ast::BracketedTerminal>,
+    &kTypedCounter<kero::peg::ast::Cut>,
+};
+
+static auto CountVirtual(const kero::peg::ast::Node& node) noexcept
+    -> size_t {
+  return kKindCounters[static_cast<size_t>(node.Kind())]->Count(node);
+}
+
+// Parses and frees the tree, so teardown is part of the measured time.
+static auto BM_ParseRuleSet(benchmark::State& state) -> void {
+  const auto source = MakeGrammar(static_cast<size_t>(state.range(0)));
+  size_t allocations{};
+  size_t nodes{};
+  for (auto _ : state) {
+    const auto counter = kero::peg::AllocationCounter{};
+    {
+      auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+      auto res = parser.ParseRuleSet();
+      if (res.IsErr()) {
+        state.SkipWithError("parse failed");
+        break;
+      }
+      nodes = res.Ok()->GetNodes().size();
+    }
+    allocations = counter.GetCount();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+  state.counters["allocations"] = static_cast<double>(allocations);
+  state.counters["nodes"] = static_cast<double>(nodes);
+}
+BENCHMARK(BM_ParseRuleSet)->Arg(10000);
+
+// Parses and converts to the Node classes in an arena.
+static auto BM_ParseRuleSetToNode(benchmark::State& state) -> void {
+  const auto source = MakeGrammar(static_cast<size_t>(state.range(0)));
+  size_t allocations{};
+  size_t bytes{};
+  for (auto _ : state) {
+    const auto counter = kero::peg::AllocationCounter{};
+    {
+      const auto tree = ParseOrDie(source);
+      kero::peg::Arena arena;
+      benchmark::DoNotOptimize(tree.ToNode(arena));
+      bytes = arena.GetBytesUsed();
+    }
+    allocations = counter.GetCount();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+  state.counters["allocations"] = static_cast<double>(allocations);
+  state.counters["arena_bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_ParseRuleSetToNode)->Arg(10000);
+
+// The baseline for BM_ParseRuleSetToNode: the same parse, converted to a tree
+// with one unique_ptr per node.
+static auto BM_ParseRuleSetToHeapNodes(benchmark::State& state) -> void {
+  const auto source = MakeGrammar(static_cast<size_t>(state.range(0)));
+  size_t allocations{};
+  for (auto _ : state) {
+    const auto counter = kero::peg::AllocationCounter{};
+    {
+      const auto tree = ParseOrDie(source);
+      benchmark::DoNotOptimize(ToHeapNode(tree, tree.GetRoot()));
+    }
+    allocations = counter.GetCount();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+  state.counters["allocations"] = static_cast<double>(allocations);
+}
+BENCHMARK(BM_ParseRuleSetToHeapNodes)->Arg(10000);
+
+static auto BM_FlatTreeScan(benchmark::State& state) -> void {
+  const auto source = MakeGrammar(static_cast<size_t>(state.range(0)));
+  const auto tree = ParseOrDie(source);
+  for (auto _ : state) {
+    size_t count{};
+    for (const auto& node : tree.GetNodes()) {
+      count += node.kind == kero::peg::ast::NodeKind::kNonTerminal;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(tree.GetNodes().size()));
+}
+BENCHMARK(BM_FlatTreeScan)->Arg(10000);
+
+static auto BM_NodeTreeWalk(benchmark::State& state) -> void {
+  const auto source = MakeGrammar(static_cast<size_t>(state.range(0)));
+  const auto tree = ParseOrDie(source);
+  kero::peg::Arena arena;
+  const auto root = tree.ToNode(arena);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        kero::peg::ast::Visit(*root, NonTerminalCounter{}));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(tree.GetNodes().size()));
+}
+BENCHMARK(BM_NodeTreeWalk)->Arg(10000);
+
+static auto BM_NodeTreeWalkVirtual(benchmark::State& state) -> void {
+  const auto source = MakeGrammar(static_cast<size_t>(state.range(0)));
+  const auto tree = ParseOrDie(source);
+  kero::peg::Arena arena;
+  const auto root = tree.ToNode(arena);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CountVirtual(*root));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(tree.GetNodes().size()));
+}
+BENCHMARK(BM_NodeTreeWalkVirtual)->Arg(10000);
+
+static auto BM_ParseNestedGroups(benchmark::State& state) -> void {
+  const auto depth = static_cast<size_t>(state.range(0));
+  const auto source =
+      "A <- " + std::string(depth, '(') + "'a'" + std::string(depth, ')');
+  for (auto _ : state) {
+    auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}, depth}};
+    auto res = parser.ParseRuleSet();
+    if (res.IsErr()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(res.Ok()->GetNodes().data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_ParseNestedGroups)->Arg(10000);
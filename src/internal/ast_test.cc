@@ -0,0 +1,328 @@
+#include "./ast.h"
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+static_assert(std::is_trivially_destructible_v<kero::peg::ast::RuleSet>);
+static_assert(std::is_trivially_destructible_v<kero::peg::ast::Sequence>);
+static_assert(std::is_trivially_destructible_v<kero::peg::ast::NonTerminal>);
+static_assert(
+    std::is_trivially_destructible_v<kero::peg::ast::BracketedTerminal>);
+
+auto ParseOk(const std::string_view source) noexcept -> std::string {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto res = parser.ParseRuleSet();
+  EXPECT_TRUE(res.IsOk());
+  if (res.IsErr()) {
+    return "";
+  }
+
+  const auto tree = std::move(*res.Ok());
+  std::ostringstream flat_os;
+  flat_os << tree;
+
+  kero::peg::Arena arena;
+  std::ostringstream node_os;
+  node_os << *tree.ToNode(arena);
+  EXPECT_EQ(flat_os.str(), node_os.str());
+  return flat_os.str();
+}
+
+auto ParseErr(const std::string_view source) noexcept
+    -> kero::peg::ast::ErrorCode {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto res = parser.ParseRuleSet();
+  EXPECT_TRUE(res.IsErr());
+  if (res.IsOk()) {
+    return kero::peg::ast::ErrorCode::kTokenizeError;
+  }
+
+  return res.Err()->error_code;
+}
+
+TEST(ParserTest, Empty) {
+  EXPECT_EQ(ParseOk(""), "RuleSet{}");
+  EXPECT_EQ(ParseOk("\n\n"), "RuleSet{}");
+}
+
+TEST(ParserTest, Rule) {
+  EXPECT_EQ(ParseOk("A <- 'a'"),
+            "RuleSet{Rule{NonTerminal{A}, QuotedTerminal{a}}}");
+}
+
+TEST(ParserTest, Cut) {
+  EXPECT_EQ(ParseOk("A <- 'a' ^ 'b' / 'c'"),
+            "RuleSet{Rule{NonTerminal{A}, OrderedChoice{Sequence{"
+            "QuotedTerminal{a}, Cut, QuotedTerminal{b}}, QuotedTerminal{c}}}}");
+  EXPECT_EQ(ParseOk("A <- ^"), "RuleSet{Rule{NonTerminal{A}, Cut}}");
+  EXPECT_EQ(ParseErr("A <- ^*"), kero::peg::ast::ErrorCode::kTokenNotEndOfLine);
+}
+
+TEST(ParserTest, Rules) {
+  EXPECT_EQ(ParseOk("A <- B\n\nB <- [a-z]\r\n"),
+            "RuleSet{Rule{NonTerminal{A}, NonTerminal{B}}, "
+            "Rule{NonTerminal{B}, BracketedTerminal{a-z}}}");
+}
+
+TEST(ParserTest, Sequence) {
+  EXPECT_EQ(ParseOk("A <- 'a' B .\nB <- 'b'"),
+            "RuleSet{Rule{NonTerminal{A}, "
+            "Sequence{QuotedTerminal{a}, NonTerminal{B}, AnyCharacter}}, "
+            "Rule{NonTerminal{B}, QuotedTerminal{b}}}");
+}
+
+TEST(ParserTest, EmptySequence) {
+  EXPECT_EQ(ParseOk("A <-"), "RuleSet{Rule{NonTerminal{A}, Sequence{}}}");
+  EXPECT_EQ(ParseOk("A <- 'a' /"),
+            "RuleSet{Rule{NonTerminal{A}, "
+            "OrderedChoice{QuotedTerminal{a}, Sequence{}}}}");
+}
+
+TEST(ParserTest, OrderedChoice) {
+  EXPECT_EQ(ParseOk("A <- 'a' / 'b' 'c' / 'd'"),
+            "RuleSet{Rule{NonTerminal{A}, "
+            "OrderedChoice{QuotedTerminal{a}, "
+            "Sequence{QuotedTerminal{b}, QuotedTerminal{c}}, "
+            "QuotedTerminal{d}}}}");
+}
+
+TEST(ParserTest, LongOrderedChoice) {
+  auto source = std::string{"A <- 'k0'"};
+  auto expected = std::string{"RuleSet{Rule{NonTerminal{A}, "
+                              "OrderedChoice{QuotedTerminal{k0}"};
+  for (size_t i{1}; i < 200; ++i) {
+    source += " / 'k" + std::to_string(i) + "'";
+    expected += ", QuotedTerminal{k" + std::to_string(i) + "}";
+  }
+  expected += "}}}";
+  EXPECT_EQ(ParseOk(source), expected);
+}
+
+TEST(ParserTest, Group) {
+  EXPECT_EQ(ParseOk("A <- ('a' / 'b') 'c'"),
+            "RuleSet{Rule{NonTerminal{A}, "
+            "Sequence{Group{OrderedChoice{QuotedTerminal{a}, "
+            "QuotedTerminal{b}}}, QuotedTerminal{c}}}}");
+}
+
+TEST(ParserTest, Suffix) {
+  EXPECT_EQ(ParseOk("A <- 'a'* 'b'+ 'c'?"),
+            "RuleSet{Rule{NonTerminal{A}, "
+            "Sequence{ZeroOrMore{QuotedTerminal{a}}, "
+            "OneOrMore{QuotedTerminal{b}}, Optional{QuotedTerminal{c}}}}}");
+}
+
+TEST(ParserTest, Prefix) {
+  EXPECT_EQ(ParseOk("A <- &'a' !B*\nB <- 'b'"),
+            "RuleSet{Rule{NonTerminal{A}, "
+            "Sequence{AndPredicate{QuotedTerminal{a}}, "
+            "NotPredicate{ZeroOrMore{NonTerminal{B}}}}}, "
+            "Rule{NonTerminal{B}, QuotedTerminal{b}}}");
+}
+
+TEST(ParserTest, GroupPrefixSuffix) {
+  EXPECT_EQ(ParseOk("A <- !('a')+ &(.)? / ()"),
+            "RuleSet{Rule{NonTerminal{A}, OrderedChoice{"
+            "Sequence{NotPredicate{OneOrMore{Group{QuotedTerminal{a}}}}, "
+            "AndPredicate{Optional{Group{AnyCharacter}}}}, "
+            "Group{Sequence{}}}}}");
+}
+
+TEST(ParserTest, Comment) {
+  EXPECT_EQ(ParseOk("Comment <- '#' (!EndOfLine .)* EndOfLine\n"
+                    "EndOfLine <- !."),
+            "RuleSet{Rule{NonTerminal{Comment}, "
+            "Sequence{QuotedTerminal{#}, "
+            "ZeroOrMore{Group{Sequence{NotPredicate{NonTerminal{EndOfLine}}, "
+            "AnyCharacter}}}, NonTerminal{EndOfLine}}}, "
+            "Rule{NonTerminal{EndOfLine}, NotPredicate{AnyCharacter}}}");
+}
+
+TEST(ParserTest, BracketedTerminalCharClass) {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{"A <- [a-c_]"}}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsOk());
+  kero::peg::Arena arena;
+  const auto& rule_set =
+      static_cast<const kero::peg::ast::RuleSet&>(*res.Ok()->ToNode(arena));
+  const auto& rule =
+      static_cast<const kero::peg::ast::Rule&>(*rule_set.GetRules()[0]);
+  const auto& terminal = static_cast<const kero::peg::ast::BracketedTerminal&>(
+      *rule.GetExpression());
+  EXPECT_EQ(terminal.GetCharClass(), kero::peg::CharClass::Compile("a-c_"));
+}
+
+TEST(ParserTest, Errors) {
+  EXPECT_EQ(ParseErr("'a'"), kero::peg::ast::ErrorCode::kTokenNotNonTerminal);
+  EXPECT_EQ(ParseErr("A 'a'"), kero::peg::ast::ErrorCode::kTokenNotLeftArrow);
+  EXPECT_EQ(ParseErr("A <- ('a'"),
+            kero::peg::ast::ErrorCode::kTokenNotRightParenthesis);
+  EXPECT_EQ(ParseErr("A <- 'a')"),
+            kero::peg::ast::ErrorCode::kTokenNotEndOfLine);
+  EXPECT_EQ(ParseErr("A <- !/"), kero::peg::ast::ErrorCode::kTokenNotPrimary);
+  EXPECT_EQ(ParseErr("A <- [z-a]"), kero::peg::ast::ErrorCode::kTokenizeError);
+  EXPECT_EQ(ParseErr("A <- B"),
+            kero::peg::ast::ErrorCode::kNonTerminalUndefined);
+  EXPECT_EQ(ParseErr("A <- 'a'\nA <- 'b'"),
+            kero::peg::ast::ErrorCode::kNonTerminalRedefined);
+}
+
+TEST(ParserTest, UndefinedNonTerminalToken) {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{"A <- B C\nB <- A"}}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsErr());
+  const auto error = *res.Err();
+  ASSERT_TRUE(std::holds_alternative<kero::peg::Token>(error.value));
+  const auto& token = std::get<kero::peg::Token>(error.value);
+  EXPECT_EQ(token.value, "C");
+  EXPECT_EQ(token.original_start, 7);
+}
+
+TEST(ParserTest, Symbols) {
+  auto parser{
+      kero::peg::ast::Parser{kero::peg::Lexer{"A <- B A\nB <- 'b' / A"}}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsOk());
+  const auto tree = std::move(*res.Ok());
+  const auto& symbols = tree.GetSymbols();
+  ASSERT_EQ(symbols.Size(), 2);
+  EXPECT_EQ(symbols.GetName(0), "A");
+  EXPECT_EQ(symbols.GetName(1), "B");
+
+  // Every NonTerminal resolves to the rule named by it.
+  size_t non_terminal_count{};
+  for (const auto& node : tree.GetNodes()) {
+    if (node.kind != kero::peg::ast::NodeKind::kNonTerminal) {
+      continue;
+    }
+    ++non_terminal_count;
+    const auto& rule = tree.GetRule(node.symbol);
+    EXPECT_EQ(rule.kind, kero::peg::ast::NodeKind::kRule);
+    EXPECT_EQ(tree.GetOriginal(tree.GetChildren(rule)[0]),
+              tree.GetOriginal(node));
+  }
+  EXPECT_EQ(non_terminal_count, 5);
+
+  kero::peg::Arena arena;
+  const auto& rule_set =
+      static_cast<const kero::peg::ast::RuleSet&>(*tree.ToNode(arena));
+  const auto& rule_b =
+      static_cast<const kero::peg::ast::Rule&>(*rule_set.GetRules()[1]);
+  const auto& b =
+      static_cast<const kero::peg::ast::NonTerminal&>(*rule_b.GetNonTerminal());
+  EXPECT_EQ(b.GetSymbol(), 1);
+  EXPECT_EQ(rule_set.GetRule(b.GetSymbol()), &rule_b);
+}
+
+TEST(FlatTreeTest, Layout) {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{"A <- B 'c'\nB <- ."}}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsOk());
+  const auto tree = std::move(*res.Ok());
+  const auto nodes = tree.GetNodes();
+  ASSERT_EQ(nodes.size(), 9);
+  EXPECT_EQ(&tree.GetRoot(), &nodes[0]);
+  EXPECT_EQ(tree.GetRoot().kind, kero::peg::ast::NodeKind::kRuleSet);
+
+  // Every node but the root is the child of exactly one node, and children
+  // are adjacent.
+  auto parent_count = std::vector<size_t>(nodes.size());
+  for (const auto& node : nodes) {
+    ASSERT_LE(node.first_child + node.child_count, nodes.size());
+    for (auto i = node.first_child; i < node.first_child + node.child_count;
+         ++i) {
+      ++parent_count[i];
+    }
+  }
+  EXPECT_EQ(parent_count[0], 0);
+  for (size_t i{1}; i < nodes.size(); ++i) {
+    EXPECT_EQ(parent_count[i], 1);
+  }
+
+  const auto rules = tree.GetChildren(tree.GetRoot());
+  ASSERT_EQ(rules.size(), 2);
+  EXPECT_EQ(tree.GetOriginal(rules[0]), "A <- B 'c'");
+  EXPECT_EQ(tree.GetOriginal(rules[1]), "B <- .");
+
+  const auto rule = tree.GetChildren(rules[0]);
+  ASSERT_EQ(rule.size(), 2);
+  EXPECT_EQ(tree.GetOriginal(rule[0]), "A");
+  EXPECT_EQ(tree.GetOriginal(rule[1]), "B 'c'");
+
+  const auto sequence = tree.GetChildren(rule[1]);
+  ASSERT_EQ(sequence.size(), 2);
+  EXPECT_EQ(sequence[1].kind, kero::peg::ast::NodeKind::kQuotedTerminal);
+  EXPECT_EQ(tree.GetOriginal(sequence[1]), "'c'");
+  EXPECT_EQ(tree.GetValue(sequence[1]), "c");
+}
+
+TEST(FlatTreeTest, Spans) {
+  auto parser{
+      kero::peg::ast::Parser{kero::peg::Lexer{"A <- !('a' / [b])* /"}}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsOk());
+  const auto tree = std::move(*res.Ok());
+  const auto rule = tree.GetChildren(tree.GetChildren(tree.GetRoot())[0]);
+  const auto choice = tree.GetChildren(rule[1]);
+  ASSERT_EQ(choice.size(), 2);
+  EXPECT_EQ(tree.GetOriginal(choice[0]), "!('a' / [b])*");
+  EXPECT_EQ(tree.GetOriginal(choice[1]), "");
+
+  const auto zero_or_more = tree.GetChildren(choice[0])[0];
+  EXPECT_EQ(tree.GetOriginal(zero_or_more), "('a' / [b])*");
+  const auto group = tree.GetChildren(zero_or_more)[0];
+  EXPECT_EQ(tree.GetOriginal(tree.GetChildren(group)[0]), "'a' / [b]");
+}
+
+auto NestedGroups(const size_t depth) noexcept -> std::string {
+  return "A <- " + std::string(depth, '(') + "'a'" + std::string(depth, ')');
+}
+
+TEST(ParserTest, DeepNesting) {
+  const auto depth = size_t{100000};
+  const auto source = NestedGroups(depth);
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}, depth}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsOk());
+  const auto tree = std::move(*res.Ok());
+  size_t group_count{};
+  for (const auto& node : tree.GetNodes()) {
+    group_count += node.kind == kero::peg::ast::NodeKind::kGroup;
+  }
+  EXPECT_EQ(group_count, depth);
+}
+
+TEST(ParserTest, MaxDepth) {
+  const auto source = NestedGroups(3);
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}, 3}};
+  EXPECT_TRUE(parser.ParseRuleSet().IsOk());
+
+  const auto deep_source = NestedGroups(4);
+  auto deep_parser{kero::peg::ast::Parser{kero::peg::Lexer{deep_source}, 3}};
+  auto res = deep_parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsErr());
+  const auto error = *res.Err();
+  EXPECT_EQ(error.error_code, kero::peg::ast::ErrorCode::kNestingTooDeep);
+  EXPECT_EQ(std::get<kero::peg::Token>(error.value).original_start, 8);
+}
+
+TEST(ParserTest, SourceTooLarge) {
+  // The check only looks at the size, so the bytes past `source` are never
+  // read.
+  const std::string source{"A <- 'a'"};
+  const auto view = std::string_view{
+      source.data(), size_t{std::numeric_limits<uint32_t>::max()} + 1};
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{view}}};
+  auto res = parser.ParseRuleSet();
+  ASSERT_TRUE(res.IsErr());
+  const auto error = *res.Err();
+  EXPECT_EQ(error.error_code, kero::peg::ast::ErrorCode::kTokenizeError);
+  EXPECT_EQ(std::get<kero::peg::TokenizeError>(error.value).code,
+            kero::peg::TokenizeErrorCode::kSourceTooLarge);
+}
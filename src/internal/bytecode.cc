@@ -0,0 +1,709 @@
+#include "./bytecode.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+// Compiled alternatives of an ordered choice, see GroupAlternatives.
+using Alternative = std::span<ast::Node* const>;
+
+// Shorter runs of literal alternatives are left to kDispatch.
+constexpr size_t kMinTrieLiterals = 4;
+
+// Rules calling rules in the X of `(!X .)*`, such as `EndOfLine <- NewLine /
+// EndOfInput`, are followed this deep.
+constexpr size_t kMaxDelimiterDepth = 8;
+
+class BytecodeCompiler {
+public:
+  BytecodeCompiler(const ast::RuleSet& rule_set,
+                   const BytecodeOptions& options,
+                   BytecodeProgram& program) noexcept
+      : rule_set_{rule_set}, program_{program},
+        literal_tries_{options.literal_tries},
+        scan_until_{options.scan_until} {
+    if (options.dispatch_choices) {
+      analysis_.emplace(rule_set);
+    }
+  }
+
+  auto Compile() noexcept -> void {
+    Emit(Opcode::kEnd);
+    const auto rules = rule_set_.GetRules();
+    program_.rule_addresses.reserve(rules.size());
+    for (const auto node : rules) {
+      const auto& rule = static_cast<const ast::Rule&>(*node);
+      const auto& name =
+          static_cast<const ast::NonTerminal&>(*rule.GetNonTerminal());
+      program_.rule_addresses.push_back(GetAddress());
+      program_.rule_names.push_back(AddText(name.GetName()));
+      cut_has_entry_ = false;
+      Compile(*rule.GetExpression());
+      Emit(Opcode::kReturn);
+    }
+
+    for (const auto& [address, rule_index] : calls_) {
+      program_.code[address].arg = program_.rule_addresses[rule_index];
+    }
+  }
+
+private:
+  auto Compile(const ast::Node& node) noexcept -> void {
+    ast::Visit(node, [this](const auto& concrete) noexcept {
+      Compile(concrete);
+    });
+  }
+
+  // Compiles `node` as the body of a Cut scope. `has_entry` tells whether the
+  // scope pushed a backtrack entry for a Cut to mark.
+  auto CompileScope(const ast::Node& node, const bool has_entry) noexcept
+      -> void {
+    const auto outer = std::exchange(cut_has_entry_, has_entry);
+    Compile(node);
+    cut_has_entry_ = outer;
+  }
+
+  auto Compile(const ast::RuleSet&) noexcept -> void { assert(false); }
+
+  auto Compile(const ast::Rule&) noexcept -> void { assert(false); }
+
+  auto Compile(const ast::NonTerminal& node) noexcept -> void {
+    calls_.emplace_back(GetAddress(),
+                        rule_set_.GetRuleIndex(node.GetSymbol()));
+    Emit(Opcode::kCall);
+  }
+
+  auto Compile(const ast::Sequence& node) noexcept -> void {
+    for (const auto expression : node.GetExpressions()) {
+      Compile(*expression);
+    }
+  }
+
+  //     choice L1
+  //     <alternative 1>
+  //     commit L3
+  // L1: choice L2
+  //     <alternative 2>
+  //     commit L3
+  // L2: <last alternative>
+  // L3:
+  auto Compile(const ast::OrderedChoice& node) noexcept -> void {
+    const auto alternatives = GroupAlternatives(node);
+    if (auto table = MakeChoiceTable(alternatives)) {
+      CompileDispatch(alternatives, std::move(*table));
+      return;
+    }
+
+    std::vector<uint32_t> commits;
+    for (size_t i{}; i + 1 < alternatives.size(); ++i) {
+      const auto choice = Emit(Opcode::kChoice);
+      CompileAlternative(alternatives[i], true);
+      commits.push_back(Emit(Opcode::kCommit));
+      Patch(choice);
+    }
+    CompileAlternative(alternatives.back(), false);
+    for (const auto commit : commits) {
+      Patch(commit);
+    }
+  }
+
+  // The alternatives of `node` as compiled: runs of at least
+  // kMinTrieLiterals literals become one alternative matched by kTrie, any
+  // other expression is one alternative by itself.
+  auto GroupAlternatives(const ast::OrderedChoice& node) const noexcept
+      -> std::vector<Alternative> {
+    const auto nodes = node.GetAlternatives();
+    std::vector<Alternative> alternatives;
+    for (size_t i{}; i < nodes.size();) {
+      auto end = i;
+      while (literal_tries_ && end < nodes.size() &&
+             ast::As<ast::QuotedTerminal>(*nodes[end])) {
+        ++end;
+      }
+      if (end - i < kMinTrieLiterals) {
+        end = i + 1;
+      }
+      alternatives.push_back(nodes.subspan(i, end - i));
+      i = end;
+    }
+    return alternatives;
+  }
+
+  auto CompileAlternative(const Alternative alternative,
+                          const bool has_entry) noexcept -> void {
+    if (alternative.size() == 1) {
+      CompileScope(*alternative[0], has_entry);
+      return;
+    }
+
+    Emit(Opcode::kTrie, AddTrie(alternative));
+  }
+
+  // The jump table of `alternatives`, if the next byte rules out some of them
+  // at some lookahead. An alternative with a Cut may commit the choice before
+  // failing, so it is never ruled out.
+  auto MakeChoiceTable(const std::vector<Alternative>& alternatives) const
+      noexcept -> std::optional<ChoiceTable> {
+    if (!analysis_ || alternatives.size() < 2 ||
+        alternatives.size() > kMaxDispatchAlternatives) {
+      return std::nullopt;
+    }
+
+    ChoiceTable table{};
+    for (size_t i{}; i < alternatives.size(); ++i) {
+      LookaheadSet start;
+      for (const auto expression : alternatives[i]) {
+        start |= ast::Contains(*expression, ast::NodeKind::kCut)
+                     ? LookaheadSet{}.set()
+                     : analysis_->GetFirstSet(*expression).GetStart();
+      }
+      for (size_t lookahead{}; lookahead < start.size(); ++lookahead) {
+        table.alternatives[lookahead] |= uint64_t{start[lookahead]} << i;
+      }
+    }
+
+    const auto all = alternatives.size() == kMaxDispatchAlternatives
+                         ? ~uint64_t{}
+                         : (uint64_t{1} << alternatives.size()) - 1;
+    for (const auto mask : table.alternatives) {
+      if (mask != all) {
+        return table;
+      }
+    }
+    return std::nullopt;
+  }
+
+  //     dispatch {T, 0}
+  // R1: dispatch {T, 1}
+  //     ...
+  // Rn: fail
+  // A0: <alternative 0>
+  //     commit L
+  //     ...
+  // L:
+  //
+  // where T holds A0..An-1 and backtracks from alternative i to R(i+1).
+  auto CompileDispatch(const std::vector<Alternative>& alternatives,
+                       ChoiceTable table) noexcept -> void {
+    // Nested choices add their tables while this one is compiled, so it is
+    // added first and found again by index.
+    const auto table_index =
+        static_cast<uint32_t>(program_.choice_tables.size());
+    program_.choice_tables.push_back(std::move(table));
+    std::vector<uint32_t> retries;
+    for (uint32_t i{}; i < alternatives.size(); ++i) {
+      const auto dispatch = static_cast<uint32_t>(program_.dispatches.size());
+      const auto retry = Emit(Opcode::kDispatch, dispatch);
+      program_.dispatches.push_back(Dispatch{table_index, i});
+      if (i != 0) {
+        retries.push_back(retry);
+      }
+    }
+    retries.push_back(Emit(Opcode::kFail));
+
+    std::vector<uint32_t> addresses;
+    std::vector<uint32_t> commits;
+    for (const auto alternative : alternatives) {
+      addresses.push_back(GetAddress());
+      CompileAlternative(alternative, true);
+      commits.push_back(Emit(Opcode::kCommit));
+    }
+    for (const auto commit : commits) {
+      Patch(commit);
+    }
+    program_.choice_tables[table_index].addresses = std::move(addresses);
+    program_.choice_tables[table_index].retries = std::move(retries);
+  }
+
+  //     choice L2
+  // L1: <expression>
+  //     partial_commit L1
+  // L2:
+  auto Compile(const ast::ZeroOrMore& node) noexcept -> void {
+    if (const auto set =
+            ast::As<ast::BracketedTerminal>(*node.GetExpression())) {
+      Emit(Opcode::kSpan, AddCharClass(*set));
+      return;
+    }
+
+    if (auto delimiter = MakeScanDelimiter(*node.GetExpression())) {
+      program_.scan_delimiters.push_back(std::move(*delimiter));
+      Emit(Opcode::kScanUntil,
+           static_cast<uint32_t>(program_.scan_delimiters.size() - 1));
+      return;
+    }
+
+    CompileLoop(*node.GetExpression(), false);
+  }
+
+  // The X of `body` if it is `!X .`, with X made of parts kScanUntil can
+  // search for.
+  auto MakeScanDelimiter(const ast::Node& body) noexcept
+      -> std::optional<ScanDelimiter> {
+    const auto sequence = ast::As<ast::Sequence>(SkipGroups(body));
+    if (!scan_until_ || !sequence || sequence->GetExpressions().size() != 2) {
+      return std::nullopt;
+    }
+    const auto expressions = sequence->GetExpressions();
+    const auto predicate =
+        ast::As<ast::NotPredicate>(SkipGroups(*expressions[0]));
+    if (!predicate ||
+        !ast::As<ast::AnyCharacter>(SkipGroups(*expressions[1]))) {
+      return std::nullopt;
+    }
+
+    ScanDelimiter delimiter{};
+    std::vector<std::string_view> literals;
+    std::string source;
+    if (!AddDelimiter(*predicate->GetExpression(), 0, delimiter, literals,
+                      source)) {
+      return std::nullopt;
+    }
+
+    delimiter.first_bytes = delimiter.single_bytes;
+    for (const auto literal : literals) {
+      delimiter.first_bytes.Add(static_cast<unsigned char>(literal[0]));
+      delimiter.literals.push_back(AddText(literal));
+    }
+    delimiter.source = AddText(source);
+    return delimiter;
+  }
+
+  // Adds the matches of `node` to `delimiter`, or returns false if it has a
+  // part other than a non-empty literal, a bracketed terminal or `!.`, which
+  // matches only where the scan ends anyway. Rules are followed up to
+  // kMaxDelimiterDepth deep.
+  auto AddDelimiter(const ast::Node& node, const size_t depth,
+                    ScanDelimiter& delimiter,
+                    std::vector<std::string_view>& literals,
+                    std::string& source) const noexcept -> bool {
+    const auto separate = [&source]() noexcept {
+      if (!source.empty()) {
+        source += " / ";
+      }
+    };
+    return ast::Visit(node, [&](const auto& concrete) noexcept -> bool {
+      using T = std::decay_t<decltype(concrete)>;
+      if constexpr (std::is_same_v<T, ast::QuotedTerminal>) {
+        const auto value = concrete.GetValue();
+        if (value.empty()) {
+          return false;
+        }
+        if (value.size() == 1) {
+          delimiter.single_bytes.Add(static_cast<unsigned char>(value[0]));
+        } else {
+          literals.push_back(value);
+        }
+        separate();
+        source += "'";
+        source += value;
+        source += "'";
+        return true;
+      } else if constexpr (std::is_same_v<T, ast::BracketedTerminal>) {
+        for (size_t byte{}; byte < 256; ++byte) {
+          if (concrete.GetCharClass().Contains(static_cast<char>(byte))) {
+            delimiter.single_bytes.Add(static_cast<unsigned char>(byte));
+          }
+        }
+        separate();
+        source += "[";
+        source += concrete.GetValue();
+        source += "]";
+        return true;
+      } else if constexpr (std::is_same_v<T, ast::NotPredicate>) {
+        const auto& expression = SkipGroups(*concrete.GetExpression());
+        if (!ast::As<ast::AnyCharacter>(expression)) {
+          return false;
+        }
+        separate();
+        source += "!.";
+        return true;
+      } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+        for (const auto alternative : concrete.GetAlternatives()) {
+          if (!AddDelimiter(*alternative, depth, delimiter, literals,
+                            source)) {
+            return false;
+          }
+        }
+        return true;
+      } else if constexpr (std::is_same_v<T, ast::Group>) {
+        return AddDelimiter(*concrete.GetExpression(), depth, delimiter,
+                            literals, source);
+      } else if constexpr (std::is_same_v<T, ast::NonTerminal>) {
+        if (depth == kMaxDelimiterDepth) {
+          return false;
+        }
+        const auto& rule = static_cast<const ast::Rule&>(
+            *rule_set_.GetRules()[rule_set_.GetRuleIndex(
+                concrete.GetSymbol())]);
+        return AddDelimiter(*rule.GetExpression(), depth + 1, delimiter,
+                            literals, source);
+      } else {
+        return false;
+      }
+    });
+  }
+
+  // The loop of ZeroOrMore with its backtrack entry cut up front, so failing
+  // the first iteration fails the whole. kPartialCommit clears the cut for
+  // later iterations, and the body is not compiled twice.
+  auto Compile(const ast::OneOrMore& node) noexcept -> void {
+    if (const auto set =
+            ast::As<ast::BracketedTerminal>(*node.GetExpression())) {
+      const auto char_class = AddCharClass(*set);
+      Emit(Opcode::kSet, char_class);
+      Emit(Opcode::kSpan, char_class);
+      return;
+    }
+
+    CompileLoop(*node.GetExpression(), true);
+  }
+
+  auto CompileLoop(const ast::Node& expression,
+                   const bool at_least_once) noexcept -> void {
+    const auto choice = Emit(Opcode::kChoice);
+    if (at_least_once) {
+      Emit(Opcode::kCut);
+    }
+    const auto body = GetAddress();
+    CompileScope(expression, true);
+    Emit(Opcode::kPartialCommit, body);
+    Patch(choice);
+  }
+
+  //     choice L1
+  //     <expression>
+  //     commit L1
+  // L1:
+  auto Compile(const ast::Optional& node) noexcept -> void {
+    const auto choice = Emit(Opcode::kChoice);
+    CompileScope(*node.GetExpression(), true);
+    Patch(Emit(Opcode::kCommit));
+    Patch(choice);
+  }
+
+  //     choice L1
+  //     <expression>
+  //     back_commit L2
+  // L1: fail
+  // L2:
+  auto Compile(const ast::AndPredicate& node) noexcept -> void {
+    const auto choice = Emit(Opcode::kChoice);
+    CompileScope(*node.GetExpression(), false);
+    const auto back_commit = Emit(Opcode::kBackCommit);
+    Patch(choice);
+    Emit(Opcode::kFail);
+    Patch(back_commit);
+  }
+
+  //     choice L1
+  //     <expression>
+  //     fail_twice
+  // L1:
+  auto Compile(const ast::NotPredicate& node) noexcept -> void {
+    const auto choice = Emit(Opcode::kChoice);
+    CompileScope(*node.GetExpression(), false);
+    Emit(Opcode::kFailTwice);
+    Patch(choice);
+  }
+
+  auto Compile(const ast::Group& node) noexcept -> void {
+    Compile(*node.GetExpression());
+  }
+
+  auto Compile(const ast::AnyCharacter&) noexcept -> void {
+    Emit(Opcode::kAny);
+  }
+
+  auto Compile(const ast::QuotedTerminal& node) noexcept -> void {
+    const auto value = node.GetValue();
+    if (value.empty()) {
+      return;
+    }
+
+    if (value.size() == 1) {
+      Emit(Opcode::kChar, static_cast<unsigned char>(value[0]));
+      return;
+    }
+
+    program_.literals.push_back(AddText(value));
+    Emit(Opcode::kString,
+         static_cast<uint32_t>(program_.literals.size() - 1));
+  }
+
+  auto Compile(const ast::BracketedTerminal& node) noexcept -> void {
+    Emit(Opcode::kSet, AddCharClass(node));
+  }
+
+  auto Compile(const ast::Cut&) noexcept -> void {
+    if (cut_has_entry_) {
+      Emit(Opcode::kCut);
+    }
+  }
+
+  static auto SkipGroups(const ast::Node& node) noexcept -> const ast::Node& {
+    const auto group = ast::As<ast::Group>(node);
+    return group ? SkipGroups(*group->GetExpression()) : node;
+  }
+
+  auto GetAddress() const noexcept -> uint32_t {
+    return static_cast<uint32_t>(program_.code.size());
+  }
+
+  auto Emit(const Opcode opcode, const uint32_t arg = 0) noexcept
+      -> uint32_t {
+    program_.code.push_back(Instruction{opcode, arg});
+    return GetAddress() - 1;
+  }
+
+  // Points the jump at `address` to the next instruction.
+  auto Patch(const uint32_t address) noexcept -> void {
+    program_.code[address].arg = GetAddress();
+  }
+
+  auto AddText(const std::string_view value) noexcept -> TextRef {
+    const auto start = static_cast<uint32_t>(program_.text.size());
+    program_.text += value;
+    return TextRef{start, static_cast<uint32_t>(value.size())};
+  }
+
+  auto AddCharClass(const ast::BracketedTerminal& node) noexcept -> uint32_t {
+    program_.char_classes.push_back(node.GetCharClass());
+    program_.char_class_sources.push_back(AddText(node.GetValue()));
+    return static_cast<uint32_t>(program_.char_classes.size() - 1);
+  }
+
+  // Adds a LiteralTrie of `literals`, QuotedTerminals in choice order.
+  auto AddTrie(const Alternative literals) noexcept -> uint32_t {
+    // Children of each node by byte. Nodes are numbered in creation order,
+    // so children come after their parents.
+    std::vector<std::vector<std::pair<unsigned char, uint32_t>>> children(1);
+    std::vector<uint32_t> ends(1, kNoAlternative);
+    LiteralTrie trie{static_cast<uint32_t>(program_.trie_nodes.size()),
+                     static_cast<uint32_t>(program_.literals.size()),
+                     static_cast<uint32_t>(literals.size())};
+    for (uint32_t i{}; i < literals.size(); ++i) {
+      const auto value =
+          static_cast<const ast::QuotedTerminal&>(*literals[i]).GetValue();
+      program_.literals.push_back(AddText(value));
+      uint32_t node{};
+      for (const auto ch : value) {
+        const auto byte = static_cast<unsigned char>(ch);
+        const auto child = std::find_if(
+            children[node].begin(), children[node].end(),
+            [byte](const auto& edge) noexcept { return edge.first == byte; });
+        if (child != children[node].end()) {
+          node = child->second;
+          continue;
+        }
+        const auto next = static_cast<uint32_t>(children.size());
+        children[node].emplace_back(byte, next);
+        children.emplace_back();
+        ends.push_back(kNoAlternative);
+        node = next;
+      }
+      // A later literal equal to an earlier one never wins.
+      ends[node] = std::min(ends[node], i);
+    }
+
+    std::vector<uint32_t> first_below(ends);
+    for (auto node = children.size(); node-- > 0;) {
+      for (const auto& [byte, child] : children[node]) {
+        first_below[node] = std::min(first_below[node], first_below[child]);
+      }
+    }
+    for (size_t node{}; node < children.size(); ++node) {
+      auto& edges = children[node];
+      std::sort(edges.begin(), edges.end());
+      program_.trie_nodes.push_back(
+          TrieNode{static_cast<uint32_t>(program_.trie_edges.size()),
+                   static_cast<uint32_t>(edges.size()), ends[node],
+                   first_below[node]});
+      for (const auto& [byte, child] : edges) {
+        program_.trie_edges.push_back(TrieEdge{byte, trie.root + child});
+      }
+    }
+
+    program_.tries.push_back(trie);
+    return static_cast<uint32_t>(program_.tries.size() - 1);
+  }
+
+  const ast::RuleSet& rule_set_;
+  BytecodeProgram& program_;
+  // First sets for kDispatch, if enabled.
+  std::optional<GrammarAnalysis> analysis_;
+  bool literal_tries_{};
+  bool scan_until_{};
+  // kCall addresses to point at their rules once every rule has one.
+  std::vector<std::pair<uint32_t, uint32_t>> calls_;
+  bool cut_has_entry_{};
+};
+
+} // namespace
+
+auto operator<<(std::ostream& os, const Opcode opcode) noexcept
+    -> std::ostream& {
+  switch (opcode) {
+  case Opcode::kEnd:
+    os << "end";
+    break;
+  case Opcode::kChar:
+    os << "char";
+    break;
+  case Opcode::kString:
+    os << "string";
+    break;
+  case Opcode::kAny:
+    os << "any";
+    break;
+  case Opcode::kSet:
+    os << "set";
+    break;
+  case Opcode::kSpan:
+    os << "span";
+    break;
+  case Opcode::kChoice:
+    os << "choice";
+    break;
+  case Opcode::kCommit:
+    os << "commit";
+    break;
+  case Opcode::kPartialCommit:
+    os << "partial_commit";
+    break;
+  case Opcode::kBackCommit:
+    os << "back_commit";
+    break;
+  case Opcode::kFailTwice:
+    os << "fail_twice";
+    break;
+  case Opcode::kCut:
+    os << "cut";
+    break;
+  case Opcode::kCall:
+    os << "call";
+    break;
+  case Opcode::kReturn:
+    os << "return";
+    break;
+  case Opcode::kFail:
+    os << "fail";
+    break;
+  case Opcode::kDispatch:
+    os << "dispatch";
+    break;
+  case Opcode::kTrie:
+    os << "trie";
+    break;
+  case Opcode::kScanUntil:
+    os << "scan_until";
+    break;
+  }
+  return os;
+}
+
+auto CompileBytecode(const ast::RuleSet& rule_set,
+                     const BytecodeOptions& options) noexcept
+    -> BytecodeProgram {
+  BytecodeProgram program;
+  BytecodeCompiler{rule_set, options, program}.Compile();
+  return program;
+}
+
+auto operator<<(std::ostream& os, const BytecodeProgram& program) noexcept
+    -> std::ostream& {
+  // The rule starting at `address`, to label it and name call targets.
+  const auto rule_at = [&program](const uint32_t address) noexcept
+      -> std::optional<size_t> {
+    const auto& addresses = program.rule_addresses;
+    for (size_t i{}; i < addresses.size(); ++i) {
+      if (addresses[i] == address) {
+        return i;
+      }
+    }
+    return std::nullopt;
+  };
+
+  const auto fill = os.fill();
+  for (size_t address{}; address < program.code.size(); ++address) {
+    const auto address32 = static_cast<uint32_t>(address);
+    if (const auto rule = rule_at(address32)) {
+      os << program.GetText(program.rule_names[*rule]) << ":\n";
+    }
+
+    const auto& instruction = program.code[address];
+    os << std::setfill('0') << std::setw(4) << address << std::setfill(fill)
+       << "  " << instruction.opcode;
+    switch (instruction.opcode) {
+    case Opcode::kChar:
+      os << " '" << static_cast<char>(instruction.arg) << "'";
+      break;
+    case Opcode::kString:
+      os << " '" << program.GetText(program.literals[instruction.arg])
+         << "'";
+      break;
+    case Opcode::kSet:
+    case Opcode::kSpan:
+      os << " ["
+         << program.GetText(program.char_class_sources[instruction.arg])
+         << "]";
+      break;
+    case Opcode::kChoice:
+    case Opcode::kCommit:
+    case Opcode::kPartialCommit:
+    case Opcode::kBackCommit:
+      os << " " << std::setfill('0') << std::setw(4) << instruction.arg
+         << std::setfill(fill);
+      break;
+    case Opcode::kDispatch: {
+      // The alternatives it picks from.
+      const auto dispatch = program.dispatches[instruction.arg];
+      const auto& addresses =
+          program.choice_tables[dispatch.table].addresses;
+      for (auto i = dispatch.first; i < addresses.size(); ++i) {
+        os << " " << std::setfill('0') << std::setw(4) << addresses[i]
+           << std::setfill(fill);
+      }
+      break;
+    }
+    case Opcode::kTrie: {
+      const auto& trie = program.tries[instruction.arg];
+      for (auto i = trie.first_literal;
+           i < trie.first_literal + trie.literal_count; ++i) {
+        os << " '" << program.GetText(program.literals[i]) << "'";
+      }
+      break;
+    }
+    case Opcode::kScanUntil:
+      os << " "
+         << program.GetText(program.scan_delimiters[instruction.arg].source);
+      break;
+    case Opcode::kCall:
+      os << " " << program.GetText(program.rule_names[*rule_at(
+                       instruction.arg)]);
+      break;
+    case Opcode::kEnd:
+    case Opcode::kAny:
+    case Opcode::kFailTwice:
+    case Opcode::kCut:
+    case Opcode::kReturn:
+    case Opcode::kFail:
+      break;
+    }
+    os << "\n";
+  }
+  return os;
+}
+
+} // namespace peg
+} // namespace kero
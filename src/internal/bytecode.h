@@ -0,0 +1,206 @@
+#ifndef KERO_PEG_INTERNAL_BYTECODE_H
+#define KERO_PEG_INTERNAL_BYTECODE_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./analysis.h"
+#include "./ast.h"
+#include "./char_class.h"
+
+namespace kero {
+namespace peg {
+
+// Instructions of the parsing machine in bytecode_vm.h. The machine has a
+// position in the input, a program counter and one stack of backtrack
+// entries and return addresses. Failing pops to the latest backtrack entry,
+// restores its position and jumps to its target; with none left the parse
+// fails.
+enum class Opcode : uint8_t {
+  // Stops with a match at the current position.
+  kEnd = 0,
+  // Matches the byte `arg`.
+  kChar,
+  // Matches the literal `arg` of the program.
+  kString,
+  // Matches any byte.
+  kAny,
+  // Matches a byte of char class `arg`.
+  kSet,
+  // Matches any number of bytes of char class `arg`; never fails.
+  kSpan,
+  // Pushes a backtrack entry to `arg` at the current position.
+  kChoice,
+  // Pops the backtrack entry and jumps to `arg`.
+  kCommit,
+  // Moves the backtrack entry to the current position, clears its cut and
+  // jumps to `arg`, for loops. If the position did not move since the entry,
+  // pops it and falls through instead, so loops whose body matches nothing
+  // still end.
+  kPartialCommit,
+  // Pops the backtrack entry, restores its position and jumps to `arg`, for
+  // `&e`.
+  kBackCommit,
+  // Pops the backtrack entry and fails, for `!e`.
+  kFailTwice,
+  // Marks the backtrack entry cut: failing to it keeps on failing.
+  kCut,
+  // Pushes the next address and jumps to the rule at `arg`.
+  kCall,
+  // Pops a return address and jumps to it.
+  kReturn,
+  // Fails.
+  kFail,
+  // Picks the first alternative at or after `dispatches[arg].first` of a
+  // ChoiceTable that may match the next byte, pushes a backtrack entry to
+  // retry the ones after it and jumps to it. Fails if there is none.
+  kDispatch,
+  // Matches the first alternative of LiteralTrie `arg` that the input starts
+  // with.
+  kTrie,
+  // Moves to the first position where ScanDelimiter `arg` matches, or the end
+  // of the input; never fails. This is `(!X .)*`.
+  kScanUntil,
+};
+
+auto operator<<(std::ostream& os, const Opcode opcode) noexcept
+    -> std::ostream&;
+
+struct Instruction {
+  Opcode opcode;
+  uint32_t arg;
+};
+
+static_assert(sizeof(Instruction) == 8);
+
+// A slice of BytecodeProgram::text.
+struct TextRef {
+  uint32_t start;
+  uint32_t length;
+};
+
+// Maximum alternatives of a choice compiled to kDispatch, one bit each.
+constexpr size_t kMaxDispatchAlternatives = 64;
+
+// The jump table of an ordered choice.
+struct ChoiceTable {
+  // Bit i is set if alternative i may match at the lookahead, a byte or
+  // kEndOfInput.
+  std::array<uint64_t, kEndOfInput + 1> alternatives;
+  // Address of each alternative.
+  std::vector<uint32_t> addresses;
+  // Address to backtrack to from each alternative, which retries the later
+  // ones.
+  std::vector<uint32_t> retries;
+};
+
+// Operand of kDispatch.
+struct Dispatch {
+  uint32_t table;
+  uint32_t first;
+};
+
+constexpr uint32_t kNoAlternative = std::numeric_limits<uint32_t>::max();
+
+struct TrieNode {
+  // Children, in trie_edges[first_edge, first_edge + edge_count) sorted by
+  // byte.
+  uint32_t first_edge;
+  uint32_t edge_count;
+  // The first alternative ending here, or kNoAlternative.
+  uint32_t alternative;
+  // The first alternative ending here or below, to stop walking once no
+  // longer literal can win.
+  uint32_t first_below;
+};
+
+struct TrieEdge {
+  unsigned char byte;
+  uint32_t node;
+};
+
+// Literal alternatives of an ordered choice merged into a trie, so matching
+// them walks the input once rather than comparing each literal in turn.
+struct LiteralTrie {
+  // Index of the root in trie_nodes.
+  uint32_t root;
+  // The alternatives in order, literals[first_literal, first_literal +
+  // literal_count).
+  uint32_t first_literal;
+  uint32_t literal_count;
+};
+
+// The X of a `(!X .)*` loop made of literals and bracketed terminals, for
+// kScanUntil.
+struct ScanDelimiter {
+  // First bytes of every match of X, searched for 16 or 32 bytes at a time.
+  CharClass first_bytes;
+  // Bytes matching X on their own.
+  CharClass single_bytes;
+  // Literals of X longer than a byte.
+  std::vector<TextRef> literals;
+  // X as written, for the disassembler.
+  TextRef source;
+};
+
+// An ast::RuleSet lowered to instructions. Address 0 holds kEnd, which the
+// machine returns to after the start rule.
+struct BytecodeProgram {
+  std::vector<Instruction> code;
+  // Address of the first instruction of each rule, by rule index.
+  std::vector<uint32_t> rule_addresses;
+  std::vector<CharClass> char_classes;
+  std::vector<ChoiceTable> choice_tables;
+  std::vector<Dispatch> dispatches;
+  std::vector<LiteralTrie> tries;
+  std::vector<TrieNode> trie_nodes;
+  std::vector<TrieEdge> trie_edges;
+  std::vector<ScanDelimiter> scan_delimiters;
+  // Literals, char class sources and rule names, for kString and the
+  // disassembler.
+  std::string text;
+  std::vector<TextRef> literals;
+  std::vector<TextRef> char_class_sources;
+  std::vector<TextRef> rule_names;
+
+  auto GetText(const TextRef ref) const noexcept -> std::string_view {
+    return std::string_view{text}.substr(ref.start, ref.length);
+  }
+};
+
+struct BytecodeOptions {
+  // Compiles ordered choices whose alternatives start on different bytes to
+  // kDispatch, which skips the alternatives the next byte rules out instead
+  // of trying each in turn. A skipped alternative reports no failure, so an
+  // error may be reported nearer than without.
+  bool dispatch_choices{true};
+  // Compiles runs of literal alternatives, such as the keywords of a
+  // language, to one kTrie. The first literal the input starts with still
+  // wins, as when trying them in turn.
+  bool literal_tries{true};
+  // Compiles `(!X .)*`, where X is a literal, a bracketed terminal, `!.` or
+  // a choice or rule of those, to one kScanUntil.
+  bool scan_until{true};
+};
+
+// Lowers every rule of `rule_set`. Single-byte literals become kChar and
+// `[...]*` becomes kSpan. A Cut is emitted only where its scope pushed a
+// backtrack entry; elsewhere it commits nothing and is dropped.
+auto CompileBytecode(const ast::RuleSet& rule_set,
+                     const BytecodeOptions& options = {}) noexcept
+    -> BytecodeProgram;
+
+// Disassembles the program, one instruction per line with rule labels, e.g.
+// `0001  char 'a'`.
+auto operator<<(std::ostream& os, const BytecodeProgram& program) noexcept
+    -> std::ostream&;
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_BYTECODE_H
@@ -0,0 +1,189 @@
+#include "./bytecode.h"
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+static auto Disassemble(const std::string_view source,
+                        const kero::peg::BytecodeOptions& options = {})
+    noexcept -> std::string {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto tree = parser.ParseRuleSet();
+  EXPECT_TRUE(tree.IsOk());
+  if (tree.IsErr()) {
+    return "";
+  }
+
+  kero::peg::Arena arena;
+  const auto rule_set =
+      static_cast<const kero::peg::ast::RuleSet*>(tree.Ok()->ToNode(arena));
+  std::ostringstream os;
+  os << kero::peg::CompileBytecode(*rule_set, options);
+  return os.str();
+}
+
+TEST(BytecodeTest, Terminals) {
+  EXPECT_EQ(Disassemble("A <- 'a' 'bc' [0-9] ."), "0000  end\n"
+                                                  "A:\n"
+                                                  "0001  char 'a'\n"
+                                                  "0002  string 'bc'\n"
+                                                  "0003  set [0-9]\n"
+                                                  "0004  any\n"
+                                                  "0005  return\n");
+}
+
+TEST(BytecodeTest, OrderedChoice) {
+  EXPECT_EQ(Disassemble("A <- 'a' / 'b' / 'c'", {.dispatch_choices = false}),
+            "0000  end\n"
+            "A:\n"
+            "0001  choice 0004\n"
+            "0002  char 'a'\n"
+            "0003  commit 0008\n"
+            "0004  choice 0007\n"
+            "0005  char 'b'\n"
+            "0006  commit 0008\n"
+            "0007  char 'c'\n"
+            "0008  return\n");
+}
+
+TEST(BytecodeTest, Dispatch) {
+  EXPECT_EQ(Disassemble("A <- 'a' / 'b' / 'c'"),
+            "0000  end\n"
+            "A:\n"
+            "0001  dispatch 0005 0007 0009\n"
+            "0002  dispatch 0007 0009\n"
+            "0003  dispatch 0009\n"
+            "0004  fail\n"
+            "0005  char 'a'\n"
+            "0006  commit 0011\n"
+            "0007  char 'b'\n"
+            "0008  commit 0011\n"
+            "0009  char 'c'\n"
+            "0010  commit 0011\n"
+            "0011  return\n");
+
+  // Alternatives that may match at any lookahead leave nothing to skip.
+  EXPECT_EQ(Disassemble("A <- [a]* / [b]*"), "0000  end\n"
+                                             "A:\n"
+                                             "0001  choice 0004\n"
+                                             "0002  span [a]\n"
+                                             "0003  commit 0005\n"
+                                             "0004  span [b]\n"
+                                             "0005  return\n");
+}
+
+TEST(BytecodeTest, Trie) {
+  EXPECT_EQ(Disassemble("A <- 'a' / 'ab' / 'b' / 'c'"),
+            "0000  end\n"
+            "A:\n"
+            "0001  trie 'a' 'ab' 'b' 'c'\n"
+            "0002  return\n");
+
+  EXPECT_EQ(Disassemble("A <- 'if' / 'in' / 'else' / 'end' / [a-z]+"),
+            "0000  end\n"
+            "A:\n"
+            "0001  dispatch 0004 0006\n"
+            "0002  dispatch 0006\n"
+            "0003  fail\n"
+            "0004  trie 'if' 'in' 'else' 'end'\n"
+            "0005  commit 0009\n"
+            "0006  set [a-z]\n"
+            "0007  span [a-z]\n"
+            "0008  commit 0009\n"
+            "0009  return\n");
+}
+
+TEST(BytecodeTest, Repetition) {
+  EXPECT_EQ(Disassemble("A <- [a-z]* [0-9]+ ('a' 'b')* ('c')+"),
+            "0000  end\n"
+            "A:\n"
+            "0001  span [a-z]\n"
+            "0002  set [0-9]\n"
+            "0003  span [0-9]\n"
+            "0004  choice 0008\n"
+            "0005  char 'a'\n"
+            "0006  char 'b'\n"
+            "0007  partial_commit 0005\n"
+            "0008  choice 0012\n"
+            "0009  cut\n"
+            "0010  char 'c'\n"
+            "0011  partial_commit 0010\n"
+            "0012  return\n");
+}
+
+TEST(BytecodeTest, ScanUntil) {
+  EXPECT_EQ(Disassemble("A <- '\"' (!'\"' .)* '\"'"), "0000  end\n"
+                                                     "A:\n"
+                                                     "0001  char '\"'\n"
+                                                     "0002  scan_until '\"'\n"
+                                                     "0003  char '\"'\n"
+                                                     "0004  return\n");
+
+  // X may be a choice, through rules.
+  EXPECT_TRUE(Disassemble("A <- (!End .)*\nEnd <- Stop / !.\n"
+                          "Stop <- '*/' / [;]\n")
+                  .starts_with("0000  end\n"
+                               "A:\n"
+                               "0001  scan_until '*/' / [;] / !.\n"
+                               "0002  return\n"));
+
+  // Anything else in X stays a loop.
+  EXPECT_EQ(Disassemble("A <- (!('a' 'b') .)*"), "0000  end\n"
+                                                 "A:\n"
+                                                 "0001  choice 0008\n"
+                                                 "0002  choice 0006\n"
+                                                 "0003  char 'a'\n"
+                                                 "0004  char 'b'\n"
+                                                 "0005  fail_twice\n"
+                                                 "0006  any\n"
+                                                 "0007  partial_commit 0002\n"
+                                                 "0008  return\n");
+}
+
+TEST(BytecodeTest, OptionalAndPredicates) {
+  EXPECT_EQ(Disassemble("A <- 'a'? &'b' !'c'"), "0000  end\n"
+                                                "A:\n"
+                                                "0001  choice 0004\n"
+                                                "0002  char 'a'\n"
+                                                "0003  commit 0004\n"
+                                                "0004  choice 0007\n"
+                                                "0005  char 'b'\n"
+                                                "0006  back_commit 0008\n"
+                                                "0007  fail\n"
+                                                "0008  choice 0011\n"
+                                                "0009  char 'c'\n"
+                                                "0010  fail_twice\n"
+                                                "0011  return\n");
+}
+
+TEST(BytecodeTest, Calls) {
+  EXPECT_EQ(Disassemble("A <- B B\nB <- 'b'\n"), "0000  end\n"
+                                                 "A:\n"
+                                                 "0001  call B\n"
+                                                 "0002  call B\n"
+                                                 "0003  return\n"
+                                                 "B:\n"
+                                                 "0004  char 'b'\n"
+                                                 "0005  return\n");
+}
+
+TEST(BytecodeTest, Cut) {
+  // The last alternative has no backtrack entry to cut, and a cut in a
+  // predicate commits nothing.
+  EXPECT_EQ(Disassemble("A <- 'a' ^ / 'b' ^ / !(^ 'c') ^"),
+            "0000  end\n"
+            "A:\n"
+            "0001  choice 0005\n"
+            "0002  char 'a'\n"
+            "0003  cut\n"
+            "0004  commit 0012\n"
+            "0005  choice 0009\n"
+            "0006  char 'b'\n"
+            "0007  cut\n"
+            "0008  commit 0012\n"
+            "0009  choice 0012\n"
+            "0010  char 'c'\n"
+            "0011  fail_twice\n"
+            "0012  return\n");
+}
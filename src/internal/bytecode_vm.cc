@@ -0,0 +1,259 @@
+#include "./bytecode_vm.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+// StackEntry::kind.
+constexpr uint32_t kReturnEntry = 0;
+constexpr uint32_t kBacktrackEntry = 1;
+// A backtrack entry after kCut: failing to it keeps on failing.
+constexpr uint32_t kCutEntry = 2;
+
+// Where `(!X .)*` starting at `position` stops, for the X of `delimiter`.
+auto ScanUntil(const BytecodeProgram& program, const ScanDelimiter& delimiter,
+               const std::string_view input, size_t position) noexcept
+    -> size_t {
+  while (true) {
+    const auto found = delimiter.first_bytes.Find(input.substr(position));
+    if (found == std::string_view::npos) {
+      return input.size();
+    }
+    position += found;
+    if (delimiter.single_bytes.Contains(input[position])) {
+      return position;
+    }
+    for (const auto literal : delimiter.literals) {
+      if (input.substr(position).starts_with(program.GetText(literal))) {
+        return position;
+      }
+    }
+    ++position;
+  }
+}
+
+} // namespace
+
+auto operator<<(std::ostream& os, const BytecodeVmErrorCode code) noexcept
+    -> std::ostream& {
+  switch (code) {
+  case BytecodeVmErrorCode::kNoMatch:
+    os << "NoMatch";
+    break;
+  case BytecodeVmErrorCode::kStackOverflow:
+    os << "StackOverflow";
+    break;
+  }
+  return os;
+}
+
+auto operator<<(std::ostream& os, const BytecodeVmError& error) noexcept
+    -> std::ostream& {
+  os << "BytecodeVmError{";
+  os << "code=" << error.code << ", ";
+  os << "position=" << error.position;
+  os << "}";
+  return os;
+}
+
+auto operator<<(std::ostream& os, const BytecodeVmStats& stats) noexcept
+    -> std::ostream& {
+  os << "BytecodeVmStats{";
+  os << "backtracks=" << stats.backtracks;
+  os << "}";
+  return os;
+}
+
+auto BytecodeVm::Run(const std::string_view input,
+                     const uint32_t rule_index) noexcept
+    -> Result<size_t, BytecodeVmError> {
+  using R = Result<size_t, BytecodeVmError>;
+  assert(rule_index < program_.rule_addresses.size());
+  const auto code = program_.code.data();
+  const auto size = input.size();
+  auto pc = program_.rule_addresses[rule_index];
+  auto position = size_t{};
+  auto farthest = size_t{};
+  stats_ = BytecodeVmStats{};
+  stack_.clear();
+  // The start rule returns to the kEnd at address 0.
+  stack_.push_back(StackEntry{0, kReturnEntry, 0});
+  while (true) {
+    const auto instruction = code[pc];
+    auto matched = true;
+    switch (instruction.opcode) {
+    case Opcode::kEnd:
+      return R{size_t{position}};
+    case Opcode::kChar:
+      matched = position < size &&
+                input[position] == static_cast<char>(instruction.arg);
+      position += matched;
+      ++pc;
+      break;
+    case Opcode::kString: {
+      const auto literal =
+          program_.GetText(program_.literals[instruction.arg]);
+      matched = input.substr(position).starts_with(literal);
+      position += matched ? literal.size() : 0;
+      ++pc;
+      break;
+    }
+    case Opcode::kAny:
+      matched = position < size;
+      position += matched;
+      ++pc;
+      break;
+    case Opcode::kSet:
+      matched = position < size &&
+                program_.char_classes[instruction.arg].Contains(
+                    input[position]);
+      position += matched;
+      ++pc;
+      break;
+    case Opcode::kSpan:
+      position += program_.char_classes[instruction.arg].Span(
+          input.substr(position));
+      ++pc;
+      break;
+    case Opcode::kChoice:
+      if (stack_.size() >= max_stack_) {
+        return R{BytecodeVmError{BytecodeVmErrorCode::kStackOverflow,
+                                 position}};
+      }
+      stack_.push_back(StackEntry{instruction.arg, kBacktrackEntry, position});
+      ++pc;
+      break;
+    case Opcode::kCommit:
+      stack_.pop_back();
+      pc = instruction.arg;
+      break;
+    case Opcode::kPartialCommit: {
+      auto& entry = stack_.back();
+      if (entry.position == position) {
+        stack_.pop_back();
+        ++pc;
+      } else {
+        entry.position = position;
+        entry.kind = kBacktrackEntry;
+        pc = instruction.arg;
+      }
+      break;
+    }
+    case Opcode::kBackCommit:
+      position = stack_.back().position;
+      stack_.pop_back();
+      pc = instruction.arg;
+      break;
+    case Opcode::kFailTwice:
+      // Report `!e` at its start, not where `e` ended.
+      position = stack_.back().position;
+      stack_.pop_back();
+      matched = false;
+      break;
+    case Opcode::kCut:
+      stack_.back().kind = kCutEntry;
+      ++pc;
+      break;
+    case Opcode::kCall:
+      if (stack_.size() >= max_stack_) {
+        return R{BytecodeVmError{BytecodeVmErrorCode::kStackOverflow,
+                                 position}};
+      }
+      stack_.push_back(StackEntry{pc + 1, kReturnEntry, 0});
+      pc = instruction.arg;
+      break;
+    case Opcode::kReturn:
+      pc = stack_.back().address;
+      stack_.pop_back();
+      break;
+    case Opcode::kFail:
+      matched = false;
+      break;
+    case Opcode::kDispatch: {
+      const auto dispatch = program_.dispatches[instruction.arg];
+      const auto& table = program_.choice_tables[dispatch.table];
+      const auto lookahead =
+          position < size ? static_cast<unsigned char>(input[position])
+                          : kEndOfInput;
+      const auto alternatives = table.alternatives[lookahead] >> dispatch.first;
+      if (alternatives == 0) {
+        matched = false;
+        break;
+      }
+      if (stack_.size() >= max_stack_) {
+        return R{BytecodeVmError{BytecodeVmErrorCode::kStackOverflow,
+                                 position}};
+      }
+      const auto alternative =
+          dispatch.first + std::countr_zero(alternatives);
+      stack_.push_back(StackEntry{table.retries[alternative], kBacktrackEntry,
+                                  position});
+      pc = table.addresses[alternative];
+      break;
+    }
+    case Opcode::kScanUntil:
+      position = ScanUntil(program_, program_.scan_delimiters[instruction.arg],
+                           input, position);
+      // As the loop would, where its last `!X .` failed.
+      farthest = std::max(farthest, position);
+      ++pc;
+      break;
+    case Opcode::kTrie: {
+      // The first alternative among the literals the input starts with.
+      const auto& trie = program_.tries[instruction.arg];
+      const auto* node = &program_.trie_nodes[trie.root];
+      auto best = kNoAlternative;
+      size_t length{};
+      for (auto end = position;; ++end) {
+        if (node->alternative < best) {
+          best = node->alternative;
+          length = end - position;
+        }
+        if (end == size || node->first_below >= best) {
+          break;
+        }
+        const auto byte = static_cast<unsigned char>(input[end]);
+        const auto edges = program_.trie_edges.data() + node->first_edge;
+        const auto edge = std::lower_bound(
+            edges, edges + node->edge_count, byte,
+            [](const TrieEdge& candidate, const unsigned char value) noexcept {
+              return candidate.byte < value;
+            });
+        if (edge == edges + node->edge_count || edge->byte != byte) {
+          break;
+        }
+        node = &program_.trie_nodes[edge->node];
+      }
+      matched = best != kNoAlternative;
+      position += length;
+      ++pc;
+      break;
+    }
+    }
+
+    if (matched) {
+      continue;
+    }
+
+    // Unwind to the latest backtrack entry that is not cut.
+    ++stats_.backtracks;
+    farthest = std::max(farthest, position);
+    while (!stack_.empty() && stack_.back().kind != kBacktrackEntry) {
+      stack_.pop_back();
+    }
+    if (stack_.empty()) {
+      return R{BytecodeVmError{BytecodeVmErrorCode::kNoMatch, farthest}};
+    }
+    position = stack_.back().position;
+    pc = stack_.back().address;
+    stack_.pop_back();
+  }
+}
+
+} // namespace peg
+} // namespace kero
@@ -0,0 +1,82 @@
+#ifndef KERO_PEG_INTERNAL_BYTECODE_VM_H
+#define KERO_PEG_INTERNAL_BYTECODE_VM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "./bytecode.h"
+#include "./core.h"
+
+namespace kero {
+namespace peg {
+
+enum class BytecodeVmErrorCode : int32_t {
+  kNoMatch = 0,
+  kStackOverflow,
+};
+
+auto operator<<(std::ostream& os, const BytecodeVmErrorCode code) noexcept
+    -> std::ostream&;
+
+struct BytecodeVmError {
+  BytecodeVmErrorCode code;
+  // The farthest position a match failed at.
+  size_t position;
+};
+
+auto operator<<(std::ostream& os, const BytecodeVmError& error) noexcept
+    -> std::ostream&;
+
+// Counters for one run.
+struct BytecodeVmStats {
+  // Failures, each of which backtracks or ends the run.
+  uint64_t backtracks{};
+};
+
+auto operator<<(std::ostream& os, const BytecodeVmStats& stats) noexcept
+    -> std::ostream&;
+
+// Bounds the backtrack and call stack, which is how left recursion and
+// runaway nesting show up.
+constexpr size_t kBytecodeVmDefaultMaxStack = size_t{1} << 20;
+
+// Runs a BytecodeProgram. Unlike PackratParser it keeps no memo table, so it
+// does no work up front but may rerun a rule at the same position after
+// backtracking.
+class BytecodeVm {
+public:
+  // `program` must outlive the machine.
+  BytecodeVm(const BytecodeProgram& program,
+             const size_t max_stack = kBytecodeVmDefaultMaxStack) noexcept
+      : program_{program}, max_stack_{max_stack} {}
+
+  // Matches the rule at `rule_index` (the first rule by default) at the start
+  // of `input` and returns the length it consumed.
+  auto Run(const std::string_view input, const uint32_t rule_index = 0) noexcept
+      -> Result<size_t, BytecodeVmError>;
+
+  // Counters of the last run.
+  auto GetStats() const noexcept -> const BytecodeVmStats& { return stats_; }
+
+private:
+  struct StackEntry {
+    // Return address, or the target of a backtrack entry.
+    uint32_t address;
+    uint32_t kind;
+    size_t position;
+  };
+
+  const BytecodeProgram& program_;
+  size_t max_stack_;
+  // Kept between runs to reuse its capacity.
+  std::vector<StackEntry> stack_;
+  BytecodeVmStats stats_{};
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_BYTECODE_VM_H
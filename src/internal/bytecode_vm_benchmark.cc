@@ -0,0 +1,228 @@
+#include "./bytecode_vm.h"
+
+#include <string>
+
+#include "./packrat.h"
+#include "./testing/grammar.h"
+#include "benchmark/benchmark.h"
+
+// The same CSV through the tree-walking packrat interpreter and through the
+// bytecode machine; both report MB/s.
+static auto BM_CsvTreeWalk(benchmark::State& state) -> void {
+  const kero::peg::ParsedGrammar grammar{kero::peg::kCsvGrammar};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto input = kero::peg::MakeCsv(static_cast<size_t>(state.range(0)));
+  auto packrat = kero::peg::PackratParser{grammar.GetRuleSet()};
+  for (auto _ : state) {
+    auto res = packrat.Parse(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_CsvTreeWalk)->Arg(10000);
+
+static auto BM_CsvBytecodeVm(benchmark::State& state) -> void {
+  const kero::peg::ParsedGrammar grammar{kero::peg::kCsvGrammar};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto program = kero::peg::CompileBytecode(grammar.GetRuleSet());
+  const auto input = kero::peg::MakeCsv(static_cast<size_t>(state.range(0)));
+  auto vm = kero::peg::BytecodeVm{program};
+  for (auto _ : state) {
+    auto res = vm.Run(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_CsvBytecodeVm)->Arg(10000);
+
+static constexpr std::string_view kKeywordGrammar =
+    "Tokens <- ([ \n]* Token)* [ \n]* !.\n"
+    "Token <- 'break' / 'case' / 'const' / 'continue' / 'default' / 'do' / "
+    "'else' / 'enum' / 'for' / 'goto' / 'if' / 'return' / 'sizeof' / "
+    "'static' / 'struct' / 'switch' / 'typedef' / 'while' / [0-9]+ / "
+    "[a-zA-Z_] [a-zA-Z_0-9]* / '==' / '<=' / '+=' / [+*/<>=;:,(){}]\n";
+
+static auto MakeKeywordSource(const size_t line_count) noexcept
+    -> std::string {
+  std::string input;
+  for (size_t i{}; i < line_count; ++i) {
+    input += "while (count_" + std::to_string(i) +
+             " <= limit) { if (x == 0) break; else total += x * 2; }\n"
+             "switch (mode) { case 1: return value; default: continue; }\n";
+  }
+  return input;
+}
+
+// Arg 0 tries every Token alternative in turn, arg 1 dispatches on the next
+// byte. Reports the failures per input byte. Literal tries are left out,
+// see BM_SqlKeywordsBytecodeVm.
+static auto BM_KeywordsBytecodeVm(benchmark::State& state) -> void {
+  const kero::peg::ParsedGrammar grammar{kKeywordGrammar};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto program = kero::peg::CompileBytecode(
+      grammar.GetRuleSet(),
+      {.dispatch_choices = state.range(0) != 0, .literal_tries = false});
+  const auto input = MakeKeywordSource(5000);
+  auto vm = kero::peg::BytecodeVm{program};
+  for (auto _ : state) {
+    auto res = vm.Run(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+  state.counters["backtracks_per_byte"] =
+      static_cast<double>(vm.GetStats().backtracks) /
+      static_cast<double>(input.size());
+}
+BENCHMARK(BM_KeywordsBytecodeVm)->Arg(0)->Arg(1);
+
+// SQLite's keywords, in alphabetical order.
+static constexpr std::string_view kSqlKeywords[] = {
+    "ABORT", "ACTION", "ADD", "AFTER", "ALL", "ALTER", "ALWAYS", "ANALYZE",
+    "AND", "AS", "ASC", "ATTACH", "AUTOINCREMENT", "BEFORE", "BEGIN",
+    "BETWEEN", "BY", "CASCADE", "CASE", "CAST", "CHECK", "COLLATE", "COLUMN",
+    "COMMIT", "CONFLICT", "CONSTRAINT", "CREATE", "CROSS", "CURRENT",
+    "CURRENT_DATE", "CURRENT_TIME", "CURRENT_TIMESTAMP", "DATABASE", "DEFAULT",
+    "DEFERRABLE", "DEFERRED", "DELETE", "DESC", "DETACH", "DISTINCT", "DO",
+    "DROP", "EACH", "ELSE", "END", "ESCAPE", "EXCEPT", "EXCLUDE", "EXCLUSIVE",
+    "EXISTS", "EXPLAIN", "FAIL", "FILTER", "FIRST", "FOLLOWING", "FOR",
+    "FOREIGN", "FROM", "FULL", "GENERATED", "GLOB", "GROUP", "GROUPS",
+    "HAVING", "IF", "IGNORE", "IMMEDIATE", "IN", "INDEX", "INDEXED",
+    "INITIALLY", "INNER", "INSERT", "INSTEAD", "INTERSECT", "INTO", "IS",
+    "ISNULL", "JOIN", "KEY", "LAST", "LEFT", "LIKE", "LIMIT", "MATCH",
+    "MATERIALIZED", "NATURAL", "NO", "NOT", "NOTHING", "NOTNULL", "NULL",
+    "NULLS", "OF", "OFFSET", "ON", "OR", "ORDER", "OTHERS", "OUTER", "OVER",
+    "PARTITION", "PLAN", "PRAGMA", "PRECEDING", "PRIMARY", "QUERY", "RAISE",
+    "RANGE", "RECURSIVE", "REFERENCES", "REGEXP", "REINDEX", "RELEASE",
+    "RENAME", "REPLACE", "RESTRICT", "RETURNING", "RIGHT", "ROLLBACK", "ROW",
+    "ROWS", "SAVEPOINT", "SELECT", "SET", "TABLE", "TEMP", "TEMPORARY", "THEN",
+    "TIES", "TO", "TRANSACTION", "TRIGGER", "UNBOUNDED", "UNION", "UNIQUE",
+    "UPDATE", "USING", "VACUUM", "VALUES", "VIEW", "VIRTUAL", "WHEN", "WHERE",
+    "WINDOW", "WITH", "WITHOUT",
+};
+
+static auto MakeSqlGrammar() noexcept -> std::string {
+  std::string grammar = "Tokens <- ([ \n]* Token)* [ \n]* !.\n"
+                        "Token <- Keyword ![A-Z_a-z0-9] / [A-Z_a-z0-9]+ / "
+                        "[*=<>,;()]\n"
+                        "Keyword <- ";
+  for (const auto keyword : kSqlKeywords) {
+    grammar += "'";
+    grammar += keyword;
+    grammar += "' / ";
+  }
+  grammar.resize(grammar.size() - 3);
+  grammar += "\n";
+  return grammar;
+}
+
+static auto MakeSqlSource(const size_t statement_count) noexcept
+    -> std::string {
+  std::string input;
+  for (size_t i{}; i < statement_count; ++i) {
+    input += "SELECT DISTINCT name, total FROM orders_" + std::to_string(i) +
+             " LEFT OUTER JOIN users USING (id) WHERE total > 10 AND NOT "
+             "deleted ORDER BY total DESC LIMIT 5;\n"
+             "UPDATE users SET visits = visits WHERE id IN (SELECT id FROM "
+             "recent) RETURNING id;\n";
+  }
+  return input;
+}
+
+// A choice of 147 keywords, beyond kMaxDispatchAlternatives. Arg 0 tries
+// them in turn, 1 adds kDispatch, 2 kTrie and 3 both.
+static auto BM_SqlKeywordsBytecodeVm(benchmark::State& state) -> void {
+  const auto source = MakeSqlGrammar();
+  const kero::peg::ParsedGrammar grammar{source};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto program = kero::peg::CompileBytecode(
+      grammar.GetRuleSet(),
+      {.dispatch_choices = (state.range(0) & 1) != 0,
+       .literal_tries = (state.range(0) & 2) != 0});
+  const auto input = MakeSqlSource(2000);
+  auto vm = kero::peg::BytecodeVm{program};
+  for (auto _ : state) {
+    auto res = vm.Run(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+  state.counters["backtracks_per_byte"] =
+      static_cast<double>(vm.GetStats().backtracks) /
+      static_cast<double>(input.size());
+}
+BENCHMARK(BM_SqlKeywordsBytecodeVm)->DenseRange(0, 3);
+
+static constexpr std::string_view kCommentGrammar =
+    "File <- (Comment / String / [a-z_0-9=;(), \n])* !.\n"
+    "Comment <- '/*' (!'*/' .)* '*/' / '#' (!EndOfLine .)* EndOfLine\n"
+    "EndOfLine <- [\n] / !.\n"
+    "String <- '\"' (!'\"' .)* '\"'\n";
+
+static auto MakeCommentedSource(const size_t line_count) noexcept
+    -> std::string {
+  std::string input;
+  for (size_t i{}; i < line_count; ++i) {
+    input += "/* Builds the greeting shown on the start page; callers * must "
+             "escape it. */\n"
+             "greeting_" +
+             std::to_string(i) +
+             " = format(\"Hello, %s! You have %d new messages.\", name, "
+             "count); # greeting with the unread count\n";
+  }
+  return input;
+}
+
+// Arg 0 runs `(!X .)*` as a loop, arg 1 as kScanUntil.
+static auto BM_CommentsBytecodeVm(benchmark::State& state) -> void {
+  const kero::peg::ParsedGrammar grammar{kCommentGrammar};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto program = kero::peg::CompileBytecode(
+      grammar.GetRuleSet(), {.scan_until = state.range(0) != 0});
+  const auto input = MakeCommentedSource(5000);
+  auto vm = kero::peg::BytecodeVm{program};
+  for (auto _ : state) {
+    auto res = vm.Run(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_CommentsBytecodeVm)->Arg(0)->Arg(1);
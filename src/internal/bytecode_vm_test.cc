@@ -0,0 +1,263 @@
+#include "./bytecode_vm.h"
+
+#include <string>
+#include <string_view>
+
+#include "./packrat.h"
+#include "./testing/grammar.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Owns a grammar compiled to bytecode, and checks every match against
+// PackratParser.
+class Machine {
+public:
+  explicit Machine(const std::string_view source,
+                   const kero::peg::BytecodeOptions& options = {}) noexcept
+      : grammar_{source} {
+    EXPECT_TRUE(grammar_.IsOk());
+    if (grammar_.IsOk()) {
+      program_ = kero::peg::CompileBytecode(grammar_.GetRuleSet(), options);
+    }
+  }
+
+  // The length matched by the first rule, or -1 on failure.
+  auto Match(const std::string_view input) noexcept -> int64_t {
+    auto vm = kero::peg::BytecodeVm{program_};
+    auto res = vm.Run(input);
+    const auto length = res.IsOk() ? static_cast<int64_t>(*res.Ok()) : -1;
+
+    auto packrat = kero::peg::PackratParser{grammar_.GetRuleSet()};
+    auto expected = packrat.Parse(input);
+    EXPECT_EQ(length,
+              expected.IsOk() ? static_cast<int64_t>(*expected.Ok()) : -1)
+        << input;
+    return length;
+  }
+
+  // Failures in matching `input`.
+  auto Backtracks(const std::string_view input) noexcept -> uint64_t {
+    auto vm = kero::peg::BytecodeVm{program_};
+    static_cast<void>(vm.Run(input));
+    return vm.GetStats().backtracks;
+  }
+
+  auto Error(const std::string_view input,
+             const size_t max_stack = kero::peg::kBytecodeVmDefaultMaxStack)
+      -> kero::peg::BytecodeVmError {
+    auto vm = kero::peg::BytecodeVm{program_, max_stack};
+    auto res = vm.Run(input);
+    EXPECT_TRUE(res.IsErr());
+    if (res.IsOk()) {
+      return {kero::peg::BytecodeVmErrorCode::kNoMatch, 0};
+    }
+    return *res.Err();
+  }
+
+private:
+  kero::peg::ParsedGrammar grammar_;
+  kero::peg::BytecodeProgram program_;
+};
+
+} // namespace
+
+TEST(BytecodeVmTest, Terminals) {
+  Machine machine{"A <- 'ab' [0-9] ."};
+  EXPECT_EQ(machine.Match("ab1x"), 4);
+  EXPECT_EQ(machine.Match("ab1"), -1);
+  EXPECT_EQ(machine.Match("ax1x"), -1);
+  EXPECT_EQ(machine.Match("abxx"), -1);
+}
+
+TEST(BytecodeVmTest, OrderedChoice) {
+  Machine machine{"A <- 'a' / 'ab'"};
+  EXPECT_EQ(machine.Match("ab"), 1);
+  EXPECT_EQ(machine.Match("b"), -1);
+}
+
+TEST(BytecodeVmTest, Dispatch) {
+  Machine keywords{"A <- 'if' / 'in' / 'else' / [a-z]+ / '(' A ')' / !."};
+  EXPECT_EQ(keywords.Match("if"), 2);
+  EXPECT_EQ(keywords.Match("in"), 2);
+  EXPECT_EQ(keywords.Match("else"), 4);
+  EXPECT_EQ(keywords.Match("elf"), 3);
+  EXPECT_EQ(keywords.Match("(in)"), 4);
+  EXPECT_EQ(keywords.Match(""), 0);
+  EXPECT_EQ(keywords.Match("("), -1);
+  EXPECT_EQ(keywords.Match("0"), -1);
+
+  Machine predicates{"A <- !'a' 'b' / &'a' . 'c' / 'ad' / 'x'? 'y'?"};
+  EXPECT_EQ(predicates.Match("b"), 1);
+  EXPECT_EQ(predicates.Match("ac"), 2);
+  EXPECT_EQ(predicates.Match("ad"), 2);
+  EXPECT_EQ(predicates.Match("y"), 1);
+  EXPECT_EQ(predicates.Match("z"), 0);
+
+  Machine nested{"A <- 'a' ('b' 'x' / 'c' / 'b') / 'd' / 'a'"};
+  EXPECT_EQ(nested.Match("abx"), 3);
+  EXPECT_EQ(nested.Match("ab"), 2);
+  EXPECT_EQ(nested.Match("ad"), 1);
+  EXPECT_EQ(nested.Match("d"), 1);
+
+  // The cut commits the choice before 'x' fails, so 'y' is never tried.
+  Machine cut{"A <- ^ 'x' / 'y'"};
+  EXPECT_EQ(cut.Match("y"), -1);
+}
+
+TEST(BytecodeVmTest, DispatchSkipsAlternatives) {
+  constexpr std::string_view kGrammar =
+      "A <- ('do' / 'for' / 'if' / 'in' / 'let' / 'new' / 'try' / 'var' / "
+      "'while' / [0-9]+ / ' ')*";
+  constexpr std::string_view kInput = "while 12 var try new if do 3";
+  Machine dispatch{kGrammar, {.literal_tries = false}};
+  Machine choice{kGrammar, {.dispatch_choices = false, .literal_tries = false}};
+  EXPECT_EQ(dispatch.Match(kInput), static_cast<int64_t>(kInput.size()));
+  EXPECT_EQ(choice.Match(kInput), static_cast<int64_t>(kInput.size()));
+  EXPECT_LT(dispatch.Backtracks(kInput) * 5, choice.Backtracks(kInput));
+}
+
+TEST(BytecodeVmTest, Trie) {
+  // Earlier literals win over later ones sharing a prefix, longer or not.
+  Machine machine{"A <- 'ab' / 'abc' / 'a' / 'abd' / 'b' / 'ba' / 'b'"};
+  EXPECT_EQ(machine.Match("abc"), 2);
+  EXPECT_EQ(machine.Match("abd"), 2);
+  EXPECT_EQ(machine.Match("ax"), 1);
+  EXPECT_EQ(machine.Match("ba"), 1);
+  EXPECT_EQ(machine.Match("c"), -1);
+  EXPECT_EQ(machine.Match(""), -1);
+  EXPECT_EQ(machine.Error("c").position, 0);
+
+  Machine empty{"A <- 'x' / 'yz' / '' / 'y' / 'w'"};
+  EXPECT_EQ(empty.Match("yz"), 2);
+  EXPECT_EQ(empty.Match("y"), 0);
+
+  Machine mixed{"A <- ('do' / 'double' / 'for' / 'if' / [a-z]+ / 'else' / "
+                "'enum' / 'extern' / 'export') ' '"};
+  EXPECT_EQ(mixed.Match("do "), 3);
+  EXPECT_EQ(mixed.Match("double "), -1);
+  EXPECT_EQ(mixed.Match("else "), 5);
+  EXPECT_EQ(mixed.Match("x "), 2);
+}
+
+TEST(BytecodeVmTest, TrieSkipsAlternatives) {
+  constexpr std::string_view kGrammar =
+      "A <- ('define' / 'defer' / 'delete' / 'double' / 'do' / 'drop' / "
+      "'dump' / ' ')*";
+  constexpr std::string_view kInput = "dump drop double do delete define";
+  Machine trie{kGrammar, {.dispatch_choices = false}};
+  Machine choice{kGrammar, {.dispatch_choices = false, .literal_tries = false}};
+  EXPECT_EQ(trie.Match(kInput), static_cast<int64_t>(kInput.size()));
+  EXPECT_EQ(choice.Match(kInput), static_cast<int64_t>(kInput.size()));
+  EXPECT_LT(trie.Backtracks(kInput) * 5, choice.Backtracks(kInput));
+}
+
+TEST(BytecodeVmTest, ScanUntil) {
+  constexpr std::string_view kGrammar =
+      "File <- (Comment / String / [a-z ;])* !.\n"
+      "Comment <- '/*' (!'*/' .)* '*/' / '#' (!EndOfLine .)* EndOfLine\n"
+      "EndOfLine <- NewLine / !.\n"
+      "NewLine <- '\r\n' / [\n\r]\n"
+      "String <- '\"' (!['\"] .)* '\"'\n";
+  Machine scan{kGrammar};
+  Machine loop{kGrammar, {.scan_until = false}};
+  for (const auto input : {
+           "a /* x * / y */ b",
+           "# to the end",
+           "# line\r\nab # next\n",
+           "\"a string with ' quote\"",
+           "a /* open",
+           "\"open",
+           "#",
+           "/**/\"\"",
+       }) {
+    EXPECT_EQ(scan.Match(input), loop.Match(input)) << input;
+    if (scan.Match(input) < 0) {
+      EXPECT_EQ(scan.Error(input).position, loop.Error(input).position)
+          << input;
+    }
+  }
+}
+
+TEST(BytecodeVmTest, Repetition) {
+  Machine star{"A <- ('a' 'b')* [0-9]* 'x'+ ('y' / 'z')+"};
+  EXPECT_EQ(star.Match("abab12xxyz"), 10);
+  EXPECT_EQ(star.Match("xy"), 2);
+  EXPECT_EQ(star.Match("abab"), -1);
+
+  Machine empty{"A <- ('a'?)* ('b'?)+ 'c'"};
+  EXPECT_EQ(empty.Match("aabc"), 4);
+  EXPECT_EQ(empty.Match("c"), 1);
+}
+
+TEST(BytecodeVmTest, Predicates) {
+  Machine machine{"A <- &'a' [a-z] !'c' ."};
+  EXPECT_EQ(machine.Match("ab"), 2);
+  EXPECT_EQ(machine.Match("ac"), -1);
+  EXPECT_EQ(machine.Match("bb"), -1);
+}
+
+TEST(BytecodeVmTest, Arithmetic) {
+  Machine machine{"Expr <- Sum !.\n"
+                  "Sum <- Product (('+' / '-') Product)*\n"
+                  "Product <- Value (('*' / '/') Value)*\n"
+                  "Value <- [0-9]+ / '(' Sum ')'\n"};
+  EXPECT_EQ(machine.Match("1+2*3"), 5);
+  EXPECT_EQ(machine.Match("(1+2)*(3-4)/56"), 14);
+  EXPECT_EQ(machine.Match("1+"), -1);
+  EXPECT_EQ(machine.Match("(1+2"), -1);
+}
+
+TEST(BytecodeVmTest, Cut) {
+  Machine choice{"A <- 'a' ^ 'b' / 'a' 'c'"};
+  EXPECT_EQ(choice.Match("ab"), 2);
+  EXPECT_EQ(choice.Match("ac"), -1);
+
+  Machine repetition{"A <- ('a' ^ 'b')* 'a'? 'c'"};
+  EXPECT_EQ(repetition.Match("ababc"), 5);
+  EXPECT_EQ(repetition.Match("abac"), -1);
+
+  Machine plus{"A <- ('a' ^ 'b')+ 'a'? 'c'"};
+  EXPECT_EQ(plus.Match("abc"), 3);
+  EXPECT_EQ(plus.Match("ac"), -1);
+
+  Machine optional{"A <- ('a' ^ 'b')? 'a' 'c'"};
+  EXPECT_EQ(optional.Match("ac"), -1);
+
+  Machine rule{"A <- B / 'ac'\nB <- 'a' ^ 'b'\n"};
+  EXPECT_EQ(rule.Match("ac"), 2);
+}
+
+TEST(BytecodeVmTest, StartRule) {
+  kero::peg::Arena arena;
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{"A <- 'a' B\nB <- 'b'"}}};
+  auto tree = parser.ParseRuleSet();
+  ASSERT_TRUE(tree.IsOk());
+  const auto program = kero::peg::CompileBytecode(
+      *static_cast<const kero::peg::ast::RuleSet*>(tree.Ok()->ToNode(arena)));
+  auto vm = kero::peg::BytecodeVm{program};
+  auto res = vm.Run("b", 1);
+  ASSERT_TRUE(res.IsOk());
+  EXPECT_EQ(*res.Ok(), 1);
+}
+
+TEST(BytecodeVmTest, Error) {
+  Machine machine{"A <- 'ab' 'cd' / 'a' 'x'"};
+  const auto error = machine.Error("abce");
+  EXPECT_EQ(error.code, kero::peg::BytecodeVmErrorCode::kNoMatch);
+  EXPECT_EQ(error.position, 2);
+
+  Machine end{"A <- 'a' !."};
+  EXPECT_EQ(end.Error("ab").position, 1);
+}
+
+TEST(BytecodeVmTest, StackOverflow) {
+  Machine left_recursion{"A <- A 'a' / 'a'"};
+  EXPECT_EQ(left_recursion.Error("aa").code,
+            kero::peg::BytecodeVmErrorCode::kStackOverflow);
+
+  Machine nesting{"A <- '(' A ')' / 'x'"};
+  EXPECT_EQ(nesting.Error("((((x))))", 4).code,
+            kero::peg::BytecodeVmErrorCode::kStackOverflow);
+  EXPECT_EQ(nesting.Match("((((x))))"), 9);
+}
@@ -0,0 +1,156 @@
+#include "./char_class.h"
+
+#include <cassert>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERO_PEG_CHAR_CLASS_X86_64
+#include <immintrin.h>
+#endif
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+// The scans stop at the first byte whose membership is `kStopAtMember`: Span
+// at the first non-member, Find at the first member.
+template <bool kStopAtMember>
+auto ScanScalar(const CharClass& char_class,
+                const std::string_view input) noexcept -> size_t {
+  size_t i{};
+  while (i < input.size() && char_class.Contains(input[i]) != kStopAtMember) {
+    ++i;
+  }
+
+  return i;
+}
+
+#ifdef KERO_PEG_CHAR_CLASS_X86_64
+
+// Bit h of the high nibble table is 1 << h for h < 8 and 0 otherwise, so bytes
+// of 0x80 and above never match. A byte is a member if the low nibble entry
+// and the high nibble entry share a bit.
+
+template <bool kStopAtMember>
+__attribute__((target("ssse3"))) auto
+ScanSsse3(const CharClass& char_class, const std::string_view input) noexcept
+    -> size_t {
+  const auto low_table = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(char_class.GetLowNibbles().data()));
+  const auto high_table = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0,
+                                        0, 0, 0, 0, 0);
+  const auto nibble_mask = _mm_set1_epi8(0x0f);
+  const auto zero = _mm_setzero_si128();
+  size_t i{};
+  for (; i + 16 <= input.size(); i += 16) {
+    const auto chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input.data() + i));
+    const auto low = _mm_and_si128(chunk, nibble_mask);
+    const auto high = _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble_mask);
+    const auto members =
+        _mm_and_si128(_mm_shuffle_epi8(low_table, low),
+                      _mm_shuffle_epi8(high_table, high));
+    auto stops = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(members, zero)));
+    if constexpr (kStopAtMember) {
+      stops ^= 0xffff;
+    }
+    if (stops != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(stops));
+    }
+  }
+
+  return i + ScanScalar<kStopAtMember>(char_class, input.substr(i));
+}
+
+template <bool kStopAtMember>
+__attribute__((target("avx2"))) auto
+ScanAvx2(const CharClass& char_class, const std::string_view input) noexcept
+    -> size_t {
+  const auto low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(char_class.GetLowNibbles().data())));
+  const auto high_table = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32,
+      64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const auto nibble_mask = _mm256_set1_epi8(0x0f);
+  const auto zero = _mm256_setzero_si256();
+  size_t i{};
+  for (; i + 32 <= input.size(); i += 32) {
+    const auto chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input.data() + i));
+    const auto low = _mm256_and_si256(chunk, nibble_mask);
+    const auto high =
+        _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble_mask);
+    const auto members =
+        _mm256_and_si256(_mm256_shuffle_epi8(low_table, low),
+                         _mm256_shuffle_epi8(high_table, high));
+    auto stops = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(members, zero)));
+    if constexpr (kStopAtMember) {
+      stops = ~stops;
+    }
+    if (stops != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(stops));
+    }
+  }
+
+  return i + ScanScalar<kStopAtMember>(char_class, input.substr(i));
+}
+
+auto HasSsse3() noexcept -> bool {
+  static const auto has_ssse3 = __builtin_cpu_supports("ssse3") != 0;
+  return has_ssse3;
+}
+
+#endif // KERO_PEG_CHAR_CLASS_X86_64
+
+template <bool kStopAtMember>
+auto Scan(const CharClass& char_class, const std::string_view input,
+          const ScanMode mode) noexcept -> size_t {
+  assert(IsScanModeSupported(mode));
+  if (!char_class.IsAscii()) {
+    return ScanScalar<kStopAtMember>(char_class, input);
+  }
+
+#ifdef KERO_PEG_CHAR_CLASS_X86_64
+  switch (mode) {
+  case ScanMode::kScalar:
+  case ScanMode::kMemchr:
+    break;
+  case ScanMode::kSse2:
+    // The nibble lookup needs pshufb, which is SSSE3.
+    if (HasSsse3()) {
+      return ScanSsse3<kStopAtMember>(char_class, input);
+    }
+    break;
+  case ScanMode::kAvx2:
+    return ScanAvx2<kStopAtMember>(char_class, input);
+  }
+#endif
+
+  return ScanScalar<kStopAtMember>(char_class, input);
+}
+
+} // namespace
+
+auto CharClass::Span(const std::string_view input) const noexcept -> size_t {
+  return Span(input, GetScanMode());
+}
+
+auto CharClass::Span(const std::string_view input,
+                     const ScanMode mode) const noexcept -> size_t {
+  return Scan<false>(*this, input, mode);
+}
+
+auto CharClass::Find(const std::string_view input) const noexcept -> size_t {
+  return Find(input, GetScanMode());
+}
+
+auto CharClass::Find(const std::string_view input,
+                     const ScanMode mode) const noexcept -> size_t {
+  const auto index = Scan<true>(*this, input, mode);
+  return index == input.size() ? std::string_view::npos : index;
+}
+
+} // namespace peg
+} // namespace kero
@@ -0,0 +1,91 @@
+#ifndef KERO_PEG_INTERNAL_CHAR_CLASS_H
+#define KERO_PEG_INTERNAL_CHAR_CLASS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "./scan.h"
+
+namespace kero {
+namespace peg {
+
+// A bracketed terminal such as `[a-zA-Z0-9_]` compiled once into a 256-bit
+// bitmap, so testing a byte is a single bit probe. Classes of ASCII bytes also
+// keep a nibble lookup table used to scan runs of members 16 or 32 bytes at a
+// time.
+class CharClass {
+public:
+  constexpr CharClass() noexcept = default;
+
+  // `value` is the text between the brackets, already validated by the lexer.
+  // `x-y` is the inclusive range from x to y, every other byte is a member
+  // itself.
+  static constexpr auto Compile(const std::string_view value) noexcept
+      -> CharClass {
+    CharClass char_class;
+    for (size_t i{}; i < value.size(); ++i) {
+      const auto first = static_cast<unsigned char>(value[i]);
+      if (i + 2 < value.size() && value[i + 1] == '-') {
+        const auto last = static_cast<unsigned char>(value[i + 2]);
+        for (auto byte = static_cast<size_t>(first); byte <= last; ++byte) {
+          char_class.Add(static_cast<unsigned char>(byte));
+        }
+        i += 2;
+      } else {
+        char_class.Add(first);
+      }
+    }
+
+    return char_class;
+  }
+
+  // Makes `byte` a member, for classes built from other expressions.
+  constexpr auto Add(const unsigned char byte) noexcept -> void {
+    bits_[byte >> 6] |= uint64_t{1} << (byte & 63);
+    if (byte < 0x80) {
+      low_nibbles_[byte & 0x0f] |= static_cast<uint8_t>(1 << (byte >> 4));
+    } else {
+      ascii_ = false;
+    }
+  }
+
+  constexpr auto Contains(const char ch) const noexcept -> bool {
+    const auto byte = static_cast<unsigned char>(ch);
+    return (bits_[byte >> 6] >> (byte & 63)) & 1;
+  }
+
+  constexpr auto IsAscii() const noexcept -> bool { return ascii_; }
+
+  constexpr auto GetLowNibbles() const noexcept
+      -> const std::array<uint8_t, 16>& {
+    return low_nibbles_;
+  }
+
+  // Length of the longest prefix of `input` whose bytes are all members, i.e.
+  // what `[...]*` consumes. Dispatches to `GetScanMode()`.
+  auto Span(const std::string_view input) const noexcept -> size_t;
+  auto Span(const std::string_view input, const ScanMode mode) const noexcept
+      -> size_t;
+
+  // Index of the first member in `input`, or std::string_view::npos, i.e.
+  // where `(![...] .)*` stops.
+  auto Find(const std::string_view input) const noexcept -> size_t;
+  auto Find(const std::string_view input, const ScanMode mode) const noexcept
+      -> size_t;
+
+  friend constexpr auto operator==(const CharClass&,
+                                   const CharClass&) noexcept -> bool = default;
+
+private:
+  std::array<uint64_t, 4> bits_{};
+  // Bit h of entry l is set if byte `h << 4 | l` is a member, for h < 8.
+  std::array<uint8_t, 16> low_nibbles_{};
+  bool ascii_{true};
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_CHAR_CLASS_H
@@ -0,0 +1,56 @@
+#include "./char_class.h"
+
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+// Interprets the bracketed text on every byte, as a matcher without a
+// compiled class would have to.
+auto ContainsUncompiled(const std::string_view value, const char ch) noexcept
+    -> bool {
+  for (size_t i{}; i < value.size(); ++i) {
+    if (i + 2 < value.size() && value[i + 1] == '-') {
+      if (ch >= value[i] && ch <= value[i + 2]) {
+        return true;
+      }
+      i += 2;
+    } else if (ch == value[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static auto BM_CharClassUncompiled(benchmark::State& state) -> void {
+  const auto input =
+      std::string(static_cast<size_t>(state.range(0)), '_') + "!";
+  for (auto _ : state) {
+    size_t i{};
+    while (ContainsUncompiled("a-zA-Z0-9_", input[i])) {
+      ++i;
+    }
+    benchmark::DoNotOptimize(i);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_CharClassUncompiled)->Arg(4096);
+
+static auto BM_CharClassSpan(benchmark::State& state) -> void {
+  const auto char_class = kero::peg::CharClass::Compile("a-zA-Z0-9_");
+  const auto input = std::string(4096, '_') + "!";
+  const auto mode = static_cast<kero::peg::ScanMode>(state.range(0));
+  if (!kero::peg::IsScanModeSupported(mode)) {
+    state.SkipWithError("scan mode not supported");
+    return;
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(char_class.Span(input, mode));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_CharClassSpan)
+    ->Arg(static_cast<int64_t>(kero::peg::ScanMode::kScalar))
+    ->Arg(static_cast<int64_t>(kero::peg::ScanMode::kSse2))
+    ->Arg(static_cast<int64_t>(kero::peg::ScanMode::kAvx2));
@@ -0,0 +1,106 @@
+#include "./char_class.h"
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+constexpr kero::peg::ScanMode kScanModes[] = {
+    kero::peg::ScanMode::kScalar,
+    kero::peg::ScanMode::kSse2,
+    kero::peg::ScanMode::kAvx2,
+};
+
+static_assert(kero::peg::CharClass::Compile("a-c").Contains('b'));
+static_assert(!kero::peg::CharClass::Compile("a-c").Contains('d'));
+
+TEST(CharClassTest, Compile) {
+  const auto char_class = kero::peg::CharClass::Compile("a-zA-Z0-9_");
+  for (int ch{}; ch < 256; ++ch) {
+    const auto byte = static_cast<char>(ch);
+    const auto expected = (ch >= 'a' && ch <= 'z') ||
+                          (ch >= 'A' && ch <= 'Z') ||
+                          (ch >= '0' && ch <= '9') || ch == '_';
+    EXPECT_EQ(char_class.Contains(byte), expected) << ch;
+  }
+  EXPECT_TRUE(char_class.IsAscii());
+}
+
+TEST(CharClassTest, CompileSingleBytes) {
+  const auto char_class = kero::peg::CharClass::Compile("'\"-");
+  EXPECT_TRUE(char_class.Contains('\''));
+  EXPECT_TRUE(char_class.Contains('"'));
+  EXPECT_TRUE(char_class.Contains('-'));
+  EXPECT_FALSE(char_class.Contains('a'));
+}
+
+TEST(CharClassTest, CompileNonAscii) {
+  const auto char_class = kero::peg::CharClass::Compile("a\xff");
+  EXPECT_TRUE(char_class.Contains('a'));
+  EXPECT_TRUE(char_class.Contains('\xff'));
+  EXPECT_FALSE(char_class.IsAscii());
+  EXPECT_EQ(char_class.Span("a\xff\xff" "ab"), 4);
+}
+
+TEST(CharClassTest, SpanDifferential) {
+  const auto char_class = kero::peg::CharClass::Compile("a-z0-9_");
+  auto rng{std::mt19937{3}};
+  auto byte{std::uniform_int_distribution<int>{0, 255}};
+  auto member{std::uniform_int_distribution<int>{0, 63}};
+  const std::string_view members{"abcdefghijklmnopqrstuvwxyz0123456789_"};
+  for (size_t round{}; round < 2000; ++round) {
+    // Long runs of members with a random byte at a random place.
+    auto input = std::string(round % 100, 'a');
+    for (auto& ch : input) {
+      ch = members[static_cast<size_t>(member(rng)) % members.size()];
+    }
+    if (!input.empty()) {
+      input[static_cast<size_t>(byte(rng)) % input.size()] =
+          static_cast<char>(byte(rng));
+    }
+    const auto expected =
+        char_class.Span(input, kero::peg::ScanMode::kScalar);
+    for (const auto mode : kScanModes) {
+      if (!kero::peg::IsScanModeSupported(mode)) {
+        continue;
+      }
+      EXPECT_EQ(char_class.Span(input, mode), expected) << input;
+    }
+  }
+}
+
+TEST(CharClassTest, Find) {
+  const auto char_class = kero::peg::CharClass::Compile("*\n");
+  EXPECT_EQ(char_class.Find("abc*/"), 3);
+  EXPECT_EQ(char_class.Find("abc"), std::string_view::npos);
+  EXPECT_EQ(char_class.Find(""), std::string_view::npos);
+  EXPECT_EQ(char_class.Find(std::string(40, 'x') + "\n"), 40);
+  EXPECT_EQ(char_class.Find(std::string(40, '\xff') + "*"), 40);
+}
+
+TEST(CharClassTest, FindDifferential) {
+  const auto char_class = kero::peg::CharClass::Compile("\"'\\");
+  auto rng{std::mt19937{5}};
+  auto byte{std::uniform_int_distribution<int>{0, 255}};
+  for (size_t round{}; round < 2000; ++round) {
+    // Long runs of other bytes with a random byte at a random place.
+    auto input = std::string(round % 100, 'a');
+    for (auto& ch : input) {
+      do {
+        ch = static_cast<char>(byte(rng));
+      } while (char_class.Contains(ch));
+    }
+    if (!input.empty()) {
+      input[static_cast<size_t>(byte(rng)) % input.size()] =
+          static_cast<char>(byte(rng));
+    }
+    const auto expected =
+        char_class.Find(input, kero::peg::ScanMode::kScalar);
+    for (const auto mode : kScanModes) {
+      if (!kero::peg::IsScanModeSupported(mode)) {
+        continue;
+      }
+      EXPECT_EQ(char_class.Find(input, mode), expected) << input;
+    }
+  }
+}
@@ -0,0 +1,527 @@
+#include "./codegen.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "./analysis.h"
+#include "./char_class.h"
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+constexpr uint32_t kNoLabel = UINT32_MAX;
+
+// More byte ranges than this test a bitmap instead.
+constexpr size_t kMaxInlineRanges = 4;
+
+auto IsPrintable(const unsigned char byte) noexcept -> bool {
+  return byte >= 0x20 && byte < 0x7f && byte != '\'' && byte != '"' &&
+         byte != '\\';
+}
+
+// Octal escapes take at most three digits, so unlike hex they never swallow
+// the next character.
+auto WriteEscaped(std::ostream& os, const unsigned char byte) noexcept
+    -> void {
+  if (IsPrintable(byte)) {
+    os << static_cast<char>(byte);
+  } else {
+    os << '\\' << static_cast<char>('0' + (byte >> 6))
+       << static_cast<char>('0' + ((byte >> 3) & 7))
+       << static_cast<char>('0' + (byte & 7));
+  }
+}
+
+auto WriteCharLiteral(std::ostream& os, const char ch) noexcept -> void {
+  os << "'";
+  WriteEscaped(os, static_cast<unsigned char>(ch));
+  os << "'";
+}
+
+auto WriteStringLiteral(std::ostream& os,
+                        const std::string_view value) noexcept -> void {
+  os << "\"";
+  for (const auto ch : value) {
+    WriteEscaped(os, static_cast<unsigned char>(ch));
+  }
+  os << "\"";
+}
+
+// `my/grammar.h` -> `MY_GRAMMAR_H`.
+auto MakeIncludeGuard(const std::string_view header_path) noexcept
+    -> std::string {
+  std::string guard;
+  for (const auto ch : header_path) {
+    const auto byte = static_cast<unsigned char>(ch);
+    guard += std::isalnum(byte) ? static_cast<char>(std::toupper(byte)) : '_';
+  }
+  return guard;
+}
+
+auto GetRuleName(const ast::RuleSet& rule_set, const size_t index) noexcept
+    -> std::string_view {
+  const auto& rule = static_cast<const ast::Rule&>(*rule_set.GetRules()[index]);
+  return static_cast<const ast::NonTerminal&>(*rule.GetNonTerminal())
+      .GetName();
+}
+
+// Writes the body of one rule function. Every expression either falls
+// through having advanced `p`, or jumps to the current failure label, whose
+// code restores `p` from a saved position.
+class RuleGenerator {
+public:
+  RuleGenerator(const ast::RuleSet& rule_set,
+                std::vector<CharClass>& char_classes) noexcept
+      : rule_set_{rule_set}, char_classes_{char_classes} {}
+
+  // Every call counts towards the nesting limit of the parse until it
+  // returns.
+  auto Generate(std::ostream& os, const ast::Rule& rule) noexcept -> void {
+    const auto fail = NewLabel();
+    fail_ = fail;
+    Generate(*rule.GetExpression());
+    os_ << "  --state.depth;\n";
+    os_ << "  return p;\n";
+    PlaceLabel(fail);
+    if (used_labels_[fail]) {
+      os_ << "  --state.depth;\n";
+      os_ << "  return kNoMatch;\n";
+    }
+
+    os << "  if (state.depth >= state.max_depth) {\n";
+    os << "    state.max_depth = 0;\n";
+    os << "    return kNoMatch;\n";
+    os << "  }\n";
+    os << "  ++state.depth;\n";
+    for (uint32_t i{}; i < variable_count_; ++i) {
+      os << "  [[maybe_unused]] size_t s" << i << "{};\n";
+    }
+    os << os_.str();
+  }
+
+private:
+  auto Generate(const ast::Node& node) noexcept -> void {
+    ast::Visit(node, [this](const auto& concrete) noexcept {
+      Generate(concrete);
+    });
+  }
+
+  // Generates `node` with failures going to `fail`, and a Cut in it going to
+  // `cut` from then on.
+  auto GenerateScope(const ast::Node& node, const uint32_t fail,
+                     const uint32_t cut) noexcept -> void {
+    const auto outer_fail = std::exchange(fail_, fail);
+    const auto outer_cut = std::exchange(cut_, cut);
+    Generate(node);
+    fail_ = outer_fail;
+    cut_ = outer_cut;
+  }
+
+  auto Generate(const ast::RuleSet&) noexcept -> void { assert(false); }
+
+  auto Generate(const ast::Rule&) noexcept -> void { assert(false); }
+
+  auto Generate(const ast::NonTerminal& node) noexcept -> void {
+    os_ << "  p = Match"
+        << GetRuleName(rule_set_, rule_set_.GetRuleIndex(node.GetSymbol()))
+        << "(state, p);\n";
+    os_ << "  if (p == kNoMatch) " << Goto(fail_) << "\n";
+  }
+
+  auto Generate(const ast::Sequence& node) noexcept -> void {
+    for (const auto expression : node.GetExpressions()) {
+      Generate(*expression);
+    }
+  }
+
+  auto Generate(const ast::OrderedChoice& node) noexcept -> void {
+    const auto alternatives = node.GetAlternatives();
+    const auto saved = SavePosition();
+    const auto done = NewLabel();
+    for (size_t i{}; i + 1 < alternatives.size(); ++i) {
+      const auto next = NewLabel();
+      GenerateScope(*alternatives[i], next, fail_);
+      os_ << "  " << Goto(done) << "\n";
+      PlaceLabel(next);
+      os_ << "  p = s" << saved << ";\n";
+    }
+    GenerateScope(*alternatives.back(), fail_, fail_);
+    PlaceLabel(done);
+  }
+
+  auto Generate(const ast::ZeroOrMore& node) noexcept -> void {
+    if (const auto set =
+            ast::As<ast::BracketedTerminal>(*node.GetExpression())) {
+      GenerateSpan(*set);
+      return;
+    }
+
+    GenerateLoop(*node.GetExpression(), kNoVariable);
+  }
+
+  auto Generate(const ast::OneOrMore& node) noexcept -> void {
+    if (const auto set =
+            ast::As<ast::BracketedTerminal>(*node.GetExpression())) {
+      Generate(*set);
+      GenerateSpan(*set);
+      return;
+    }
+
+    // s<first> stays 1 until an iteration succeeds.
+    const auto first = NewVariable();
+    os_ << "  s" << first << " = 1;\n";
+    GenerateLoop(*node.GetExpression(), first);
+  }
+
+  auto GenerateLoop(const ast::Node& expression,
+                    const uint32_t first) noexcept -> void {
+    const auto loop = NewLabel();
+    const auto done = NewLabel();
+    used_labels_[loop] = true;
+    PlaceLabel(loop);
+    const auto saved = SavePosition();
+    GenerateScope(expression, done, fail_);
+    if (first != kNoVariable) {
+      os_ << "  s" << first << " = 0;\n";
+    }
+    os_ << "  if (p != s" << saved << ") " << Goto(loop) << "\n";
+    PlaceLabel(done);
+    if (first != kNoVariable) {
+      os_ << "  if (s" << first << ") " << Goto(fail_) << "\n";
+    }
+    os_ << "  p = s" << saved << ";\n";
+  }
+
+  auto Generate(const ast::Optional& node) noexcept -> void {
+    const auto saved = SavePosition();
+    const auto no = NewLabel();
+    const auto done = NewLabel();
+    GenerateScope(*node.GetExpression(), no, fail_);
+    os_ << "  " << Goto(done) << "\n";
+    PlaceLabel(no);
+    os_ << "  p = s" << saved << ";\n";
+    PlaceLabel(done);
+  }
+
+  auto Generate(const ast::AndPredicate& node) noexcept -> void {
+    const auto saved = SavePosition();
+    GenerateScope(*node.GetExpression(), fail_, kNoLabel);
+    os_ << "  p = s" << saved << ";\n";
+  }
+
+  auto Generate(const ast::NotPredicate& node) noexcept -> void {
+    const auto saved = SavePosition();
+    const auto ok = NewLabel();
+    GenerateScope(*node.GetExpression(), ok, kNoLabel);
+    os_ << "  Reach(state, s" << saved << ");\n";
+    os_ << "  " << Goto(fail_) << "\n";
+    PlaceLabel(ok);
+    os_ << "  p = s" << saved << ";\n";
+  }
+
+  auto Generate(const ast::Group& node) noexcept -> void {
+    Generate(*node.GetExpression());
+  }
+
+  auto Generate(const ast::AnyCharacter&) noexcept -> void {
+    GenerateTest("p >= input.size()");
+    os_ << "  ++p;\n";
+  }
+
+  auto Generate(const ast::QuotedTerminal& node) noexcept -> void {
+    const auto value = node.GetValue();
+    if (value.empty()) {
+      return;
+    }
+
+    std::ostringstream test;
+    if (value.size() == 1) {
+      test << "p >= input.size() || input[p] != ";
+      WriteCharLiteral(test, value[0]);
+    } else {
+      test << "!input.substr(p).starts_with(";
+      WriteStringLiteral(test, value);
+      test << ")";
+    }
+    GenerateTest(test.str());
+    os_ << "  p += " << value.size() << ";\n";
+  }
+
+  auto Generate(const ast::BracketedTerminal& node) noexcept -> void {
+    GenerateTest("p >= input.size() || !InSet" +
+                 std::to_string(AddCharClass(node)) + "(input[p])");
+    os_ << "  ++p;\n";
+  }
+
+  auto Generate(const ast::Cut&) noexcept -> void {
+    if (cut_ != kNoLabel) {
+      fail_ = cut_;
+    }
+  }
+
+  auto GenerateSpan(const ast::BracketedTerminal& node) noexcept -> void {
+    os_ << "  while (p < input.size() && InSet" << AddCharClass(node)
+        << "(input[p])) {\n";
+    os_ << "    ++p;\n";
+    os_ << "  }\n";
+  }
+
+  // Fails if `condition` holds.
+  auto GenerateTest(const std::string_view condition) noexcept -> void {
+    os_ << "  if (" << condition << ") {\n";
+    os_ << "    Reach(state, p);\n";
+    os_ << "    " << Goto(fail_) << "\n";
+    os_ << "  }\n";
+  }
+
+  auto AddCharClass(const ast::BracketedTerminal& node) noexcept -> size_t {
+    const auto& char_class = node.GetCharClass();
+    const auto it =
+        std::find(char_classes_.begin(), char_classes_.end(), char_class);
+    if (it != char_classes_.end()) {
+      return static_cast<size_t>(it - char_classes_.begin());
+    }
+    char_classes_.push_back(char_class);
+    return char_classes_.size() - 1;
+  }
+
+  auto NewLabel() noexcept -> uint32_t {
+    used_labels_.push_back(false);
+    return static_cast<uint32_t>(used_labels_.size() - 1);
+  }
+
+  auto Goto(const uint32_t label) noexcept -> std::string {
+    used_labels_[label] = true;
+    return "goto L" + std::to_string(label) + ";";
+  }
+
+  // Labels nothing jumps to are left out, to keep -Wunused-label quiet.
+  auto PlaceLabel(const uint32_t label) noexcept -> void {
+    if (used_labels_[label]) {
+      os_ << "L" << label << ":;\n";
+    }
+  }
+
+  auto NewVariable() noexcept -> uint32_t { return variable_count_++; }
+
+  auto SavePosition() noexcept -> uint32_t {
+    const auto variable = NewVariable();
+    os_ << "  s" << variable << " = p;\n";
+    return variable;
+  }
+
+  static constexpr uint32_t kNoVariable = UINT32_MAX;
+
+  const ast::RuleSet& rule_set_;
+  std::vector<CharClass>& char_classes_;
+  std::ostringstream os_;
+  std::vector<bool> used_labels_;
+  uint32_t variable_count_{};
+  uint32_t fail_{kNoLabel};
+  uint32_t cut_{kNoLabel};
+};
+
+// Writes `InSet<index>`, testing a byte with comparisons when the class is a
+// few ranges and with a bitmap otherwise.
+auto WriteCharClass(std::ostream& os, const size_t index,
+                    const CharClass& char_class) noexcept -> void {
+  std::vector<std::pair<unsigned, unsigned>> ranges;
+  for (unsigned byte{}; byte < 256; ++byte) {
+    if (!char_class.Contains(static_cast<char>(byte))) {
+      continue;
+    }
+    if (!ranges.empty() && ranges.back().second + 1 == byte) {
+      ranges.back().second = byte;
+    } else {
+      ranges.emplace_back(byte, byte);
+    }
+  }
+
+  os << "constexpr auto InSet" << index
+     << "(const char ch) noexcept -> bool {\n";
+  os << "  const auto b = static_cast<unsigned char>(ch);\n";
+  if (ranges.size() > kMaxInlineRanges) {
+    std::array<uint64_t, 4> words{};
+    for (const auto& [first, last] : ranges) {
+      for (auto byte = first; byte <= last; ++byte) {
+        words[byte >> 6] |= uint64_t{1} << (byte & 63);
+      }
+    }
+    os << "  constexpr uint64_t kBits[4] = {";
+    for (size_t i{}; i < words.size(); ++i) {
+      os << (i == 0 ? "" : ", ") << "0x" << std::hex << words[i] << std::dec
+         << "u";
+    }
+    os << "};\n";
+    os << "  return (kBits[b >> 6] >> (b & 63)) & 1;\n";
+    os << "}\n\n";
+    return;
+  }
+
+  os << "  return ";
+  if (ranges.empty()) {
+    os << "false";
+  }
+  for (size_t i{}; i < ranges.size(); ++i) {
+    const auto [first, last] = ranges[i];
+    os << (i == 0 ? "" : " || ");
+    if (first == last) {
+      os << "b == " << first;
+    } else {
+      os << "(b >= " << first << " && b <= " << last << ")";
+    }
+  }
+  os << ";\n";
+  os << "}\n\n";
+}
+
+} // namespace
+
+auto operator<<(std::ostream& os, const CodegenErrorCode code) noexcept
+    -> std::ostream& {
+  switch (code) {
+  case CodegenErrorCode::kLeftRecursion:
+    os << "LeftRecursion";
+    break;
+  }
+  return os;
+}
+
+auto GenerateParser(const ast::RuleSet& rule_set,
+                    const CodegenOptions& options) noexcept
+    -> Result<GeneratedParser, CodegenError> {
+  using R = Result<GeneratedParser, CodegenError>;
+  if (const auto rule = GrammarAnalysis{rule_set}.FindLeftRecursion()) {
+    return R{CodegenError{CodegenErrorCode::kLeftRecursion, *rule}};
+  }
+
+  const auto rule_count = rule_set.GetRules().size();
+  std::ostringstream banner;
+  banner << "// Generated by kero_peg_codegen from " << options.grammar_path
+         << ". Do not edit.\n\n";
+
+  const auto guard = MakeIncludeGuard(options.header_path);
+  std::ostringstream header;
+  header << banner.str();
+  header << "#ifndef " << guard << "\n";
+  header << "#define " << guard << "\n\n";
+  header << "#include <cstddef>\n";
+  header << "#include <cstdint>\n";
+  header << "#include <ostream>\n";
+  header << "#include <string_view>\n\n";
+  header << "#include \"internal/core.h\"\n\n";
+  header << "namespace " << options.name_space << " {\n\n";
+  // Rule functions are all named Parse<Rule>, so these names are free.
+  header << "enum class ErrorCode : int32_t {\n";
+  header << "  kNoMatch = 0,\n";
+  header << "  // Rule calls nested deeper than the limit of the parse.\n";
+  header << "  kStackOverflow,\n";
+  header << "};\n\n";
+  header << "inline auto operator<<(std::ostream& os, "
+            "const ErrorCode code) noexcept\n";
+  header << "    -> std::ostream& {\n";
+  header << "  switch (code) {\n";
+  header << "  case ErrorCode::kNoMatch:\n";
+  header << "    return os << \"NoMatch\";\n";
+  header << "  case ErrorCode::kStackOverflow:\n";
+  header << "    return os << \"StackOverflow\";\n";
+  header << "  }\n";
+  header << "  return os;\n";
+  header << "}\n\n";
+  header << "struct Error {\n";
+  header << "  ErrorCode code;\n";
+  header << "  // The farthest position a match failed at.\n";
+  header << "  size_t position;\n";
+  header << "};\n\n";
+  header << "// Rule calls a parse may nest. Each is a native stack frame.\n";
+  header << "constexpr size_t kDefaultMaxDepth = " << kCodegenDefaultMaxDepth
+         << ";\n\n";
+  for (size_t i{}; i < rule_count; ++i) {
+    const auto name = GetRuleName(rule_set, i);
+    header << "auto Parse" << name << "(std::string_view input,\n"
+           << std::string(std::string_view{"auto Parse("}.size() + name.size(),
+                          ' ')
+           << "size_t max_depth = kDefaultMaxDepth) noexcept\n"
+           << "    -> kero::peg::Result<size_t, Error>;\n\n";
+  }
+  header << "} // namespace " << options.name_space << "\n\n";
+  header << "#endif // " << guard << "\n";
+
+  // Rule functions first, since they decide which char classes exist.
+  std::vector<CharClass> char_classes;
+  std::ostringstream functions;
+  for (size_t i{}; i < rule_count; ++i) {
+    const auto& rule =
+        static_cast<const ast::Rule&>(*rule_set.GetRules()[i]);
+    functions << "auto Match" << GetRuleName(rule_set, i)
+              << "(State& state, size_t p) noexcept -> size_t {\n";
+    functions << "  const auto input = state.input;\n";
+    RuleGenerator{rule_set, char_classes}.Generate(functions, rule);
+    functions << "}\n\n";
+  }
+
+  std::ostringstream source;
+  source << banner.str();
+  source << "#include \"" << options.header_path << "\"\n\n";
+  source << "#include <algorithm>\n";
+  source << "#include <cstdint>\n";
+  source << "#include <limits>\n\n";
+  source << "namespace " << options.name_space << " {\n\n";
+  source << "namespace {\n\n";
+  source << "constexpr size_t kNoMatch = std::numeric_limits<size_t>::max();"
+            "\n\n";
+  source << "struct State {\n";
+  source << "  std::string_view input;\n";
+  source << "  size_t farthest;\n";
+  source << "  // Running rule calls. Once a call would exceed max_depth, "
+            "max_depth\n";
+  source << "  // drops to 0 so every later call fails too and the parse "
+            "unwinds.\n";
+  source << "  size_t depth;\n";
+  source << "  size_t max_depth;\n";
+  source << "};\n\n";
+  source << "auto Reach(State& state, const size_t p) noexcept -> void {\n";
+  source << "  state.farthest = std::max(state.farthest, p);\n";
+  source << "}\n\n";
+  for (size_t i{}; i < char_classes.size(); ++i) {
+    WriteCharClass(source, i, char_classes[i]);
+  }
+  for (size_t i{}; i < rule_count; ++i) {
+    source << "auto Match" << GetRuleName(rule_set, i)
+           << "(State& state, size_t p) noexcept -> size_t;\n";
+  }
+  source << "\n" << functions.str();
+  source << "} // namespace\n\n";
+  for (size_t i{}; i < rule_count; ++i) {
+    const auto name = GetRuleName(rule_set, i);
+    source << "auto Parse" << name
+           << "(std::string_view input, size_t max_depth) noexcept\n";
+    source << "    -> kero::peg::Result<size_t, Error> {\n";
+    source << "  using R = kero::peg::Result<size_t, Error>;\n";
+    source << "  State state{input, 0, 0, max_depth};\n";
+    source << "  const auto end = Match" << name << "(state, 0);\n";
+    source << "  if (state.max_depth == 0) {\n";
+    source << "    return R{Error{ErrorCode::kStackOverflow, "
+              "state.farthest}};\n";
+    source << "  }\n";
+    source << "  if (end == kNoMatch) {\n";
+    source << "    return R{Error{ErrorCode::kNoMatch, "
+              "state.farthest}};\n";
+    source << "  }\n";
+    source << "  return R{size_t{end}};\n";
+    source << "}\n\n";
+  }
+  source << "} // namespace " << options.name_space << "\n";
+
+  return R{GeneratedParser{header.str(), source.str()}};
+}
+
+} // namespace peg
+} // namespace kero
@@ -0,0 +1,65 @@
+#ifndef KERO_PEG_INTERNAL_CODEGEN_H
+#define KERO_PEG_INTERNAL_CODEGEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "./ast.h"
+#include "./core.h"
+
+namespace kero {
+namespace peg {
+
+struct CodegenOptions {
+  // C++ namespace of the generated code, e.g. `my::grammar`.
+  std::string_view name_space;
+  // Path the generated source includes the generated header by.
+  std::string_view header_path;
+  // Shown in the generated banner.
+  std::string_view grammar_path;
+};
+
+struct GeneratedParser {
+  std::string header;
+  std::string source;
+};
+
+// Rule calls a generated parser nests by default before it fails with
+// kStackOverflow. Each is one native stack frame of a few locals.
+constexpr size_t kCodegenDefaultMaxDepth = size_t{1} << 13;
+
+enum class CodegenErrorCode : int32_t {
+  kLeftRecursion = 0,
+};
+
+auto operator<<(std::ostream& os, const CodegenErrorCode code) noexcept
+    -> std::ostream&;
+
+struct CodegenError {
+  CodegenErrorCode code;
+  uint32_t rule_index;
+};
+
+// Generates a recursive-descent parser with the semantics of BytecodeVm: one
+// C++ function per rule, with terminals and char classes inlined as byte
+// comparisons and backtracking as gotos. For each rule `Name` the header
+// declares `ParseName(std::string_view input, size_t max_depth)`, returning
+// the length matched at the start of the input or an `Error` holding an
+// `ErrorCode` and the farthest position a match failed at. No rule function
+// can be named like those types, since every one starts with `Parse`.
+//
+// Generated functions call each other directly, so left-recursive grammars
+// are rejected, and a parse whose rule calls nest deeper than `max_depth`
+// (kCodegenDefaultMaxDepth by default) fails with kStackOverflow instead of
+// overflowing the stack.
+auto GenerateParser(const ast::RuleSet& rule_set,
+                    const CodegenOptions& options) noexcept
+    -> Result<GeneratedParser, CodegenError>;
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_CODEGEN_H
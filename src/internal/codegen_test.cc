@@ -0,0 +1,95 @@
+#include "./codegen.h"
+
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Generates a parser for `source` into namespace `gen`.
+auto Generate(const std::string_view source) noexcept
+    -> kero::peg::Result<kero::peg::GeneratedParser, kero::peg::CodegenError> {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto res = parser.ParseRuleSet();
+  EXPECT_TRUE(res.IsOk());
+  kero::peg::Arena arena;
+  const auto& rule_set =
+      static_cast<const kero::peg::ast::RuleSet&>(*res.Ok()->ToNode(arena));
+  return kero::peg::GenerateParser(
+      rule_set, kero::peg::CodegenOptions{"gen", "out/gen.h", "gen.peg"});
+}
+
+auto Contains(const std::string& text, const std::string_view part) noexcept
+    -> bool {
+  return text.find(part) != std::string::npos;
+}
+
+} // namespace
+
+TEST(CodegenTest, Header) {
+  auto res = Generate("Sum <- Value ('+' Value)*\nValue <- [0-9]+\n");
+  ASSERT_TRUE(res.IsOk());
+  const auto header = res.Ok()->header;
+  EXPECT_TRUE(Contains(header, "from gen.peg"));
+  EXPECT_TRUE(Contains(header, "#ifndef OUT_GEN_H\n"));
+  EXPECT_TRUE(Contains(header, "namespace gen {"));
+  EXPECT_TRUE(Contains(header, "auto ParseSum(std::string_view input,\n"
+                               "              size_t max_depth"));
+  EXPECT_TRUE(Contains(header, "auto ParseValue(std::string_view input,\n"));
+  EXPECT_TRUE(Contains(header, "constexpr size_t kDefaultMaxDepth = 8192;"));
+}
+
+TEST(CodegenTest, RuleNamedLikeErrorType) {
+  // ParseError and ParseErrorCode are rule functions, not the error types.
+  auto res = Generate("Start <- Error / ErrorCode\nError <- 'e'\n"
+                      "ErrorCode <- 'c'\n");
+  ASSERT_TRUE(res.IsOk());
+  const auto header = res.Ok()->header;
+  EXPECT_TRUE(Contains(header, "enum class ErrorCode : int32_t {"));
+  EXPECT_TRUE(Contains(header, "struct Error {"));
+  EXPECT_TRUE(Contains(header, "auto ParseError(std::string_view input,\n"));
+  EXPECT_TRUE(
+      Contains(header, "auto ParseErrorCode(std::string_view input,\n"));
+  EXPECT_TRUE(Contains(header, "-> kero::peg::Result<size_t, Error>;"));
+}
+
+TEST(CodegenTest, Source) {
+  auto res = Generate("Sum <- Value ('+' Value)*\nValue <- [0-9]+\n");
+  ASSERT_TRUE(res.IsOk());
+  const auto source = res.Ok()->source;
+  EXPECT_TRUE(Contains(source, "#include \"out/gen.h\""));
+  EXPECT_TRUE(Contains(source, "p = MatchValue(state, p);"));
+  EXPECT_TRUE(Contains(source, "input[p] != '+'"));
+  // [0-9]+ is one test then a span over the same class.
+  EXPECT_TRUE(Contains(source, "return (b >= 48 && b <= 57);"));
+  EXPECT_TRUE(Contains(source, "while (p < input.size() && InSet0(input[p]))"));
+  EXPECT_FALSE(Contains(source, "InSet1"));
+}
+
+TEST(CodegenTest, Literals) {
+  // Quotes and other bytes unsafe in C++ literals are written as octal.
+  auto res = Generate("A <- '\"' 'say\"hi'");
+  ASSERT_TRUE(res.IsOk());
+  const auto source = res.Ok()->source;
+  EXPECT_TRUE(Contains(source, "input[p] != '\\042'"));
+  EXPECT_TRUE(Contains(source, "starts_with(\"say\\042hi\")"));
+  EXPECT_TRUE(Contains(source, "p += 6;"));
+}
+
+TEST(CodegenTest, SparseCharClass) {
+  // A few ranges are compared directly, more test a bitmap.
+  auto res = Generate("A <- [ace]\nB <- [acegikmoqsuwy]\n");
+  ASSERT_TRUE(res.IsOk());
+  const auto source = res.Ok()->source;
+  EXPECT_TRUE(Contains(source, "return b == 97 || b == 99 || b == 101;"));
+  EXPECT_TRUE(Contains(source, "constexpr uint64_t kBits[4] = {0x0u, 0x"));
+}
+
+TEST(CodegenTest, LeftRecursion) {
+  auto res = Generate("A <- 'a'\nB <- 'b'? C\nC <- B 'c'\n");
+  ASSERT_TRUE(res.IsErr());
+  const auto error = *res.Err();
+  EXPECT_EQ(error.code, kero::peg::CodegenErrorCode::kLeftRecursion);
+  EXPECT_EQ(error.rule_index, 1u);
+}
@@ -0,0 +1,340 @@
+#ifndef KERO_PEG_INTERNAL_COMBINATOR_H
+#define KERO_PEG_INTERNAL_COMBINATOR_H
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "./char_class.h"
+#include "./core.h"
+
+namespace kero {
+namespace peg {
+
+// Grammars written as C++ expressions, for small fixed grammars on hot paths.
+// Every expression is its own type, so the compiler sees the whole grammar
+// and inlines it into straight-line code. The operators of docs/grammar.py
+// map to:
+//
+//   e1 e2    e1 >> e2
+//   e1 / e2  e1 | e2   (`/` would bind tighter than `>>` in C++)
+//   e*       *e
+//   e+       +e
+//   e?       -e
+//   &e       &e
+//   !e       !e
+//   .        kAny
+//   'abc'    Lit("abc"), or "abc" next to another expression
+//   [a-z]    Set<"a-z">()
+//
+// e.g. `constexpr auto kNumber = -Lit('-') >> +Set<"0-9">();`. There are no
+// rules, so a grammar cannot refer to itself.
+namespace combinator {
+
+constexpr size_t kNoMatch = std::numeric_limits<size_t>::max();
+
+// An expression matches `input` at `position` and returns where the match
+// ends, or kNoMatch. Failing terminals raise `farthest` to their position.
+template <typename E>
+concept Expression = requires(const E& expression, std::string_view input,
+                              size_t& farthest) {
+  { expression.Match(input, size_t{}, farthest) } -> std::same_as<size_t>;
+};
+
+constexpr auto Fail(const size_t position, size_t& farthest) noexcept
+    -> size_t {
+  farthest = std::max(farthest, position);
+  return kNoMatch;
+}
+
+struct Any {
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    return position < input.size() ? position + 1 : Fail(position, farthest);
+  }
+};
+
+constexpr Any kAny{};
+
+struct Char {
+  char value;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    return position < input.size() && input[position] == value
+               ? position + 1
+               : Fail(position, farthest);
+  }
+};
+
+struct Literal {
+  std::string_view value;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    return value.size() <= input.size() - position &&
+                   std::char_traits<char>::compare(input.data() + position,
+                                                   value.data(),
+                                                   value.size()) == 0
+               ? position + value.size()
+               : Fail(position, farthest);
+  }
+};
+
+// Classes of up to this many byte ranges test each range, like hand-written
+// code would; larger ones index a byte table, one load per byte.
+constexpr size_t kMaxClassRanges = 4;
+
+struct ClassRanges {
+  std::array<unsigned char, kMaxClassRanges> first{};
+  std::array<unsigned char, kMaxClassRanges> last{};
+  size_t count{};
+};
+
+constexpr auto GetClassRanges(const CharClass& char_class) noexcept
+    -> ClassRanges {
+  ClassRanges ranges;
+  for (size_t byte{}; byte < 256; ++byte) {
+    if (!char_class.Contains(static_cast<char>(byte))) {
+      continue;
+    }
+    if (ranges.count != 0 && ranges.count <= kMaxClassRanges &&
+        ranges.last[ranges.count - 1] + size_t{1} == byte) {
+      ranges.last[ranges.count - 1] = static_cast<unsigned char>(byte);
+      continue;
+    }
+    if (ranges.count < kMaxClassRanges) {
+      ranges.first[ranges.count] = static_cast<unsigned char>(byte);
+      ranges.last[ranges.count] = static_cast<unsigned char>(byte);
+    }
+    ++ranges.count;
+  }
+  return ranges;
+}
+
+constexpr auto GetClassTable(const CharClass& char_class) noexcept
+    -> std::array<bool, 256> {
+  std::array<bool, 256> table{};
+  for (size_t byte{}; byte < table.size(); ++byte) {
+    table[byte] = char_class.Contains(static_cast<char>(byte));
+  }
+  return table;
+}
+
+template <FixedString Value> struct Class {
+  static constexpr auto kCharClass = CharClass::Compile(Value.View());
+  static constexpr auto kRanges = GetClassRanges(kCharClass);
+  static constexpr auto kTable = GetClassTable(kCharClass);
+
+  static constexpr auto Contains(const char ch) noexcept -> bool {
+    if constexpr (kRanges.count <= kMaxClassRanges) {
+      const auto byte = static_cast<unsigned char>(ch);
+      return [byte]<size_t... I>(std::index_sequence<I...>) noexcept {
+        return ((static_cast<unsigned char>(byte - kRanges.first[I]) <=
+                 kRanges.last[I] - kRanges.first[I]) ||
+                ...);
+      }(std::make_index_sequence<kRanges.count>{});
+    } else {
+      return kTable[static_cast<unsigned char>(ch)];
+    }
+  }
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    return position < input.size() && Contains(input[position])
+               ? position + 1
+               : Fail(position, farthest);
+  }
+};
+
+template <Expression A, Expression B> struct Sequence {
+  A first;
+  B second;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    const auto end = first.Match(input, position, farthest);
+    return end == kNoMatch ? kNoMatch : second.Match(input, end, farthest);
+  }
+};
+
+template <Expression A, Expression B> struct Choice {
+  A first;
+  B second;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    const auto end = first.Match(input, position, farthest);
+    return end != kNoMatch ? end : second.Match(input, position, farthest);
+  }
+};
+
+template <Expression E> struct ZeroOrMore {
+  E expression;
+
+  constexpr auto Match(const std::string_view input, size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    // Like kSpan, `[...]*` never fails, so its end is not a failure.
+    if constexpr (requires { E::Contains(char{}); }) {
+      while (position < input.size() && E::Contains(input[position])) {
+        ++position;
+      }
+      return position;
+    }
+
+    while (true) {
+      const auto end = expression.Match(input, position, farthest);
+      if (end == kNoMatch || end == position) {
+        return position;
+      }
+      position = end;
+    }
+  }
+};
+
+template <Expression E> struct OneOrMore {
+  E expression;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    // A class's first byte ends at position + 1, never at kNoMatch, so test
+    // the byte directly instead of comparing the end.
+    if constexpr (requires { E::Contains(char{}); }) {
+      return position < input.size() && E::Contains(input[position])
+                 ? ZeroOrMore<E>{expression}.Match(input, position + 1,
+                                                   farthest)
+                 : Fail(position, farthest);
+    }
+
+    const auto end = expression.Match(input, position, farthest);
+    return end == kNoMatch
+               ? kNoMatch
+               : ZeroOrMore<E>{expression}.Match(input, end, farthest);
+  }
+};
+
+template <Expression E> struct Optional {
+  E expression;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    const auto end = expression.Match(input, position, farthest);
+    return end == kNoMatch ? position : end;
+  }
+};
+
+template <Expression E> struct AndPredicate {
+  E expression;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    const auto end = expression.Match(input, position, farthest);
+    return end == kNoMatch ? kNoMatch : position;
+  }
+};
+
+template <Expression E> struct NotPredicate {
+  E expression;
+
+  constexpr auto Match(const std::string_view input, const size_t position,
+                       size_t& farthest) const noexcept -> size_t {
+    const auto end = expression.Match(input, position, farthest);
+    return end == kNoMatch ? position : Fail(position, farthest);
+  }
+};
+
+constexpr auto Lit(const char value) noexcept -> Char { return Char{value}; }
+
+constexpr auto Lit(const std::string_view value) noexcept -> Literal {
+  return Literal{value};
+}
+
+// `Value` is the text between the brackets, see CharClass::Compile.
+template <FixedString Value> constexpr auto Set() noexcept -> Class<Value> {
+  return {};
+}
+
+// What may stand next to an expression: another expression, a char or a
+// string literal. Owning strings are left out, as a Literal would dangle.
+template <typename T>
+concept Operand = Expression<T> || std::same_as<T, char> ||
+                  std::same_as<T, std::string_view> ||
+                  std::is_convertible_v<const T&, const char*>;
+
+template <Operand T>
+constexpr auto ToExpression(const T& operand) noexcept {
+  if constexpr (Expression<T>) {
+    return operand;
+  } else if constexpr (std::same_as<T, char>) {
+    return Char{operand};
+  } else {
+    return Literal{std::string_view{operand}};
+  }
+}
+
+template <Operand A, Operand B>
+  requires Expression<A> || Expression<B>
+constexpr auto operator>>(const A& first, const B& second) noexcept {
+  return Sequence<decltype(ToExpression(first)),
+                  decltype(ToExpression(second))>{ToExpression(first),
+                                                  ToExpression(second)};
+}
+
+template <Operand A, Operand B>
+  requires Expression<A> || Expression<B>
+constexpr auto operator|(const A& first, const B& second) noexcept {
+  return Choice<decltype(ToExpression(first)),
+                decltype(ToExpression(second))>{ToExpression(first),
+                                                ToExpression(second)};
+}
+
+template <Expression E> constexpr auto operator*(const E& expression) noexcept {
+  return ZeroOrMore<E>{expression};
+}
+
+template <Expression E> constexpr auto operator+(const E& expression) noexcept {
+  return OneOrMore<E>{expression};
+}
+
+template <Expression E> constexpr auto operator-(const E& expression) noexcept {
+  return Optional<E>{expression};
+}
+
+template <Expression E> constexpr auto operator&(const E& expression) noexcept {
+  return AndPredicate<E>{expression};
+}
+
+template <Expression E> constexpr auto operator!(const E& expression) noexcept {
+  return NotPredicate<E>{expression};
+}
+
+struct MatchError {
+  // The farthest position a terminal failed at.
+  size_t position;
+};
+
+// Matches `expression` at the start of `input`, returning the length matched.
+template <Expression E>
+constexpr auto Parse(const E& expression, const std::string_view input) noexcept
+    -> Result<size_t, MatchError> {
+  using R = Result<size_t, MatchError>;
+  size_t farthest{};
+  const auto end = expression.Match(input, 0, farthest);
+  if (end == kNoMatch) {
+    return R{MatchError{farthest}};
+  }
+  return R{size_t{end}};
+}
+
+} // namespace combinator
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_COMBINATOR_H
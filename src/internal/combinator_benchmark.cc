@@ -0,0 +1,145 @@
+#include "./combinator.h"
+
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+// Common Log Format, e.g.
+// `127.0.0.1 - frank [10/Oct/2000:13:55:36 -0700] "GET /a.gif HTTP/1.0" 200
+// 2326`, one line per request.
+namespace log_line {
+
+using namespace kero::peg::combinator;
+
+constexpr auto kNumber = +Set<"0-9">();
+constexpr auto kHost = kNumber >> '.' >> kNumber >> '.' >> kNumber >> '.' >>
+                       kNumber;
+constexpr auto kUser = +Set<"a-zA-Z0-9_-">();
+constexpr auto kTime = '[' >> *Set<"0-9a-zA-Z/: +-">() >> ']';
+constexpr auto kRequest = '"' >> +Set<"A-Z">() >> ' ' >> +Set<"!#-~">() >>
+                          " HTTP/" >> Set<"0-9">() >> '.' >> Set<"0-9">() >>
+                          '"';
+constexpr auto kLine = kHost >> ' ' >> kUser >> ' ' >> kUser >> ' ' >>
+                       kTime >> ' ' >> kRequest >> ' ' >> kNumber >> ' ' >>
+                       (kNumber | '-') >> '\n';
+constexpr auto kFile = *kLine >> !kAny;
+
+} // namespace log_line
+
+// The same grammar by hand, as a recursive-descent parser would be written
+// without a grammar.
+static auto ParseLogHandWritten(const std::string_view input) noexcept
+    -> size_t {
+  constexpr auto kFailed = std::string_view::npos;
+  const auto size = input.size();
+  size_t p{};
+  const auto is_digit = [](const char ch) noexcept {
+    return ch >= '0' && ch <= '9';
+  };
+  const auto skip = [&](auto&& predicate) noexcept {
+    while (p < size && predicate(input[p])) {
+      ++p;
+    }
+  };
+  const auto number = [&]() noexcept {
+    const auto start = p;
+    skip(is_digit);
+    return p > start;
+  };
+  const auto expect = [&](const char ch) noexcept {
+    if (p < size && input[p] == ch) {
+      ++p;
+      return true;
+    }
+    return false;
+  };
+  const auto user = [&]() noexcept {
+    const auto start = p;
+    skip([](const char ch) noexcept {
+      return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+             (ch >= '0' && ch <= '9') || ch == '_' || ch == '-';
+    });
+    return p > start;
+  };
+
+  while (p < size) {
+    if (!(number() && expect('.') && number() && expect('.') && number() &&
+          expect('.') && number() && expect(' ') && user() && expect(' ') &&
+          user() && expect(' ') && expect('['))) {
+      return kFailed;
+    }
+    skip([](const char ch) noexcept {
+      return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') ||
+             (ch >= 'A' && ch <= 'Z') || ch == '/' || ch == ':' ||
+             ch == ' ' || ch == '+' || ch == '-';
+    });
+    if (!(expect(']') && expect(' ') && expect('"'))) {
+      return kFailed;
+    }
+    const auto method = p;
+    skip([](const char ch) noexcept { return ch >= 'A' && ch <= 'Z'; });
+    if (p == method || !expect(' ')) {
+      return kFailed;
+    }
+    const auto path = p;
+    skip([](const char ch) noexcept {
+      return ch >= '!' && ch <= '~' && ch != '"';
+    });
+    if (p == path || !input.substr(p).starts_with(" HTTP/")) {
+      return kFailed;
+    }
+    p += 6;
+    if (!(p + 3 < size && is_digit(input[p]) && input[p + 1] == '.' &&
+          is_digit(input[p + 2]) && input[p + 3] == '"')) {
+      return kFailed;
+    }
+    p += 4;
+    if (!(expect(' ') && number() && expect(' ') &&
+          (number() || expect('-')) && expect('\n'))) {
+      return kFailed;
+    }
+  }
+  return p;
+}
+
+static auto MakeLog(const size_t line_count) noexcept -> std::string {
+  std::string input;
+  for (size_t i{}; i < line_count; ++i) {
+    input += "10.0." + std::to_string(i % 256) + "." +
+             std::to_string(i * 7 % 256) + " - user_" + std::to_string(i) +
+             " [10/Oct/2000:13:55:36 -0700] \"GET /static/img" +
+             std::to_string(i) + ".gif HTTP/1.0\" 200 " +
+             (i % 5 == 0 ? std::string{"-"} : std::to_string(i * 31)) + "\n";
+  }
+  return input;
+}
+
+static auto BM_LogCombinator(benchmark::State& state) -> void {
+  const auto input = MakeLog(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto res = kero::peg::combinator::Parse(log_line::kFile, input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_LogCombinator)->Arg(10000);
+
+static auto BM_LogHandWritten(benchmark::State& state) -> void {
+  const auto input = MakeLog(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    const auto end = ParseLogHandWritten(input);
+    if (end != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(end);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+}
+BENCHMARK(BM_LogHandWritten)->Arg(10000);
@@ -0,0 +1,85 @@
+#include "./combinator.h"
+
+#include <string_view>
+
+#include "gtest/gtest.h"
+
+using namespace kero::peg::combinator;
+
+namespace {
+
+// The length `expression` matches, or -1 on failure.
+template <Expression E>
+auto Match(const E& expression, const std::string_view input) noexcept
+    -> int64_t {
+  auto res = Parse(expression, input);
+  return res.IsOk() ? static_cast<int64_t>(*res.Ok()) : -1;
+}
+
+// Grammars are constant expressions, and so are their matches.
+constexpr auto kNumber =
+    -Lit('-') >> +Set<"0-9">() >> -('.' >> +Set<"0-9">());
+static_assert(Parse(kNumber, "-12.5x").IsOk());
+static_assert(Parse(kNumber, "-.5").IsErr());
+
+} // namespace
+
+TEST(CombinatorTest, Terminals) {
+  constexpr auto grammar = Lit("ab") >> Set<"0-9">() >> kAny;
+  EXPECT_EQ(Match(grammar, "ab1x"), 4);
+  EXPECT_EQ(Match(grammar, "ab1xyz"), 4);
+  EXPECT_EQ(Match(grammar, "ab1"), -1);
+  EXPECT_EQ(Match(grammar, "ax1x"), -1);
+  EXPECT_EQ(Match(grammar, "abxx"), -1);
+}
+
+TEST(CombinatorTest, Classes) {
+  // Few ranges are compared one by one, more probe the bitmap.
+  EXPECT_EQ(Match(+Set<"a-cx_">(), "abx_cd"), 5);
+  EXPECT_EQ(Match(+Set<"acegikmoq">(), "qmab"), 3);
+  EXPECT_EQ(Match(Set<"\x80-\xff">(), "\xe9"), 1);
+  EXPECT_EQ(Match(Set<"\x80-\xff">(), "e"), -1);
+}
+
+TEST(CombinatorTest, OrderedChoice) {
+  // The first alternative that matches wins, even if a later one is longer.
+  constexpr auto grammar = Lit('a') | "ab";
+  EXPECT_EQ(Match(grammar, "ab"), 1);
+  EXPECT_EQ(Match(grammar, "b"), -1);
+}
+
+TEST(CombinatorTest, Precedence) {
+  // `>>` binds tighter than `|`, as sequence does over `/` in a grammar.
+  constexpr auto grammar = Lit('a') >> 'b' | Lit('a') >> 'c';
+  EXPECT_EQ(Match(grammar, "ac"), 2);
+}
+
+TEST(CombinatorTest, Repetition) {
+  EXPECT_EQ(Match(*Lit('a'), ""), 0);
+  EXPECT_EQ(Match(*Lit('a'), "aaab"), 3);
+  EXPECT_EQ(Match(+Lit('a'), ""), -1);
+  EXPECT_EQ(Match(+Lit('a'), "aaab"), 3);
+  EXPECT_EQ(Match(-Lit('a') >> 'b', "ab"), 2);
+  EXPECT_EQ(Match(-Lit('a') >> 'b', "b"), 1);
+  // Spans and loops whose body matches nothing still end.
+  EXPECT_EQ(Match(*Set<"a-c">() >> 'x', "abcabx"), 6);
+  EXPECT_EQ(Match(*(-Lit('a')) >> 'b', "aab"), 3);
+  EXPECT_EQ(Match(+(*Lit('a')) >> 'b', "b"), 1);
+}
+
+TEST(CombinatorTest, Predicates) {
+  constexpr auto grammar = &Lit('a') >> Set<"a-z">() >> !Lit('c') >> kAny;
+  EXPECT_EQ(Match(grammar, "abd"), 2);
+  EXPECT_EQ(Match(grammar, "bbd"), -1);
+  EXPECT_EQ(Match(grammar, "acd"), -1);
+  EXPECT_EQ(Match(*(!Lit("*/") >> kAny) >> "*/", "a * b */ c"), 8);
+}
+
+TEST(CombinatorTest, Error) {
+  constexpr auto grammar = Lit("ab") >> "cd" | Lit('a') >> 'x';
+  auto res = Parse(grammar, "abce");
+  ASSERT_TRUE(res.IsErr());
+  EXPECT_EQ(res.Err()->position, 2u);
+  EXPECT_EQ(Match(!kAny, "a"), -1);
+  EXPECT_EQ(Match('a' >> !kAny, "a"), 1);
+}
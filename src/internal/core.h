@@ -1,17 +1,20 @@
 #ifndef KERO_PEG_INTERNAL_CORE_H
 #define KERO_PEG_INTERNAL_CORE_H
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <optional>
 #include <ostream>
+#include <string_view>
 
 namespace kero {
 namespace peg {
 
 template <typename T, typename E> class Result {
 public:
-  Result(T&& data) noexcept : data_{std::move(data)} {}
-  Result(E&& error) noexcept : error_{std::move(error)} {}
+  constexpr Result(T&& data) noexcept : data_{std::move(data)} {}
+  constexpr Result(E&& error) noexcept : error_{std::move(error)} {}
   Result(Result&&) noexcept = default;
   ~Result() noexcept = default;
   auto operator=(Result&&) -> Result& = default;
@@ -19,11 +22,11 @@ public:
   Result(const Result&) = delete;
   auto operator=(const Result&) -> Result& = delete;
 
-  auto IsOk() const noexcept -> bool { return data_.has_value(); }
+  constexpr auto IsOk() const noexcept -> bool { return data_.has_value(); }
 
-  auto IsErr() const noexcept -> bool { return error_.has_value(); }
+  constexpr auto IsErr() const noexcept -> bool { return error_.has_value(); }
 
-  auto Ok() noexcept -> std::optional<T> {
+  constexpr auto Ok() noexcept -> std::optional<T> {
     if (IsOk()) {
       assert(data_.has_value());
       assert(!error_.has_value());
@@ -34,7 +37,7 @@ public:
     return std::nullopt;
   }
 
-  auto Err() noexcept -> std::optional<E> {
+  constexpr auto Err() noexcept -> std::optional<E> {
     if (IsErr()) {
       assert(!data_.has_value());
       assert(error_.has_value());
@@ -46,7 +49,7 @@ public:
   }
 
   template <typename F>
-  auto AndThen(F&& f) noexcept -> decltype(f(std::declval<T>())) {
+  constexpr auto AndThen(F&& f) noexcept -> decltype(f(std::declval<T>())) {
     static_assert(std::is_invocable_v<F, T>,
                   "Function must be invocable with T");
     if (IsOk()) {
@@ -60,7 +63,7 @@ public:
   }
 
   template <typename F>
-  auto OrElse(F&& f) noexcept -> decltype(f(std::declval<E>())) {
+  constexpr auto OrElse(F&& f) noexcept -> decltype(f(std::declval<E>())) {
     static_assert(std::is_invocable_v<F, E>,
                   "Function must be invocable with E");
     if (IsErr()) {
@@ -101,8 +104,8 @@ private:
   };
 
 public:
-  Result() noexcept : data_{Void{}} {}
-  Result(E&& error) noexcept : error_{std::move(error)} {}
+  constexpr Result() noexcept : data_{Void{}} {}
+  constexpr Result(E&& error) noexcept : error_{std::move(error)} {}
   Result(Result&&) noexcept = default;
   ~Result() noexcept = default;
   auto operator=(Result&&) -> Result& = default;
@@ -110,11 +113,11 @@ public:
   Result(const Result&) = delete;
   auto operator=(const Result&) -> Result& = delete;
 
-  auto IsOk() const noexcept -> bool { return data_.has_value(); }
+  constexpr auto IsOk() const noexcept -> bool { return data_.has_value(); }
 
-  auto IsErr() const noexcept -> bool { return error_.has_value(); }
+  constexpr auto IsErr() const noexcept -> bool { return error_.has_value(); }
 
-  auto Ok() noexcept -> void {
+  constexpr auto Ok() noexcept -> void {
     if (IsOk()) {
       assert(data_.has_value());
       assert(!error_.has_value());
@@ -123,7 +126,7 @@ public:
     }
   }
 
-  auto Err() noexcept -> std::optional<E> {
+  constexpr auto Err() noexcept -> std::optional<E> {
     if (IsErr()) {
       assert(!data_.has_value());
       assert(error_.has_value());
@@ -134,7 +137,8 @@ public:
     return std::nullopt;
   }
 
-  template <typename F> auto AndThen(F&& f) noexcept -> decltype(f()) {
+  template <typename F>
+  constexpr auto AndThen(F&& f) noexcept -> decltype(f()) {
     static_assert(std::is_invocable_v<F>,
                   "Function must be invocable without arguments");
     if (IsOk()) {
@@ -149,7 +153,7 @@ public:
   }
 
   template <typename F>
-  auto OrElse(F&& f) noexcept -> decltype(f(std::declval<E>())) {
+  constexpr auto OrElse(F&& f) noexcept -> decltype(f(std::declval<E>())) {
     static_assert(std::is_invocable_v<F, E>,
                   "Function must be invocable with E");
     if (IsErr()) {
@@ -184,6 +188,19 @@ auto operator<<(std::ostream& os, Result<void, E>& result) -> std::ostream& {
   return os;
 }
 
+// A string literal usable as a template argument.
+template <size_t Size> struct FixedString {
+  char data[Size]{};
+
+  constexpr FixedString(const char (&value)[Size]) noexcept {
+    std::copy_n(value, Size, data);
+  }
+
+  constexpr auto View() const noexcept -> std::string_view {
+    return std::string_view{data, Size - 1};
+  }
+};
+
 } // namespace peg
 } // namespace kero
 
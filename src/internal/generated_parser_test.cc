@@ -0,0 +1,81 @@
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "sample_parser.h"
+
+namespace {
+
+namespace sample = kero::peg::sample;
+
+// The length matched by `parse`, or -1 on failure.
+template <typename Parse>
+auto Match(Parse parse, const std::string_view input) noexcept -> int64_t {
+  auto res = parse(input, sample::kDefaultMaxDepth);
+  return res.IsOk() ? static_cast<int64_t>(*res.Ok()) : -1;
+}
+
+template <typename Parse>
+auto ErrorPosition(Parse parse, const std::string_view input) noexcept
+    -> int64_t {
+  auto res = parse(input, sample::kDefaultMaxDepth);
+  EXPECT_TRUE(res.IsErr());
+  return res.IsErr() ? static_cast<int64_t>(res.Err()->position) : -1;
+}
+
+} // namespace
+
+TEST(GeneratedParserTest, Csv) {
+  EXPECT_EQ(Match(sample::ParseFile, ""), 0);
+  EXPECT_EQ(Match(sample::ParseFile, "a,b;\"x, y\",3.5;"), 15);
+  EXPECT_EQ(Match(sample::ParseFile, ",,;"), 3);
+  EXPECT_EQ(Match(sample::ParseFile, "a,b"), -1);
+  EXPECT_EQ(Match(sample::ParseLine, "a;rest"), 2);
+  EXPECT_EQ(Match(sample::ParseField, "\"open"), 0);
+}
+
+TEST(GeneratedParserTest, Arithmetic) {
+  EXPECT_EQ(Match(sample::ParseExpr, "1+2*(3-4)/5"), 11);
+  EXPECT_EQ(Match(sample::ParseExpr, "((7))"), 5);
+  EXPECT_EQ(Match(sample::ParseExpr, "1+"), -1);
+  EXPECT_EQ(Match(sample::ParseSum, "1+"), 1);
+  EXPECT_EQ(ErrorPosition(sample::ParseExpr, "(1+2"), 4);
+}
+
+TEST(GeneratedParserTest, DeepNesting) {
+  const auto nested = [](const size_t depth) noexcept {
+    return std::string(depth, '(') + "1" + std::string(depth, ')');
+  };
+  EXPECT_EQ(Match(sample::ParseExpr, nested(500)), 1001);
+  auto res = sample::ParseExpr(nested(100000));
+  ASSERT_TRUE(res.IsErr());
+  EXPECT_EQ(res.Err()->code, sample::ErrorCode::kStackOverflow);
+  EXPECT_EQ(sample::ParseExpr("(1", 2).Err()->code,
+            sample::ErrorCode::kStackOverflow);
+  EXPECT_EQ(sample::ParseExpr("(1").Err()->code,
+            sample::ErrorCode::kNoMatch);
+}
+
+TEST(GeneratedParserTest, Cut) {
+  EXPECT_EQ(Match(sample::ParseList, "a,bc,d."), 7);
+  EXPECT_EQ(Match(sample::ParseList, "none."), 5);
+  // Past the cut a missing '.' does not fall back to reading a Name.
+  EXPECT_EQ(Match(sample::ParseList, "nonex."), -1);
+  EXPECT_EQ(Match(sample::ParseList, "nonx."), 5);
+}
+
+TEST(GeneratedParserTest, SparseCharClass) {
+  EXPECT_EQ(Match(sample::ParseSparse, "abcfz;"), 6);
+  EXPECT_EQ(Match(sample::ParseSparse, "abd;"), -1);
+  EXPECT_EQ(ErrorPosition(sample::ParseSparse, "abd;"), 2);
+}
+
+TEST(GeneratedParserTest, RuleNamedLikeErrorType) {
+  // The rules generate ParseError and ParseErrorCode next to the Error and
+  // ErrorCode types.
+  EXPECT_EQ(Match(sample::ParseError, "error 404"), 9);
+  EXPECT_EQ(Match(sample::ParseError, "error x"), -1);
+  EXPECT_EQ(Match(sample::ParseErrorCode, "500;"), 3);
+  const sample::Error error{sample::ErrorCode::kNoMatch, 0};
+  EXPECT_EQ(error.code, sample::ErrorCode::kNoMatch);
+}
@@ -0,0 +1,459 @@
+#include "./grammar_image.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+constexpr size_t kGrammarImageAlignment = 8;
+
+auto AlignUp(const size_t offset) noexcept -> size_t {
+  return (offset + kGrammarImageAlignment - 1) & ~(kGrammarImageAlignment - 1);
+}
+
+// Byte offsets of the sections of an image.
+struct GrammarImageLayout {
+  size_t nodes;
+  size_t rule_indices;
+  size_t names;
+  size_t char_classes;
+  size_t source;
+  size_t size;
+};
+
+auto GetLayout(const GrammarImageHeader& header) noexcept
+    -> GrammarImageLayout {
+  auto layout = GrammarImageLayout{};
+  auto offset = AlignUp(sizeof(GrammarImageHeader));
+  layout.nodes = offset;
+  offset = AlignUp(offset + sizeof(ast::FlatNode) * header.node_count);
+  layout.rule_indices = offset;
+  offset = AlignUp(offset + sizeof(uint32_t) * header.symbol_count);
+  layout.names = offset;
+  offset = AlignUp(offset + sizeof(SymbolName) * header.symbol_count);
+  layout.char_classes = offset;
+  offset = AlignUp(offset + sizeof(CharClass) * header.char_class_count);
+  layout.source = offset;
+  layout.size = AlignUp(offset + header.source_size);
+  return layout;
+}
+
+template <typename T>
+auto SectionOf(const std::span<const std::byte> bytes, const size_t offset,
+               const size_t count) noexcept -> std::span<const T> {
+  static_assert(alignof(T) <= kGrammarImageAlignment);
+  return {reinterpret_cast<const T*>(bytes.data() + offset), count};
+}
+
+// Every index and range in the image stays inside it, every node but the
+// root is the child of exactly one node that comes after it, and each kind of
+// node has the children the parser gives it, so the nodes form a tree that can
+// be walked and converted without further checks.
+auto IsWellFormed(const std::span<const ast::FlatNode> nodes,
+                  const std::span<const uint32_t> rule_indices,
+                  const std::span<const SymbolName> names,
+                  const size_t char_class_count,
+                  const size_t source_size) noexcept -> bool {
+  if (nodes.empty() || nodes[0].kind != ast::NodeKind::kRuleSet) {
+    return false;
+  }
+
+  const auto in_source = [source_size](const uint64_t start,
+                                       const uint64_t length) noexcept {
+    return start + length <= source_size;
+  };
+
+  // Height of the subtree under each node. Children come before their
+  // parent, so it is known for every child by the time the parent is
+  // checked; the root comes last.
+  std::vector<uint32_t> heights(nodes.size());
+  std::vector<bool> claimed(nodes.size());
+  const auto check = [&](const size_t i) noexcept {
+    const auto& node = nodes[i];
+    if (!in_source(node.start, node.length)) {
+      return false;
+    }
+
+    auto children = size_t{};
+    switch (node.kind) {
+    case ast::NodeKind::kNonTerminal:
+      return node.child_count == 0 && node.symbol < names.size();
+    case ast::NodeKind::kBracketedTerminal:
+      return node.child_count == 0 && node.char_class < char_class_count &&
+             node.length >= 2;
+    case ast::NodeKind::kQuotedTerminal:
+      return node.child_count == 0 && node.length >= 2;
+    case ast::NodeKind::kAnyCharacter:
+    case ast::NodeKind::kCut:
+      return node.child_count == 0;
+    case ast::NodeKind::kRuleSet:
+      // Every symbol is defined by exactly one rule.
+      if (i != 0 || node.child_count != names.size()) {
+        return false;
+      }
+      children = node.child_count;
+      break;
+    case ast::NodeKind::kRule:
+      if (node.child_count != 2) {
+        return false;
+      }
+      children = 2;
+      break;
+    case ast::NodeKind::kSequence:
+      if (node.child_count == 1) {
+        return false;
+      }
+      children = node.child_count;
+      break;
+    case ast::NodeKind::kOrderedChoice:
+      if (node.child_count < 2) {
+        return false;
+      }
+      children = node.child_count;
+      break;
+    case ast::NodeKind::kZeroOrMore:
+    case ast::NodeKind::kOneOrMore:
+    case ast::NodeKind::kOptional:
+    case ast::NodeKind::kAndPredicate:
+    case ast::NodeKind::kNotPredicate:
+    case ast::NodeKind::kGroup:
+      if (node.child_count != 1) {
+        return false;
+      }
+      children = 1;
+      break;
+    default:
+      return false;
+    }
+
+    if (children == 0) {
+      return true;
+    }
+    const auto end = uint64_t{node.first_child} + children;
+    const auto in_order = i == 0 ? node.first_child > 0 : end <= i;
+    if (!in_order || end > nodes.size()) {
+      return false;
+    }
+
+    for (auto child = size_t{node.first_child}; child < end; ++child) {
+      const auto kind = nodes[child].kind;
+      auto expected = ast::IsExpressionNodeKind(kind);
+      if (node.kind == ast::NodeKind::kRuleSet) {
+        expected = kind == ast::NodeKind::kRule;
+      } else if (node.kind == ast::NodeKind::kRule &&
+                 child == node.first_child) {
+        expected = kind == ast::NodeKind::kNonTerminal;
+      }
+      if (!expected || claimed[child]) {
+        return false;
+      }
+      claimed[child] = true;
+      heights[i] = std::max(heights[i], heights[child] + 1);
+    }
+    return heights[i] <= kGrammarImageMaxDepth;
+  };
+
+  for (size_t i = 1; i < nodes.size(); ++i) {
+    if (!check(i)) {
+      return false;
+    }
+  }
+  if (!check(0)) {
+    return false;
+  }
+
+  // The rule at each index defines the symbol the index is for.
+  const auto& root = nodes[0];
+  for (uint32_t symbol{}; symbol < rule_indices.size(); ++symbol) {
+    if (rule_indices[symbol] >= root.child_count) {
+      return false;
+    }
+    const auto& rule = nodes[root.first_child + rule_indices[symbol]];
+    if (nodes[rule.first_child].symbol != symbol) {
+      return false;
+    }
+  }
+
+  for (const auto& name : names) {
+    if (!in_source(name.start, name.length)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto operator<<(std::ostream& os, const GrammarImageErrorCode error) noexcept
+    -> std::ostream& {
+  switch (error) {
+  case GrammarImageErrorCode::kFileOpenFailed:
+    os << "FileOpenFailed";
+    break;
+  case GrammarImageErrorCode::kFileReadFailed:
+    os << "FileReadFailed";
+    break;
+  case GrammarImageErrorCode::kFileWriteFailed:
+    os << "FileWriteFailed";
+    break;
+  case GrammarImageErrorCode::kTooSmall:
+    os << "TooSmall";
+    break;
+  case GrammarImageErrorCode::kMisaligned:
+    os << "Misaligned";
+    break;
+  case GrammarImageErrorCode::kMagicMismatch:
+    os << "MagicMismatch";
+    break;
+  case GrammarImageErrorCode::kVersionMismatch:
+    os << "VersionMismatch";
+    break;
+  case GrammarImageErrorCode::kByteOrderMismatch:
+    os << "ByteOrderMismatch";
+    break;
+  case GrammarImageErrorCode::kSizeMismatch:
+    os << "SizeMismatch";
+    break;
+  case GrammarImageErrorCode::kChecksumMismatch:
+    os << "ChecksumMismatch";
+    break;
+  case GrammarImageErrorCode::kMalformed:
+    os << "Malformed";
+    break;
+  case GrammarImageErrorCode::kTooLarge:
+    os << "TooLarge";
+    break;
+  }
+  return os;
+}
+
+// FNV-1a over 64-bit words rather than bytes, so checking a large image costs
+// little next to mapping it. Each step is a bijection of the running hash, so
+// changing any single word changes the result.
+auto GrammarImageChecksum(const std::span<const std::byte> image) noexcept
+    -> uint64_t {
+  assert(image.size() >= sizeof(GrammarImageHeader));
+  const auto bytes = image.subspan(sizeof(GrammarImageHeader));
+  assert(bytes.size() % sizeof(uint64_t) == 0);
+  auto hash = uint64_t{0xcbf29ce484222325};
+  for (size_t i{}; i < bytes.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes.data() + i, sizeof(word));
+    hash = (hash ^ word) * uint64_t{0x100000001b3};
+  }
+  return hash;
+}
+
+auto WriteGrammarImage(const ast::FlatTree& tree) noexcept
+    -> Result<std::vector<std::byte>, GrammarImageErrorCode> {
+  using R = Result<std::vector<std::byte>, GrammarImageErrorCode>;
+  const auto nodes = tree.GetNodes();
+  const auto rule_indices = tree.GetRuleIndices();
+  const auto& symbols = tree.GetSymbols();
+  const auto char_classes = tree.GetCharClasses();
+  const auto source = tree.GetSource();
+  // Symbols and character classes are fewer than nodes.
+  if (source.size() > std::numeric_limits<uint32_t>::max() ||
+      nodes.size() > std::numeric_limits<uint32_t>::max()) {
+    return R{GrammarImageErrorCode::kTooLarge};
+  }
+
+  auto header = GrammarImageHeader{};
+  header.magic = kGrammarImageMagic;
+  header.version = kGrammarImageVersion;
+  header.byte_order_mark = kGrammarImageByteOrderMark;
+  header.node_count = static_cast<uint32_t>(nodes.size());
+  header.symbol_count = static_cast<uint32_t>(symbols.Size());
+  header.char_class_count = static_cast<uint32_t>(char_classes.size());
+  header.source_size = static_cast<uint32_t>(source.size());
+  const auto layout = GetLayout(header);
+  header.size = layout.size;
+
+  auto bytes = std::vector<std::byte>(layout.size);
+  const auto write = [&bytes](const size_t offset, const void* data,
+                              const size_t size) noexcept {
+    if (size != 0) {
+      std::memcpy(bytes.data() + offset, data, size);
+    }
+  };
+  write(layout.nodes, nodes.data(), nodes.size_bytes());
+  write(layout.rule_indices, rule_indices.data(), rule_indices.size_bytes());
+  for (uint32_t symbol{}; symbol < symbols.Size(); ++symbol) {
+    // Names are views into the source.
+    const auto name = symbols.GetName(symbol);
+    const auto symbol_name =
+        SymbolName{static_cast<uint32_t>(name.data() - source.data()),
+                   static_cast<uint32_t>(name.size())};
+    write(layout.names + sizeof(SymbolName) * symbol, &symbol_name,
+          sizeof(symbol_name));
+  }
+  write(layout.char_classes, char_classes.data(), char_classes.size_bytes());
+  write(layout.source, source.data(), source.size());
+
+  header.checksum = GrammarImageChecksum(bytes);
+  write(0, &header, sizeof(header));
+  return R{std::move(bytes)};
+}
+
+auto WriteGrammarImageFile(const ast::FlatTree& tree,
+                           const std::string& path) noexcept
+    -> Result<void, GrammarImageErrorCode> {
+  auto res = WriteGrammarImage(tree);
+  if (res.IsErr()) {
+    return Result<void, GrammarImageErrorCode>{*res.Err()};
+  }
+
+  const auto bytes = std::move(*res.Ok());
+  auto file = std::ofstream{path, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    return Result<void, GrammarImageErrorCode>{
+        GrammarImageErrorCode::kFileOpenFailed};
+  }
+
+  file.write(reinterpret_cast<const char*>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+  file.close();
+  if (!file) {
+    return Result<void, GrammarImageErrorCode>{
+        GrammarImageErrorCode::kFileWriteFailed};
+  }
+  return Result<void, GrammarImageErrorCode>{};
+}
+
+auto GrammarImage::Load(const std::span<const std::byte> bytes) noexcept
+    -> Result<GrammarImage, GrammarImageErrorCode> {
+  using R = Result<GrammarImage, GrammarImageErrorCode>;
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % kGrammarImageAlignment !=
+      0) {
+    return R{GrammarImageErrorCode::kMisaligned};
+  }
+
+  if (bytes.size() < sizeof(GrammarImageHeader)) {
+    return R{GrammarImageErrorCode::kTooSmall};
+  }
+
+  auto header = GrammarImageHeader{};
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != kGrammarImageMagic) {
+    return R{GrammarImageErrorCode::kMagicMismatch};
+  }
+
+  if (header.byte_order_mark != kGrammarImageByteOrderMark) {
+    return R{GrammarImageErrorCode::kByteOrderMismatch};
+  }
+
+  if (header.version != kGrammarImageVersion) {
+    return R{GrammarImageErrorCode::kVersionMismatch};
+  }
+
+  const auto layout = GetLayout(header);
+  if (header.size != layout.size || bytes.size() != layout.size) {
+    return R{GrammarImageErrorCode::kSizeMismatch};
+  }
+
+  if (header.checksum != GrammarImageChecksum(bytes)) {
+    return R{GrammarImageErrorCode::kChecksumMismatch};
+  }
+
+  auto image = GrammarImage{};
+  image.nodes_ =
+      SectionOf<ast::FlatNode>(bytes, layout.nodes, header.node_count);
+  image.rule_indices_ =
+      SectionOf<uint32_t>(bytes, layout.rule_indices, header.symbol_count);
+  image.names_ =
+      SectionOf<SymbolName>(bytes, layout.names, header.symbol_count);
+  image.char_classes_ = SectionOf<CharClass>(bytes, layout.char_classes,
+                                             header.char_class_count);
+  image.source_ = std::string_view{
+      reinterpret_cast<const char*>(bytes.data() + layout.source),
+      header.source_size};
+  if (!IsWellFormed(image.nodes_, image.rule_indices_, image.names_,
+                    image.char_classes_.size(), image.source_.size())) {
+    return R{GrammarImageErrorCode::kMalformed};
+  }
+
+  return R{std::move(image)};
+}
+
+auto GrammarImage::ToFlatTree() const noexcept
+    -> Result<ast::FlatTree, GrammarImageErrorCode> {
+  using R = Result<ast::FlatTree, GrammarImageErrorCode>;
+  auto symbols = SymbolTable{};
+  for (uint32_t symbol{}; symbol < names_.size(); ++symbol) {
+    if (symbols.Intern(GetSymbolName(symbol)) != symbol) {
+      return R{GrammarImageErrorCode::kMalformed};
+    }
+  }
+
+  return R{ast::FlatTree{
+      source_, std::vector<ast::FlatNode>{nodes_.begin(), nodes_.end()},
+      std::move(symbols),
+      std::vector<uint32_t>{rule_indices_.begin(), rule_indices_.end()},
+      std::vector<CharClass>{char_classes_.begin(), char_classes_.end()}}};
+}
+
+auto MappedFile::Open(const std::string& path) noexcept
+    -> Result<MappedFile, GrammarImageErrorCode> {
+  using R = Result<MappedFile, GrammarImageErrorCode>;
+  const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return R{GrammarImageErrorCode::kFileOpenFailed};
+  }
+
+  struct stat status {};
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    return R{GrammarImageErrorCode::kFileReadFailed};
+  }
+
+  const auto size = static_cast<size_t>(status.st_size);
+  if (size == 0) {
+    ::close(fd);
+    return R{MappedFile{nullptr, 0}};
+  }
+
+  auto data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return R{GrammarImageErrorCode::kFileReadFailed};
+  }
+
+  return R{MappedFile{static_cast<const std::byte*>(data), size}};
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)} {}
+
+MappedFile::~MappedFile() noexcept {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<std::byte*>(data_), size_);
+  }
+}
+
+auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile& {
+  if (this != &other) {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<std::byte*>(data_), size_);
+    }
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+} // namespace peg
+} // namespace kero
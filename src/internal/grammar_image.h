@@ -0,0 +1,196 @@
+#ifndef KERO_PEG_INTERNAL_GRAMMAR_IMAGE_H
+#define KERO_PEG_INTERNAL_GRAMMAR_IMAGE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./ast.h"
+#include "./char_class.h"
+#include "./core.h"
+
+namespace kero {
+namespace peg {
+
+// A parsed grammar as one position-independent block of bytes, so it can be
+// written to a file once and memory-mapped at startup instead of lexing and
+// parsing the text again. The layout is a GrammarImageHeader followed by
+// these sections, each starting at a multiple of 8 bytes:
+//
+//   ast::FlatNode  nodes[node_count]         as in ast::FlatTree
+//   uint32_t       rule_indices[symbol_count]
+//   SymbolName     names[symbol_count]
+//   CharClass      char_classes[char_class_count]
+//   char           source[source_size]
+//
+// The image is in host byte order and layout. A version, a byte order mark
+// and a checksum of everything after the header are checked on load. Sizes
+// and offsets are 32-bit, so the source must be under 4 GiB.
+constexpr std::array<char, 8> kGrammarImageMagic{'K', 'E', 'R', 'O',
+                                                 'P', 'E', 'G', '\0'};
+constexpr uint32_t kGrammarImageVersion = 1;
+constexpr uint32_t kGrammarImageByteOrderMark = 0x01020304;
+
+struct GrammarImageHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t byte_order_mark;
+  uint64_t checksum;
+  uint64_t size; // of the whole image
+  uint32_t node_count;
+  uint32_t symbol_count;
+  uint32_t char_class_count;
+  uint32_t source_size;
+};
+
+static_assert(sizeof(GrammarImageHeader) == 48);
+
+// Nodes deeper than this are rejected on load, so walking a loaded tree
+// recursively cannot overflow the stack. It leaves room for every tree the
+// parser builds with kParserDefaultMaxDepth.
+constexpr size_t kGrammarImageMaxDepth = 8 * ast::kParserDefaultMaxDepth;
+
+// A symbol's name as a range of the source.
+struct SymbolName {
+  uint32_t start;
+  uint32_t length;
+};
+
+enum class GrammarImageErrorCode : int32_t {
+  kFileOpenFailed = 0,
+  kFileReadFailed,
+  kFileWriteFailed,
+  kTooSmall,
+  kMisaligned,
+  kMagicMismatch,
+  kVersionMismatch,
+  kByteOrderMismatch,
+  kSizeMismatch,
+  kChecksumMismatch,
+  kMalformed,
+  kTooLarge,
+};
+
+auto operator<<(std::ostream& os, const GrammarImageErrorCode error) noexcept
+    -> std::ostream&;
+
+// The checksum stored in the header of `image`, computed over every byte after
+// the header.
+auto GrammarImageChecksum(const std::span<const std::byte> image) noexcept
+    -> uint64_t;
+
+// Serializes `tree` into a grammar image. Fails with kTooLarge if its source
+// or node count does not fit in 32 bits.
+auto WriteGrammarImage(const ast::FlatTree& tree) noexcept
+    -> Result<std::vector<std::byte>, GrammarImageErrorCode>;
+
+auto WriteGrammarImageFile(const ast::FlatTree& tree,
+                           const std::string& path) noexcept
+    -> Result<void, GrammarImageErrorCode>;
+
+// A validated view of a grammar image. Nothing is copied, so the bytes must
+// outlive the view.
+class GrammarImage {
+public:
+  // Checks the header, checksum and every index in `bytes`, which must be
+  // aligned to 8 bytes, and that the nodes form a tree of the shape the
+  // parser builds: a RuleSet of Rules, each defining the symbol its
+  // rule_indices entry names, with the child count of every node kind.
+  static auto Load(const std::span<const std::byte> bytes) noexcept
+      -> Result<GrammarImage, GrammarImageErrorCode>;
+
+  // Copies the image into a FlatTree, whose ToNode then gives the RuleSet
+  // the engines run. The tree views the source in the image, so the bytes
+  // must outlive it too. Fails with kMalformed if two symbols share a name.
+  auto ToFlatTree() const noexcept
+      -> Result<ast::FlatTree, GrammarImageErrorCode>;
+
+  auto GetSource() const noexcept -> std::string_view { return source_; }
+
+  auto GetNodes() const noexcept -> std::span<const ast::FlatNode> {
+    return nodes_;
+  }
+
+  auto GetRoot() const noexcept -> const ast::FlatNode& {
+    return nodes_.front();
+  }
+
+  auto GetChildren(const ast::FlatNode& node) const noexcept
+      -> std::span<const ast::FlatNode> {
+    if (node.child_count == 0) {
+      return {};
+    }
+    return nodes_.subspan(node.first_child, node.child_count);
+  }
+
+  auto GetSymbolCount() const noexcept -> size_t { return names_.size(); }
+
+  auto GetSymbolName(const uint32_t symbol) const noexcept
+      -> std::string_view {
+    return source_.substr(names_[symbol].start, names_[symbol].length);
+  }
+
+  // The Rule defining `symbol`.
+  auto GetRule(const uint32_t symbol) const noexcept -> const ast::FlatNode& {
+    return nodes_[GetRoot().first_child + rule_indices_[symbol]];
+  }
+
+  auto GetCharClass(const ast::FlatNode& node) const noexcept
+      -> const CharClass& {
+    return char_classes_[node.char_class];
+  }
+
+  auto GetOriginal(const ast::FlatNode& node) const noexcept
+      -> std::string_view {
+    return source_.substr(node.start, node.length);
+  }
+
+  auto GetValue(const ast::FlatNode& node) const noexcept -> std::string_view {
+    return ast::GetFlatNodeValue(node.kind, GetOriginal(node));
+  }
+
+private:
+  GrammarImage() noexcept = default;
+
+  std::span<const ast::FlatNode> nodes_;
+  std::span<const uint32_t> rule_indices_;
+  std::span<const SymbolName> names_;
+  std::span<const CharClass> char_classes_;
+  std::string_view source_;
+};
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+public:
+  static auto Open(const std::string& path) noexcept
+      -> Result<MappedFile, GrammarImageErrorCode>;
+
+  MappedFile(MappedFile&& other) noexcept;
+  ~MappedFile() noexcept;
+  auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+
+  MappedFile(const MappedFile&) = delete;
+  auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+  // Page-aligned, so it can be passed to GrammarImage::Load.
+  auto GetBytes() const noexcept -> std::span<const std::byte> {
+    return {data_, size_};
+  }
+
+private:
+  MappedFile(const std::byte* data, const size_t size) noexcept
+      : data_{data}, size_{size} {}
+
+  const std::byte* data_{};
+  size_t size_{};
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_GRAMMAR_IMAGE_H
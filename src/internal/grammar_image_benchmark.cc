@@ -0,0 +1,73 @@
+#include "./grammar_image.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+static auto MakeImageGrammar(const size_t rule_count) noexcept -> std::string {
+  std::string source;
+  for (size_t i{}; i < rule_count; ++i) {
+    source += "Rule" + std::to_string(i) + " <- Rule" +
+              std::to_string((i + 1) % rule_count) + " ('kw" +
+              std::to_string(i) + "' / [a-zA-Z0-9_]+) (' ' / [\\t])* !.?\n";
+  }
+  return source;
+}
+
+// Startup from grammar text: lex and parse, then build the RuleSet the
+// engines run.
+static auto BM_LoadGrammarText(benchmark::State& state) -> void {
+  const auto source = MakeImageGrammar(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+    auto res = parser.ParseRuleSet();
+    if (res.IsErr()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    kero::peg::Arena arena;
+    benchmark::DoNotOptimize(res.Ok()->ToNode(arena));
+  }
+}
+BENCHMARK(BM_LoadGrammarText)->Arg(10000);
+
+// Startup from a grammar image: map the file, check it, then build the same
+// RuleSet from it.
+static auto BM_LoadGrammarImage(benchmark::State& state) -> void {
+  const auto source = MakeImageGrammar(static_cast<size_t>(state.range(0)));
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto tree_res = parser.ParseRuleSet();
+  const auto path =
+      (std::filesystem::temp_directory_path() / "kero_peg_image_bench.bin")
+          .string();
+  if (tree_res.IsErr() ||
+      kero::peg::WriteGrammarImageFile(*tree_res.Ok(), path).IsErr()) {
+    state.SkipWithError("setup failed");
+    return;
+  }
+
+  for (auto _ : state) {
+    auto file_res = kero::peg::MappedFile::Open(path);
+    if (file_res.IsErr()) {
+      state.SkipWithError("mmap failed");
+      break;
+    }
+    const auto file = std::move(*file_res.Ok());
+    auto image_res = kero::peg::GrammarImage::Load(file.GetBytes());
+    if (image_res.IsErr()) {
+      state.SkipWithError("load failed");
+      break;
+    }
+    auto res = image_res.Ok()->ToFlatTree();
+    if (res.IsErr()) {
+      state.SkipWithError("conversion failed");
+      break;
+    }
+    kero::peg::Arena arena;
+    benchmark::DoNotOptimize(res.Ok()->ToNode(arena));
+  }
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_LoadGrammarImage)->Arg(10000);
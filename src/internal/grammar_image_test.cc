@@ -0,0 +1,232 @@
+#include "./grammar_image.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+auto ParseFlat(const std::string_view source) noexcept
+    -> kero::peg::ast::FlatTree {
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{source}}};
+  auto res = parser.ParseRuleSet();
+  EXPECT_TRUE(res.IsOk());
+  return std::move(*res.Ok());
+}
+
+// Loads a copy of `bytes` held in 8-byte aligned storage.
+auto LoadErr(const std::vector<std::byte>& bytes) noexcept
+    -> kero::peg::GrammarImageErrorCode {
+  auto words = std::vector<uint64_t>((bytes.size() + 7) / 8);
+  std::memcpy(words.data(), bytes.data(), bytes.size());
+  auto res = kero::peg::GrammarImage::Load(
+      std::span{reinterpret_cast<const std::byte*>(words.data()),
+                bytes.size()});
+  EXPECT_TRUE(res.IsErr());
+  if (res.IsOk()) {
+    return kero::peg::GrammarImageErrorCode::kMalformed;
+  }
+  return *res.Err();
+}
+
+constexpr std::string_view kGrammar =
+    "Name <- [a-zA-Z] [a-zA-Z0-9_]*\n"
+    "List <- Name ^ (',' Name)* / 'none'\n";
+
+TEST(GrammarImageTest, RoundTrip) {
+  const auto tree = ParseFlat(kGrammar);
+  auto bytes_res = kero::peg::WriteGrammarImage(tree);
+  ASSERT_TRUE(bytes_res.IsOk());
+  const auto bytes = std::move(*bytes_res.Ok());
+  ASSERT_EQ(bytes.size() % 8, 0);
+  auto res = kero::peg::GrammarImage::Load(bytes);
+  ASSERT_TRUE(res.IsOk());
+  const auto image = std::move(*res.Ok());
+
+  EXPECT_EQ(image.GetSource(), kGrammar);
+  ASSERT_EQ(image.GetNodes().size(), tree.GetNodes().size());
+  for (size_t i{}; i < tree.GetNodes().size(); ++i) {
+    const auto& expected = tree.GetNodes()[i];
+    const auto& actual = image.GetNodes()[i];
+    EXPECT_EQ(actual.kind, expected.kind);
+    EXPECT_EQ(actual.child_count, expected.child_count);
+    EXPECT_EQ(image.GetOriginal(actual), tree.GetOriginal(expected));
+    EXPECT_EQ(image.GetValue(actual), tree.GetValue(expected));
+    if (expected.kind == kero::peg::ast::NodeKind::kBracketedTerminal) {
+      EXPECT_EQ(image.GetCharClass(actual), tree.GetCharClass(expected));
+    }
+  }
+
+  ASSERT_EQ(image.GetSymbolCount(), 2);
+  EXPECT_EQ(image.GetSymbolName(0), "Name");
+  EXPECT_EQ(image.GetSymbolName(1), "List");
+  EXPECT_EQ(image.GetOriginal(image.GetRule(1)),
+            "List <- Name ^ (',' Name)* / 'none'");
+}
+
+TEST(GrammarImageTest, ToFlatTree) {
+  const auto tree = ParseFlat(kGrammar);
+  auto bytes_res = kero::peg::WriteGrammarImage(tree);
+  ASSERT_TRUE(bytes_res.IsOk());
+  const auto bytes = std::move(*bytes_res.Ok());
+  auto image_res = kero::peg::GrammarImage::Load(bytes);
+  ASSERT_TRUE(image_res.IsOk());
+  auto res = image_res.Ok()->ToFlatTree();
+  ASSERT_TRUE(res.IsOk());
+  const auto loaded = std::move(*res.Ok());
+
+  std::ostringstream expected;
+  std::ostringstream actual;
+  kero::peg::Arena arena;
+  expected << *tree.ToNode(arena);
+  actual << *loaded.ToNode(arena);
+  EXPECT_EQ(actual.str(), expected.str());
+  ASSERT_EQ(loaded.GetSymbols().Size(), 2);
+  EXPECT_EQ(loaded.GetSymbols().Find("List"), 1);
+}
+
+TEST(GrammarImageTest, File) {
+  const auto tree = ParseFlat(kGrammar);
+  const auto path =
+      (std::filesystem::temp_directory_path() / "kero_peg_image_test.bin")
+          .string();
+  ASSERT_TRUE(kero::peg::WriteGrammarImageFile(tree, path).IsOk());
+  {
+    auto file_res = kero::peg::MappedFile::Open(path);
+    ASSERT_TRUE(file_res.IsOk());
+    const auto file = std::move(*file_res.Ok());
+    auto res = kero::peg::GrammarImage::Load(file.GetBytes());
+    ASSERT_TRUE(res.IsOk());
+    EXPECT_EQ(res.Ok()->GetSource(), kGrammar);
+  }
+  std::remove(path.c_str());
+
+  auto res = kero::peg::MappedFile::Open(path);
+  ASSERT_TRUE(res.IsErr());
+  EXPECT_EQ(*res.Err(), kero::peg::GrammarImageErrorCode::kFileOpenFailed);
+}
+
+TEST(GrammarImageTest, Errors) {
+  using kero::peg::GrammarImageErrorCode;
+  auto bytes_res = kero::peg::WriteGrammarImage(ParseFlat(kGrammar));
+  ASSERT_TRUE(bytes_res.IsOk());
+  const auto bytes = std::move(*bytes_res.Ok());
+
+  EXPECT_EQ(LoadErr({}), GrammarImageErrorCode::kTooSmall);
+
+  auto magic = bytes;
+  magic[0] = std::byte{'X'};
+  EXPECT_EQ(LoadErr(magic), GrammarImageErrorCode::kMagicMismatch);
+
+  auto version = bytes;
+  version[offsetof(kero::peg::GrammarImageHeader, version)] = std::byte{99};
+  EXPECT_EQ(LoadErr(version), GrammarImageErrorCode::kVersionMismatch);
+
+  auto truncated = bytes;
+  truncated.resize(truncated.size() - 8);
+  EXPECT_EQ(LoadErr(truncated), GrammarImageErrorCode::kSizeMismatch);
+
+  auto corrupted = bytes;
+  corrupted.back() ^= std::byte{1};
+  EXPECT_EQ(LoadErr(corrupted), GrammarImageErrorCode::kChecksumMismatch);
+}
+
+// Overwrites `value` at `offset` of `bytes` and reseals the checksum, so only
+// the structural checks can reject it.
+template <typename T>
+auto Patched(std::vector<std::byte> bytes, const size_t offset,
+             const T& value) noexcept -> std::vector<std::byte> {
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+  const auto checksum = kero::peg::GrammarImageChecksum(bytes);
+  std::memcpy(bytes.data() + offsetof(kero::peg::GrammarImageHeader, checksum),
+              &checksum, sizeof(checksum));
+  return bytes;
+}
+
+// Overwrites the node at `index`.
+auto WithNode(std::vector<std::byte> bytes, const size_t index,
+              const kero::peg::ast::FlatNode& node) noexcept
+    -> std::vector<std::byte> {
+  return Patched(std::move(bytes),
+                 sizeof(kero::peg::GrammarImageHeader) +
+                     sizeof(kero::peg::ast::FlatNode) * index,
+                 node);
+}
+
+auto WithRoot(std::vector<std::byte> bytes,
+              const kero::peg::ast::FlatNode& root) noexcept
+    -> std::vector<std::byte> {
+  return WithNode(std::move(bytes), 0, root);
+}
+
+TEST(GrammarImageTest, Malformed) {
+  const auto tree = ParseFlat(kGrammar);
+  auto bytes_res = kero::peg::WriteGrammarImage(tree);
+  ASSERT_TRUE(bytes_res.IsOk());
+  const auto bytes = std::move(*bytes_res.Ok());
+  const auto root = tree.GetRoot();
+
+  // Rules resolve to children the root no longer has.
+  auto no_rules = root;
+  no_rules.child_count = 0;
+  EXPECT_EQ(LoadErr(WithRoot(bytes, no_rules)),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  auto out_of_range = root;
+  out_of_range.first_child = static_cast<uint32_t>(tree.GetNodes().size());
+  EXPECT_EQ(LoadErr(WithRoot(bytes, out_of_range)),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  auto not_rule_set = root;
+  not_rule_set.kind = kero::peg::ast::NodeKind::kGroup;
+  EXPECT_EQ(LoadErr(WithRoot(bytes, not_rule_set)),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  auto bad_kind = root;
+  bad_kind.kind = static_cast<kero::peg::ast::NodeKind>(1000);
+  EXPECT_EQ(LoadErr(WithRoot(bytes, bad_kind)),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  auto bad_span = root;
+  bad_span.length = static_cast<uint32_t>(kGrammar.size() + 1);
+  EXPECT_EQ(LoadErr(WithRoot(bytes, bad_span)),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  // The root's children must be its rules, one per symbol.
+  auto not_rules = root;
+  ++not_rules.first_child;
+  EXPECT_EQ(LoadErr(WithRoot(bytes, not_rules)),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  // Every node kind keeps the child count the parser gives it.
+  const auto nodes = tree.GetNodes();
+  for (size_t i = 1; i < nodes.size(); ++i) {
+    if (nodes[i].kind == kero::peg::ast::NodeKind::kRule ||
+        nodes[i].kind == kero::peg::ast::NodeKind::kZeroOrMore) {
+      auto missing_child = nodes[i];
+      --missing_child.child_count;
+      EXPECT_EQ(LoadErr(WithNode(bytes, i, missing_child)),
+                kero::peg::GrammarImageErrorCode::kMalformed);
+    }
+  }
+
+  // Each rule index has to point at the rule defining its symbol.
+  const auto rule_indices =
+      (sizeof(kero::peg::GrammarImageHeader) +
+       sizeof(kero::peg::ast::FlatNode) * nodes.size() + 7) /
+      8 * 8;
+  EXPECT_EQ(LoadErr(Patched(bytes, rule_indices, uint32_t{1})),
+            kero::peg::GrammarImageErrorCode::kMalformed);
+
+  auto words = std::vector<uint64_t>(bytes.size() / 8);
+  const auto resealed = WithRoot(bytes, root);
+  std::memcpy(words.data(), resealed.data(), resealed.size());
+  EXPECT_TRUE(kero::peg::GrammarImage::Load(
+                  std::span{reinterpret_cast<const std::byte*>(words.data()),
+                            resealed.size()})
+                  .IsOk());
+}
@@ -1,9 +1,14 @@
 #include "./lexer.h"
 
-#include <cctype>
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
 #include <ostream>
 
 #include "./core.h"
+#include "./scan.h"
+#include "./static_lexer.h"
 
 namespace kero {
 namespace peg {
@@ -67,10 +72,6 @@ auto operator<<(std::ostream& os, const TokenKind kind) noexcept
   return os;
 }
 
-Location::Location(const size_t position, const size_t line,
-                   const size_t column) noexcept
-    : position{position}, line{line}, column{column} {}
-
 auto operator<<(std::ostream& os, const Location& location) noexcept
     -> std::ostream& {
   os << "Location{";
@@ -83,6 +84,40 @@ auto operator<<(std::ostream& os, const Location& location) noexcept
   return os;
 }
 
+LineIndex::LineIndex(const std::string_view source) noexcept
+    : source_{source} {
+  line_starts_.push_back(0);
+  size_t position{};
+  while (true) {
+    const auto found = FindByte(source.substr(position), '\n');
+    if (found == std::string_view::npos) {
+      break;
+    }
+
+    position += found + 1;
+    line_starts_.push_back(position);
+  }
+}
+
+auto LineIndex::GetLocation(const size_t position) const noexcept
+    -> Location {
+  assert(position <= source_.size());
+  const auto next_line =
+      std::upper_bound(line_starts_.begin(), line_starts_.end(), position);
+  const auto line_start = *std::prev(next_line);
+  const auto line = static_cast<size_t>(next_line - line_starts_.begin());
+
+  // '\r' does not advance the column.
+  size_t column{1};
+  for (size_t i = line_start; i < position; ++i) {
+    if (source_[i] != '\r') {
+      ++column;
+    }
+  }
+
+  return Location{position, line, column};
+}
+
 auto operator<<(std::ostream& os, const Token& token) noexcept
     -> std::ostream& {
   os << "Token{";
@@ -146,15 +181,14 @@ auto operator<<(std::ostream& os, const TokenizeErrorCode error) noexcept
   case TokenizeErrorCode::kBracketedTerminalMinusSignRightUppercaseLessThanLeft:
     os << "BracketedTerminalMinusSignRightUppercaseLessThanLeft";
     break;
+  case TokenizeErrorCode::kSourceTooLarge:
+    os << "SourceTooLarge";
+    break;
   }
 
   return os;
 }
 
-TokenizeError::TokenizeError(const TokenizeErrorCode code,
-                             const Location location) noexcept
-    : code{code}, location{location} {}
-
 auto operator<<(std::ostream& os, const TokenizeError& error) noexcept
     -> std::ostream& {
   os << "TokenizeError{";
@@ -165,8 +199,11 @@ auto operator<<(std::ostream& os, const TokenizeError& error) noexcept
   return os;
 }
 
-LexerContext::LexerContext(const std::string_view source) noexcept
-    : source_{source} {}
+LexerContext::LexerContext(const std::string_view source,
+                           const size_t position) noexcept
+    : source_{source}, position_{position} {
+  assert(position <= source.size());
+}
 
 auto LexerContext::Peek() const noexcept -> std::optional<char> {
   if (position_ >= source_.size()) {
@@ -182,12 +219,13 @@ auto LexerContext::GetSource() const noexcept -> std::string_view {
 
 auto LexerContext::GetPosition() const noexcept -> size_t { return position_; }
 
-auto LexerContext::GetLine() const noexcept -> size_t { return line_; }
-
-auto LexerContext::GetColumn() const noexcept -> size_t { return column_; }
+auto LexerContext::GetLocation(const size_t position) const noexcept
+    -> Location {
+  if (!line_index_) {
+    line_index_.emplace(source_);
+  }
 
-auto LexerContext::GetLocation() const noexcept -> Location {
-  return Location{position_, line_, column_};
+  return line_index_->GetLocation(position);
 }
 
 auto LexerContext::Match(const std::string_view expected) const noexcept
@@ -210,288 +248,203 @@ auto LexerContext::Consume(const size_t size) noexcept -> bool {
     return false;
   }
 
-  for (size_t i = 0; i < size; ++i) {
-    const auto current = source_[position_ + i];
-    if (current == '\r') {
-      continue;
-    }
+  position_ += size;
+  return true;
+}
+
+auto FirstBytesOf(const std::string_view bytes) noexcept -> FirstBytes {
+  FirstBytes first_bytes;
+  for (const auto byte : bytes) {
+    first_bytes.set(static_cast<unsigned char>(byte));
+  }
+  return first_bytes;
+}
 
-    if (current == '\n') {
-      ++line_;
-      column_ = 1;
-    } else {
-      ++column_;
+auto FirstBytesIf(int (*predicate)(int)) noexcept -> FirstBytes {
+  FirstBytes first_bytes;
+  for (size_t i{}; i < first_bytes.size(); ++i) {
+    if (predicate(static_cast<int>(i))) {
+      first_bytes.set(i);
     }
   }
+  return first_bytes;
+}
 
-  position_ += size;
-  return true;
+TokenBuffer::TokenBuffer(const std::string_view source) noexcept
+    : source_{source} {}
+
+auto TokenBuffer::Push(const TokenKind kind, const size_t start,
+                       const size_t length) noexcept -> void {
+  assert(start + length <= source_.size());
+  assert(source_.size() <= std::numeric_limits<uint32_t>::max());
+  kinds_.push_back(static_cast<uint8_t>(kind));
+  starts_.push_back(static_cast<uint32_t>(start));
+  lengths_.push_back(static_cast<uint32_t>(length));
+}
+
+auto TokenBuffer::Append(const TokenBuffer& other) noexcept -> void {
+  assert(source_.data() == other.source_.data());
+  kinds_.insert(kinds_.end(), other.kinds_.begin(), other.kinds_.end());
+  starts_.insert(starts_.end(), other.starts_.begin(), other.starts_.end());
+  lengths_.insert(lengths_.end(), other.lengths_.begin(), other.lengths_.end());
+}
+
+auto TokenBuffer::Size() const noexcept -> size_t { return kinds_.size(); }
+
+auto TokenBuffer::GetKind(const size_t index) const noexcept -> TokenKind {
+  return static_cast<TokenKind>(kinds_[index]);
+}
+
+auto TokenBuffer::GetStart(const size_t index) const noexcept -> uint32_t {
+  return starts_[index];
+}
+
+auto TokenBuffer::GetLength(const size_t index) const noexcept -> uint32_t {
+  return lengths_[index];
+}
+
+auto TokenBuffer::GetOriginal(const size_t index) const noexcept
+    -> std::string_view {
+  return source_.substr(starts_[index], lengths_[index]);
+}
+
+auto TokenBuffer::GetValue(const size_t index) const noexcept
+    -> std::string_view {
+  const auto original = GetOriginal(index);
+  switch (GetKind(index)) {
+  case TokenKind::kQuotedTerminal:
+  case TokenKind::kBracketedTerminal:
+    return original.substr(1, original.size() - 2);
+  default:
+    return original;
+  }
+}
+
+auto TokenBuffer::GetToken(const size_t index) const noexcept -> Token {
+  return Token{starts_[index], starts_[index] + lengths_[index],
+               GetOriginal(index), GetValue(index), GetKind(index)};
+}
+
+auto TokenBuffer::GetLocation(const size_t position) const noexcept
+    -> Location {
+  if (!line_index_) {
+    line_index_.emplace(source_);
+  }
+
+  return line_index_->GetLocation(position);
 }
 
-auto OnMatchSimple(std::vector<std::string_view>&& matches) -> OnMatch {
-  return [matches = std::move(matches)](
-             const LexerContext& ctx) -> std::optional<std::string_view> {
-    if (const auto ch = ctx.Peek()) {
-      for (const auto& match : matches) {
-        if (const auto value = ctx.Match(match)) {
-          return value;
-        }
+template <typename Matcher> auto MakeLexerMatcher() noexcept -> LexerMatcher {
+  auto lexer_matcher{LexerMatcher{
+      Matcher::kKind,
+      FirstBytesIf([](int ch) -> int {
+        return Matcher::IsFirst(static_cast<char>(ch));
+      }),
+      [](const LexerContext& ctx) -> std::optional<std::string_view> {
+        return Matcher::Match(ctx.GetSource(), ctx.GetPosition());
+      },
+  }};
+  if constexpr (matcher::HasParse<Matcher>) {
+    lexer_matcher.on_parse =
+        [](const LexerContext& ctx, const std::string_view original)
+        -> Result<std::string_view, TokenizeError> {
+      auto res = Matcher::Parse(ctx.GetSource(), original);
+      if (res.IsErr()) {
+        const auto error = *res.Err();
+        return TokenizeError{error.code, ctx.GetLocation(error.position)};
       }
-    }
 
-    return std::nullopt;
-  };
+      return *res.Ok();
+    };
+  }
+  lexer_matcher.skip = Matcher::kSkip;
+  return lexer_matcher;
 }
 
-auto OnMatchAround(std::vector<std::pair<char, char>>&& matches) -> OnMatch {
-  return [matches = std::move(matches)](
-             const LexerContext& ctx) -> std::optional<std::string_view> {
-    if (const auto ch = ctx.Peek()) {
-      for (const auto& [open, close] : matches) {
-        if (*ch == open) {
-          const auto source = ctx.GetSource();
-          for (size_t i = ctx.GetPosition() + 1; i < source.size(); ++i) {
-            const auto current = source[i];
-            if (current == close) {
-              return source.substr(ctx.GetPosition(),
-                                   i - ctx.GetPosition() + 1);
-            }
-          }
-
-          return std::nullopt;
-        }
+template <typename... Matchers>
+auto MakeLexerMatchers(matcher::List<Matchers...>) noexcept
+    -> std::vector<LexerMatcher> {
+  return {MakeLexerMatcher<Matchers>()...};
+}
+
+LexerMatcherSet::LexerMatcherSet() noexcept {
+  matchers_ = MakeLexerMatchers(matcher::Default{});
+
+  const auto add = [](LexerCandidates& candidates, const size_t matcher_i) {
+    assert(candidates.size < kLexerMaxCandidates);
+    candidates.matchers[candidates.size++] = static_cast<uint8_t>(matcher_i);
+  };
+
+  for (size_t i{}; i < matchers_.size(); ++i) {
+    const auto& first_bytes = matchers_[i].first_bytes;
+    if (first_bytes.none()) {
+      add(end_of_input_, i);
+      continue;
+    }
+
+    for (size_t byte{}; byte < dispatch_.size(); ++byte) {
+      if (first_bytes.test(byte)) {
+        add(dispatch_[byte], i);
       }
     }
+  }
+}
 
-    return std::nullopt;
-  };
+auto LexerMatcherSet::Get() noexcept -> const LexerMatcherSet& {
+  static const LexerMatcherSet instance{};
+  return instance;
 }
 
-Lexer::Lexer(const std::string_view source) noexcept : context_{source} {
-  matchers_ = {
-      LexerMatcher{
-          TokenKind::kEndOfInput,
-          [](const LexerContext& ctx) -> std::optional<std::string_view> {
-            if (const auto ch = ctx.Peek()) {
-              return std::nullopt;
-            }
-
-            return "";
-          }},
-      LexerMatcher{TokenKind::kWhitespace, OnMatchSimple({" ", "\t"}),
-                   std::nullopt, true},
-      LexerMatcher{TokenKind::kNewLine, OnMatchSimple({"\n", "\r\n"}),
-                   std::nullopt},
-      LexerMatcher{
-          TokenKind::kLeftArrow,
-          OnMatchSimple({"<-"}),
-      },
-      LexerMatcher{
-          TokenKind::kLeftParenthesis,
-          OnMatchSimple({"("}),
-      },
-      LexerMatcher{
-          TokenKind::kRightParenthesis,
-          OnMatchSimple({")"}),
-      },
-      LexerMatcher{
-          TokenKind::kAsterisk,
-          OnMatchSimple({"*"}),
-      },
-      LexerMatcher{
-          TokenKind::kPlus,
-          OnMatchSimple({"+"}),
-      },
-      LexerMatcher{
-          TokenKind::kQuestionMark,
-          OnMatchSimple({"?"}),
-      },
-      LexerMatcher{
-          TokenKind::kAmpersand,
-          OnMatchSimple({"&"}),
-      },
-      LexerMatcher{
-          TokenKind::kExclamationMark,
-          OnMatchSimple({"!"}),
-      },
-      LexerMatcher{
-          TokenKind::kSlash,
-          OnMatchSimple({"/"}),
-      },
-      LexerMatcher{
-          TokenKind::kDot,
-          OnMatchSimple({"."}),
-      },
-      LexerMatcher{
-          TokenKind::kCaret,
-          OnMatchSimple({"^"}),
-      },
-      LexerMatcher{TokenKind::kQuotedTerminal,
-                   OnMatchAround({{'\'', '\''}, {'"', '"'}}),
-                   [](const LexerContext& ctx, const std::string_view original)
-                       -> Result<std::string_view, TokenizeError> {
-                     return original.substr(1, original.size() - 2);
-                   }},
-      LexerMatcher{
-          TokenKind::kBracketedTerminal, OnMatchAround({{'[', ']'}}),
-          [](const LexerContext& ctx, const std::string_view original)
-              -> Result<std::string_view, TokenizeError> {
-            std::optional<char> left{};
-            std::optional<char> right{};
-            auto value{original.substr(1, original.size() - 2)};
-            auto location = ctx.GetLocation();
-            location.position += 1;
-            location.column += 1;
-
-            if (value.empty()) {
-              return TokenizeError{TokenizeErrorCode::kBracketedTerminalEmpty,
-                                   location};
-            }
-
-            for (size_t i = 0; i < value.size(); ++i) {
-              auto error = [&location, i](const TokenizeErrorCode code)
-                  -> Result<std::string_view, TokenizeError> {
-                location.position += i;
-                location.column += i;
-                return TokenizeError{code, location};
-              };
-
-              const auto current = value[i];
-              if (i > 0) {
-                left = value[i - 1];
-              } else {
-                left = std::nullopt;
-              }
-
-              if (i < value.size() - 1) {
-                right = value[i + 1];
-              } else {
-                right = std::nullopt;
-              }
-
-              if (current == '-') {
-                if (!left) {
-                  return error(TokenizeErrorCode::
-                                   kBracketedTerminalMinusSignLeftNotFound);
-                }
-
-                if (!right) {
-                  return error(TokenizeErrorCode::
-                                   kBracketedTerminalMinusSignRightNotFound);
-                }
-
-                if (std::isdigit(*left)) {
-                  if (!std::isdigit(*right)) {
-                    return error(TokenizeErrorCode::
-                                     kBracketedTerminalMinusSignRightNotNumber);
-                  }
-
-                  if (*left == *right) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightNumberEqualWithLeft);
-                  }
-
-                  if (*left > *right) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightNumberLessThanLeft);
-                  }
-                } else if (std::islower(*left)) {
-                  if (!std::islower(*right)) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightNotLowercase);
-                  }
-
-                  if (*left == *right) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightLowercaseEqualWithLeft);
-                  }
-
-                  if (*left > *right) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightLowercaseLessThanLeft);
-                  }
-                } else if (std::isupper(*left)) {
-                  if (!std::isupper(*right)) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightNotUppercase);
-                  }
-
-                  if (*left == *right) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightUppercaseEqualWithLeft);
-                  }
-
-                  if (*left > *right) {
-                    return error(
-                        TokenizeErrorCode::
-                            kBracketedTerminalMinusSignRightUppercaseLessThanLeft);
-                  }
-                }
-              }
-            }
-
-            return value;
-          }},
-      LexerMatcher{
-          TokenKind::kNonTerminal,
-          [](const LexerContext& ctx) -> std::optional<std::string_view> {
-            if (const auto ch = ctx.Peek()) {
-              if (std::isalpha(*ch)) {
-                const auto source = ctx.GetSource();
-                for (size_t i = ctx.GetPosition(); i < source.size(); ++i) {
-                  const auto current = source[i];
-                  if (!std::isalnum(current) && current != '_') {
-                    return source.substr(ctx.GetPosition(),
-                                         i - ctx.GetPosition());
-                  }
-                }
-
-                return source.substr(ctx.GetPosition());
-              }
-            }
-
-            return std::nullopt;
-          }},
-
-      // NOTE: This is a comment for line alignment when using the
-      // formatter.
-  }; // matchers_
-};
+auto LexerMatcherSet::GetMatcher(const size_t index) const noexcept
+    -> const LexerMatcher& {
+  return matchers_[index];
+}
+
+auto LexerMatcherSet::GetCandidates(const std::optional<char> ch) const noexcept
+    -> const LexerCandidates& {
+  if (!ch) {
+    return end_of_input_;
+  }
+
+  return dispatch_[static_cast<unsigned char>(*ch)];
+}
+
+Lexer::Lexer(const std::string_view source) noexcept
+    : context_{source}, matchers_{&LexerMatcherSet::Get()} {}
+
+Lexer::Lexer(const std::string_view source, const size_t position) noexcept
+    : context_{source, position}, matchers_{&LexerMatcherSet::Get()} {}
 
 auto Lexer::Next() noexcept -> Result<Token, TokenizeError> {
   while (true) {
+    const auto& candidates = matchers_->GetCandidates(context_.Peek());
+
     std::optional<size_t> matcher_i = std::nullopt;
     std::optional<std::string_view> matched = std::nullopt;
-    for (size_t i{}; i < matchers_.size(); ++i) {
-      const auto& matcher = matchers_[i];
+    for (size_t i{}; i < candidates.size; ++i) {
+      const auto& matcher = matchers_->GetMatcher(candidates.matchers[i]);
       if (const auto value = matcher.on_match(context_)) {
         matched = value;
-        matcher_i = i;
+        matcher_i = candidates.matchers[i];
         break;
       }
     }
 
-    const auto original_start = context_.GetLocation();
+    const auto original_start = context_.GetPosition();
     if (!matched) {
-      return TokenizeError{TokenizeErrorCode::kMatchFailed, original_start};
+      return TokenizeError{TokenizeErrorCode::kMatchFailed,
+                           context_.GetLocation(original_start)};
     }
 
     context_.Consume(matched->size());
-    const auto original_end = context_.GetLocation();
+    const auto original_end = context_.GetPosition();
 
     if (!matcher_i) {
       return TokenizeError{TokenizeErrorCode::kInternalMatcherNotFound,
-                           original_start};
+                           context_.GetLocation(original_start)};
     }
 
-    const auto& matcher = matchers_[*matcher_i];
+    const auto& matcher = matchers_->GetMatcher(*matcher_i);
     if (matcher.skip) {
       continue;
     }
@@ -513,5 +466,39 @@ auto Lexer::Next() noexcept -> Result<Token, TokenizeError> {
   }
 }
 
+auto Lexer::TokenizeAll() noexcept -> Result<TokenBuffer, TokenizeError> {
+  const auto source = context_.GetSource();
+  if (source.size() > std::numeric_limits<uint32_t>::max()) {
+    return TokenizeError{TokenizeErrorCode::kSourceTooLarge,
+                         Location{0, 1, 1}};
+  }
+
+  auto buffer{TokenBuffer{source}};
+  while (true) {
+    auto res = Next();
+    if (res.IsErr()) {
+      return *res.Err();
+    }
+
+    const auto token = *res.Ok();
+    buffer.Push(token.kind, token.original_start, token.original.size());
+    if (token.kind == TokenKind::kEndOfInput) {
+      return buffer;
+    }
+  }
+}
+
+auto Lexer::GetSource() const noexcept -> std::string_view {
+  return context_.GetSource();
+}
+
+auto Lexer::GetPosition() const noexcept -> size_t {
+  return context_.GetPosition();
+}
+
+auto Lexer::GetLocation(const size_t position) const noexcept -> Location {
+  return context_.GetLocation(position);
+}
+
 } // namespace peg
 } // namespace kero
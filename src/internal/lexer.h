@@ -1,9 +1,13 @@
 #ifndef KERO_PEG_INTERNAL_GRAMMAR_LEXER_H
 #define KERO_PEG_INTERNAL_GRAMMAR_LEXER_H
 
+#include <array>
+#include <bitset>
+#include <cstdint>
 #include <functional>
 #include <optional>
 #include <string_view>
+#include <vector>
 
 #include "./core.h"
 
@@ -38,16 +42,30 @@ struct Location {
   size_t line;
   size_t column;
 
-  Location(const size_t position, const size_t line,
-           const size_t column) noexcept;
+  constexpr Location(const size_t position, const size_t line,
+                     const size_t column) noexcept
+      : position{position}, line{line}, column{column} {}
 };
 
 auto operator<<(std::ostream& os, const Location& location) noexcept
     -> std::ostream&;
 
+// Maps byte positions to line and column on demand, so the lexer only has to
+// track positions while tokenizing.
+class LineIndex {
+public:
+  LineIndex(const std::string_view source) noexcept;
+
+  auto GetLocation(const size_t position) const noexcept -> Location;
+
+private:
+  std::string_view source_;
+  std::vector<size_t> line_starts_;
+};
+
 struct Token {
-  Location original_start;
-  Location original_end;
+  size_t original_start; // byte position, see Lexer::GetLocation
+  size_t original_end;
   std::string_view original;
   std::string_view value;
   TokenKind kind;
@@ -57,14 +75,13 @@ auto operator<<(std::ostream& os, const Token& token) noexcept -> std::ostream&;
 
 class LexerContext {
 public:
-  LexerContext(const std::string_view source) noexcept;
+  LexerContext(const std::string_view source,
+               const size_t position = 0) noexcept;
 
   auto Peek() const noexcept -> std::optional<char>;
   auto GetSource() const noexcept -> std::string_view;
   auto GetPosition() const noexcept -> size_t;
-  auto GetLine() const noexcept -> size_t;
-  auto GetColumn() const noexcept -> size_t;
-  auto GetLocation() const noexcept -> Location;
+  auto GetLocation(const size_t position) const noexcept -> Location;
   auto Match(const std::string_view expected) const noexcept
       -> std::optional<std::string_view>;
   auto Consume(const size_t size) noexcept -> bool;
@@ -72,8 +89,7 @@ public:
 private:
   std::string_view source_;
   size_t position_{};
-  size_t line_{1};
-  size_t column_{1};
+  mutable std::optional<LineIndex> line_index_; // built on first use
 };
 
 enum class TokenizeErrorCode : int32_t {
@@ -91,6 +107,7 @@ enum class TokenizeErrorCode : int32_t {
   kBracketedTerminalMinusSignRightNotUppercase,
   kBracketedTerminalMinusSignRightUppercaseEqualWithLeft,
   kBracketedTerminalMinusSignRightUppercaseLessThanLeft,
+  kSourceTooLarge,
 };
 
 auto operator<<(std::ostream& os, const TokenizeErrorCode error) noexcept
@@ -100,7 +117,9 @@ struct TokenizeError {
   TokenizeErrorCode code;
   Location location;
 
-  TokenizeError(const TokenizeErrorCode code, const Location location) noexcept;
+  constexpr TokenizeError(const TokenizeErrorCode code,
+                          const Location location) noexcept
+      : code{code}, location{location} {}
 };
 
 auto operator<<(std::ostream& os, const TokenizeError& error) noexcept
@@ -111,16 +130,90 @@ using OnMatch =
 using OnParse = std::function<Result<std::string_view, TokenizeError>(
     const LexerContext&, const std::string_view)>;
 
+using FirstBytes = std::bitset<256>;
+
+auto FirstBytesOf(const std::string_view bytes) noexcept -> FirstBytes;
+auto FirstBytesIf(int (*predicate)(int)) noexcept -> FirstBytes;
+
 struct LexerMatcher {
   TokenKind kind;
+  FirstBytes first_bytes; // empty if it only matches at the end of input
   OnMatch on_match;
   std::optional<OnParse> on_parse{std::nullopt};
   bool skip{false};
 };
 
+constexpr size_t kLexerMaxCandidates = 2;
+
+// Indices into the matcher set that may match at a given first byte, in
+// matcher order.
+struct LexerCandidates {
+  std::array<uint8_t, kLexerMaxCandidates> matchers{};
+  uint8_t size{};
+};
+
+// Process-wide immutable set of matchers shared by every Lexer, so a Lexer
+// only references it and is constructed without allocating.
+class LexerMatcherSet {
+public:
+  static auto Get() noexcept -> const LexerMatcherSet&;
+
+  LexerMatcherSet(const LexerMatcherSet&) = delete;
+  auto operator=(const LexerMatcherSet&) -> LexerMatcherSet& = delete;
+
+  auto GetMatcher(const size_t index) const noexcept -> const LexerMatcher&;
+  auto GetCandidates(const std::optional<char> ch) const noexcept
+      -> const LexerCandidates&;
+
+private:
+  LexerMatcherSet() noexcept;
+
+  std::vector<LexerMatcher> matchers_;
+  std::array<LexerCandidates, 256> dispatch_;
+  LexerCandidates end_of_input_;
+};
+
+// Columnar storage for a whole token stream: one byte of kind plus 32-bit
+// start and length per token. `original`, `value` and `Location` are rebuilt
+// on demand from the source.
+class TokenBuffer {
+public:
+  TokenBuffer(const std::string_view source) noexcept;
+  TokenBuffer(TokenBuffer&&) noexcept = default;
+  ~TokenBuffer() = default;
+  auto operator=(TokenBuffer&&) noexcept -> TokenBuffer& = default;
+
+  TokenBuffer(const TokenBuffer&) = delete;
+  auto operator=(const TokenBuffer&) -> TokenBuffer& = delete;
+
+  auto Push(const TokenKind kind, const size_t start,
+            const size_t length) noexcept -> void;
+  auto Append(const TokenBuffer& other) noexcept -> void;
+
+  auto Size() const noexcept -> size_t;
+  auto GetKind(const size_t index) const noexcept -> TokenKind;
+  auto GetStart(const size_t index) const noexcept -> uint32_t;
+  auto GetLength(const size_t index) const noexcept -> uint32_t;
+  auto GetOriginal(const size_t index) const noexcept -> std::string_view;
+  auto GetValue(const size_t index) const noexcept -> std::string_view;
+  auto GetToken(const size_t index) const noexcept -> Token;
+  auto GetLocation(const size_t position) const noexcept -> Location;
+
+private:
+  std::string_view source_;
+  std::vector<uint8_t> kinds_;
+  std::vector<uint32_t> starts_;
+  std::vector<uint32_t> lengths_;
+  mutable std::optional<LineIndex> line_index_; // built on first use
+};
+
 class Lexer {
 public:
   Lexer(const std::string_view source) noexcept;
+
+  // Starts tokenizing at `position`. Tokens keep positions relative to the
+  // whole `source`.
+  Lexer(const std::string_view source, const size_t position) noexcept;
   Lexer(Lexer&&) noexcept = default;
   ~Lexer() = default;
   auto operator=(Lexer&&) noexcept -> Lexer& = default;
@@ -130,9 +223,16 @@ public:
 
   auto Next() noexcept -> Result<Token, TokenizeError>;
 
+  // Tokenizes the rest of the source, up to and including EndOfInput.
+  auto TokenizeAll() noexcept -> Result<TokenBuffer, TokenizeError>;
+
+  auto GetSource() const noexcept -> std::string_view;
+  auto GetPosition() const noexcept -> size_t;
+  auto GetLocation(const size_t position) const noexcept -> Location;
+
 private:
   LexerContext context_;
-  std::vector<LexerMatcher> matchers_;
+  const LexerMatcherSet* matchers_;
 };
 
 } // namespace peg
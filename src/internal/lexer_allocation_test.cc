@@ -0,0 +1,15 @@
+#include "./lexer.h"
+
+#include <utility>
+
+#include "./testing/allocation_counter.h"
+#include "gtest/gtest.h"
+
+TEST(LexerAllocationTest, ConstructWithoutAllocation) {
+  // The first Lexer initializes the shared matcher set.
+  auto first{kero::peg::Lexer{"A <- B"}};
+  const auto counter = kero::peg::AllocationCounter{};
+  auto second{kero::peg::Lexer{"A <- B"}};
+  auto moved{std::move(second)};
+  EXPECT_EQ(counter.GetCount(), 0);
+}
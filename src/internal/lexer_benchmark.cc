@@ -0,0 +1,137 @@
+#include "./lexer.h"
+
+#include <string>
+
+#include "./parallel_lexer.h"
+#include "./static_lexer.h"
+
+#include "benchmark/benchmark.h"
+
+auto MakeRuleSet(const size_t rule_count) noexcept -> std::string {
+  std::string source;
+  for (size_t i{}; i < rule_count; ++i) {
+    const auto name = "Rule" + std::to_string(i);
+    const auto next = "Rule" + std::to_string(i + 1);
+    source += name + " <- " + next + " ('kw" + std::to_string(i) +
+              "' / \"op\" / [a-zA-Z0-9_]+) (Space / Tab)* !Eof .?\n";
+  }
+  return source;
+}
+
+static auto BM_LexerNext(benchmark::State& state) -> void {
+  const auto source = MakeRuleSet(static_cast<size_t>(state.range(0)));
+  size_t tokens{};
+  for (auto _ : state) {
+    auto lexer{kero::peg::Lexer{source}};
+    while (true) {
+      auto res = lexer.Next();
+      if (res.IsErr()) {
+        state.SkipWithError("tokenize failed");
+        break;
+      }
+      ++tokens;
+      if (res.Ok()->kind == kero::peg::TokenKind::kEndOfInput) {
+        break;
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+  state.counters["tokens"] = benchmark::Counter(
+      static_cast<double>(tokens), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_LexerNext)->Arg(100)->Arg(10000);
+
+static auto BM_StaticLexerNext(benchmark::State& state) -> void {
+  const auto source = MakeRuleSet(static_cast<size_t>(state.range(0)));
+  size_t tokens{};
+  for (auto _ : state) {
+    auto lexer{kero::peg::DefaultStaticLexer{source}};
+    while (true) {
+      auto res = lexer.Next();
+      if (res.IsErr()) {
+        state.SkipWithError("tokenize failed");
+        break;
+      }
+      ++tokens;
+      if (res.Ok()->kind == kero::peg::TokenKind::kEndOfInput) {
+        break;
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+  state.counters["tokens"] = benchmark::Counter(
+      static_cast<double>(tokens), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_StaticLexerNext)->Arg(100)->Arg(10000);
+
+auto MakeLiteralRuleSet(const size_t rule_count,
+                        const size_t literal_size) noexcept -> std::string {
+  std::string source;
+  for (size_t i{}; i < rule_count; ++i) {
+    const auto text = std::string(literal_size, 'a' + (i % 26));
+    source += "Rule" + std::to_string(i) + " <- '" + text + "' / \"" + text +
+              "\" / [" + text + "]\n";
+  }
+  return source;
+}
+
+static auto BM_LexerNextLiterals(benchmark::State& state) -> void {
+  const auto source =
+      MakeLiteralRuleSet(1000, static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto lexer{kero::peg::Lexer{source}};
+    while (true) {
+      auto res = lexer.Next();
+      if (res.IsErr()) {
+        state.SkipWithError("tokenize failed");
+        break;
+      }
+      if (res.Ok()->kind == kero::peg::TokenKind::kEndOfInput) {
+        break;
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_LexerNextLiterals)->Arg(16)->Arg(256);
+
+static auto BM_LexerTokenizeAll(benchmark::State& state) -> void {
+  const auto source = MakeRuleSet(static_cast<size_t>(state.range(0)));
+  size_t tokens{};
+  for (auto _ : state) {
+    auto lexer{kero::peg::Lexer{source}};
+    auto res = lexer.TokenizeAll();
+    if (res.IsErr()) {
+      state.SkipWithError("tokenize failed");
+      break;
+    }
+    tokens = res.Ok()->Size();
+    benchmark::DoNotOptimize(tokens);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+  state.counters["token_bytes"] = static_cast<double>(
+      tokens * (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t)));
+  state.counters["token_bytes_as_tokens"] =
+      static_cast<double>(tokens * sizeof(kero::peg::Token));
+}
+BENCHMARK(BM_LexerTokenizeAll)->Arg(10000);
+
+static auto BM_TokenizeParallel(benchmark::State& state) -> void {
+  const auto source = MakeRuleSet(100000);
+  const auto threads = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    auto res = kero::peg::TokenizeParallel(source, threads);
+    if (res.IsErr()) {
+      state.SkipWithError("tokenize failed");
+      break;
+    }
+    benchmark::DoNotOptimize(res.Ok()->Size());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_TokenizeParallel)->Arg(1)->Arg(4)->UseRealTime();
@@ -463,15 +463,13 @@ TEST(LocationTest, Print) {
 }
 
 TEST(TokenTest, Print) {
-  auto token{kero::peg::Token{kero::peg::Location{1, 2, 3},
-                              kero::peg::Location{4, 5, 6}, "original", "value",
+  auto token{kero::peg::Token{1, 4, "original", "value",
                               kero::peg::TokenKind::kNonTerminal}};
   std::ostringstream oss;
   oss << token;
   EXPECT_EQ(oss.str(),
             "Token{kind=NonTerminal, value=value, original=original, "
-            "original_start=Location{position=1, line=2, column=3}, "
-            "original_end=Location{position=4, line=5, column=6}}");
+            "original_start=1, original_end=4}");
 }
 
 TEST(TokenizeErrorTest, Print) {
@@ -676,3 +674,144 @@ TEST(LexerTest, Sample2) {
                       "NewLine \n\n"
                       "EndOfInput \n");
 }
+
+TEST(FirstBytesTest, Of) {
+  const auto first_bytes{kero::peg::FirstBytesOf("'\"")};
+  EXPECT_EQ(first_bytes.count(), 2);
+  EXPECT_TRUE(first_bytes.test('\''));
+  EXPECT_TRUE(first_bytes.test('"'));
+}
+
+TEST(FirstBytesTest, If) {
+  const auto first_bytes{
+      kero::peg::FirstBytesIf([](int ch) { return std::isdigit(ch); })};
+  EXPECT_EQ(first_bytes.count(), 10);
+  EXPECT_TRUE(first_bytes.test('0'));
+  EXPECT_TRUE(first_bytes.test('9'));
+  EXPECT_FALSE(first_bytes.test('a'));
+}
+
+TEST(LexerTest, NonAsciiMatchFailed) {
+  auto lexer{kero::peg::Lexer{"\xff"}};
+  NextErr(lexer, kero::peg::TokenizeErrorCode::kMatchFailed);
+}
+
+TEST(LexerMatcherSetTest, Shared) {
+  EXPECT_EQ(&kero::peg::LexerMatcherSet::Get(),
+            &kero::peg::LexerMatcherSet::Get());
+}
+
+TEST(LexerTest, TerminalLong) {
+  const auto text = std::string(100, 'a');
+  const auto source = "'" + text + "' \"" + text + "\" [" + text + "]";
+  auto lexer{kero::peg::Lexer{source}};
+  NextOk(lexer, kero::peg::TokenKind::kQuotedTerminal, text);
+  NextOk(lexer, kero::peg::TokenKind::kQuotedTerminal, text);
+  NextOk(lexer, kero::peg::TokenKind::kBracketedTerminal, text);
+  NextOk(lexer, kero::peg::TokenKind::kEndOfInput, "");
+}
+
+TEST(LexerTest, TerminalUnterminated) {
+  const auto source = "'" + std::string(100, 'a');
+  auto lexer{kero::peg::Lexer{source}};
+  NextErr(lexer, kero::peg::TokenizeErrorCode::kMatchFailed);
+}
+
+TEST(LineIndexTest, GetLocation) {
+  // Reference: walk every byte like the lexer used to.
+  const std::string_view source{"A <- B\r\n\nC <- 'd'\n\rE"};
+  const auto line_index{kero::peg::LineIndex{source}};
+  size_t line{1};
+  size_t column{1};
+  for (size_t position{}; position <= source.size(); ++position) {
+    const auto location = line_index.GetLocation(position);
+    EXPECT_EQ(location.position, position);
+    EXPECT_EQ(location.line, line);
+    EXPECT_EQ(location.column, column);
+    if (position == source.size() || source[position] == '\r') {
+      continue;
+    }
+    if (source[position] == '\n') {
+      ++line;
+      column = 1;
+    } else {
+      ++column;
+    }
+  }
+}
+
+TEST(LexerTest, GetLocation) {
+  auto lexer{kero::peg::Lexer{"A <- B\nC <- D"}};
+  NextOk(lexer, kero::peg::TokenKind::kNonTerminal, "A");
+  NextOk(lexer, kero::peg::TokenKind::kLeftArrow, "<-");
+  NextOk(lexer, kero::peg::TokenKind::kNonTerminal, "B");
+  NextOk(lexer, kero::peg::TokenKind::kNewLine, "\n");
+  auto token_res = lexer.Next();
+  ASSERT_TRUE(token_res.IsOk());
+  const auto token = *token_res.Ok();
+  EXPECT_EQ(token.value, "C");
+  EXPECT_EQ(token.original_start, 7);
+  EXPECT_EQ(token.original_end, 8);
+  const auto start = lexer.GetLocation(token.original_start);
+  EXPECT_EQ(start.line, 2);
+  EXPECT_EQ(start.column, 1);
+  const auto end = lexer.GetLocation(token.original_end);
+  EXPECT_EQ(end.line, 2);
+  EXPECT_EQ(end.column, 2);
+}
+
+TEST(LexerTest, ErrorLocation) {
+  auto lexer{kero::peg::Lexer{"A\n  [a-]"}};
+  NextOk(lexer, kero::peg::TokenKind::kNonTerminal, "A");
+  NextOk(lexer, kero::peg::TokenKind::kNewLine, "\n");
+  auto token_res = lexer.Next();
+  ASSERT_TRUE(token_res.IsErr());
+  const auto error = *token_res.Err();
+  EXPECT_EQ(error.code, kero::peg::TokenizeErrorCode::
+                            kBracketedTerminalMinusSignRightNotFound);
+  EXPECT_EQ(error.location.position, 6);
+  EXPECT_EQ(error.location.line, 2);
+  EXPECT_EQ(error.location.column, 5);
+}
+
+TEST(LexerTest, TokenizeAll) {
+  const std::string_view source{"Expr <- Sum\n"
+                                "Sum <- Product (('+' / '-') Product)*\n"
+                                "Value <- [0-9]+ / '(' Expr ')'"};
+  auto buffer_res = kero::peg::Lexer{source}.TokenizeAll();
+  ASSERT_TRUE(buffer_res.IsOk());
+  const auto buffer = std::move(*buffer_res.Ok());
+
+  auto lexer{kero::peg::Lexer{source}};
+  size_t i{};
+  while (true) {
+    auto token_res = lexer.Next();
+    ASSERT_TRUE(token_res.IsOk());
+    const auto expected = *token_res.Ok();
+    ASSERT_LT(i, buffer.Size());
+    const auto token = buffer.GetToken(i);
+    EXPECT_EQ(token.kind, expected.kind);
+    EXPECT_EQ(token.original_start, expected.original_start);
+    EXPECT_EQ(token.original_end, expected.original_end);
+    EXPECT_EQ(token.original, expected.original);
+    EXPECT_EQ(token.value, expected.value);
+    const auto location = buffer.GetLocation(token.original_start);
+    const auto expected_location = lexer.GetLocation(expected.original_start);
+    EXPECT_EQ(location.line, expected_location.line);
+    EXPECT_EQ(location.column, expected_location.column);
+    ++i;
+    if (expected.kind == kero::peg::TokenKind::kEndOfInput) {
+      break;
+    }
+  }
+  EXPECT_EQ(i, buffer.Size());
+}
+
+TEST(LexerTest, TokenizeAllErr) {
+  auto lexer{kero::peg::Lexer{"A <- [b-a]"}};
+  auto buffer_res = lexer.TokenizeAll();
+  ASSERT_TRUE(buffer_res.IsErr());
+  EXPECT_EQ(buffer_res.Err()->code,
+            kero::peg::TokenizeErrorCode::
+                kBracketedTerminalMinusSignRightLowercaseLessThanLeft);
+}
@@ -0,0 +1,635 @@
+#include "./optimizer.h"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+using NodeList = std::vector<ast::Node*>;
+
+template <typename T>
+concept UnaryNode =
+    std::is_same_v<T, ast::ZeroOrMore> || std::is_same_v<T, ast::OneOrMore> ||
+    std::is_same_v<T, ast::Optional> || std::is_same_v<T, ast::AndPredicate> ||
+    std::is_same_v<T, ast::NotPredicate>;
+
+// Calls `f` on `node` and every expression below it, not following calls.
+template <typename F>
+auto ForEachNode(const ast::Node& node, F& f) noexcept -> void {
+  f(node);
+  ast::Visit(node, [&f](const auto& concrete) noexcept {
+    using T = std::decay_t<decltype(concrete)>;
+    if constexpr (std::is_same_v<T, ast::Sequence>) {
+      for (const auto child : concrete.GetExpressions()) {
+        ForEachNode(*child, f);
+      }
+    } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+      for (const auto child : concrete.GetAlternatives()) {
+        ForEachNode(*child, f);
+      }
+    } else if constexpr (UnaryNode<T> || std::is_same_v<T, ast::Group>) {
+      ForEachNode(*concrete.GetExpression(), f);
+    }
+  });
+}
+
+auto CountNodes(const ast::Node& node) noexcept -> size_t {
+  size_t count{};
+  auto f = [&count](const ast::Node&) noexcept { ++count; };
+  ForEachNode(node, f);
+  return count;
+}
+
+auto IsSameExpression(const ast::Node& a, const ast::Node& b) noexcept
+    -> bool {
+  if (a.Kind() != b.Kind()) {
+    return false;
+  }
+
+  return ast::Visit(a, [&b](const auto& left) noexcept -> bool {
+    using T = std::decay_t<decltype(left)>;
+    const auto& right = static_cast<const T&>(b);
+    const auto same_lists = [](const auto lhs, const auto rhs) noexcept {
+      return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                        [](const ast::Node* x, const ast::Node* y) noexcept {
+                          return IsSameExpression(*x, *y);
+                        });
+    };
+    if constexpr (std::is_same_v<T, ast::Sequence>) {
+      return same_lists(left.GetExpressions(), right.GetExpressions());
+    } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+      return same_lists(left.GetAlternatives(), right.GetAlternatives());
+    } else if constexpr (UnaryNode<T> || std::is_same_v<T, ast::Group>) {
+      return IsSameExpression(*left.GetExpression(), *right.GetExpression());
+    } else if constexpr (std::is_same_v<T, ast::QuotedTerminal>) {
+      return left.GetValue() == right.GetValue();
+    } else if constexpr (std::is_same_v<T, ast::BracketedTerminal>) {
+      return left.GetCharClass() == right.GetCharClass();
+    } else if constexpr (std::is_same_v<T, ast::NonTerminal>) {
+      return left.GetSymbol() == right.GetSymbol();
+    } else if constexpr (std::is_same_v<T, ast::AnyCharacter> ||
+                         std::is_same_v<T, ast::Cut>) {
+      return true;
+    } else {
+      // RuleSet and Rule are not expressions.
+      return false;
+    }
+  });
+}
+
+auto IsEmptySequence(const ast::Node& node) noexcept -> bool {
+  const auto sequence = ast::As<ast::Sequence>(node);
+  return sequence && sequence->GetExpressions().empty();
+}
+
+// Allocates the nodes passes build.
+class NodeFactory {
+public:
+  explicit NodeFactory(Arena& arena) noexcept : arena_{arena} {}
+
+  // Empty Sequences match nothing, so they are dropped, and a single
+  // expression stands for itself.
+  auto MakeSequence(NodeList expressions) noexcept -> ast::Node* {
+    std::erase_if(expressions, [](const ast::Node* expression) noexcept {
+      return IsEmptySequence(*expression);
+    });
+    if (expressions.size() == 1) {
+      return expressions[0];
+    }
+    return arena_.New<ast::Sequence>(Copy(expressions));
+  }
+
+  // Alternatives after one that always succeeds are never tried, so they are
+  // dropped.
+  auto MakeChoice(NodeList alternatives) noexcept -> ast::Node* {
+    const auto always = std::find_if(
+        alternatives.begin(), alternatives.end(),
+        [](const ast::Node* alternative) noexcept {
+          return IsEmptySequence(*alternative);
+        });
+    if (always != alternatives.end()) {
+      alternatives.erase(always + 1, alternatives.end());
+    }
+    if (alternatives.size() == 1) {
+      return alternatives[0];
+    }
+    return arena_.New<ast::OrderedChoice>(Copy(alternatives));
+  }
+
+  // `value` must outlive the node, see CopyText.
+  auto MakeLiteral(const std::string_view value) noexcept -> ast::Node* {
+    auto terminal = arena_.New<ast::QuotedTerminal>();
+    terminal->SetValue(value);
+    return terminal;
+  }
+
+  // A BracketedTerminal with the bytes of `char_class`, whose value is
+  // spelled out as ranges.
+  auto MakeClass(const CharClass& char_class) noexcept -> ast::Node* {
+    std::vector<std::pair<unsigned, unsigned>> ranges;
+    for (unsigned byte{}; byte < 256; ++byte) {
+      if (!char_class.Contains(static_cast<char>(byte))) {
+        continue;
+      }
+      if (!ranges.empty() && ranges.back().second + 1 == byte) {
+        ranges.back().second = byte;
+      } else {
+        ranges.emplace_back(byte, byte);
+      }
+    }
+
+    std::string value;
+    for (size_t i{}; i < ranges.size(); ++i) {
+      const auto [first, last] = ranges[i];
+      value += static_cast<char>(first);
+      // A lone byte before a '-' would read as a range start.
+      if (first != last ||
+          (i + 1 < ranges.size() && ranges[i + 1].first == '-')) {
+        value += '-';
+        value += static_cast<char>(last);
+      }
+    }
+
+    auto terminal = arena_.New<ast::BracketedTerminal>();
+    terminal->SetValue(CopyText(value));
+    return terminal;
+  }
+
+  template <UnaryNode T>
+  auto MakeUnary(ast::Node* expression) noexcept -> ast::Node* {
+    auto node = arena_.New<T>();
+    node->SetExpression(expression);
+    return node;
+  }
+
+  auto MakeGroup(ast::Node* expression) noexcept -> ast::Node* {
+    return arena_.New<ast::Group>(expression);
+  }
+
+  auto CopyText(const std::string_view text) noexcept -> std::string_view {
+    const auto copy = arena_.Copy<char>(std::span<const char>{text});
+    return std::string_view{copy.data(), copy.size()};
+  }
+
+  auto Copy(const NodeList& nodes) noexcept -> std::span<ast::Node* const> {
+    return arena_.Copy<ast::Node*>(std::span<ast::Node* const>{nodes});
+  }
+
+private:
+  Arena& arena_;
+};
+
+// Rewrites `node` bottom-up: its children first, then `pass` on the node
+// rebuilt over them. Nodes whose children did not change are kept.
+template <typename Pass>
+auto Transform(ast::Node* node, NodeFactory& factory, Pass& pass) noexcept
+    -> ast::Node* {
+  const auto rebuilt = ast::Visit(
+      *node, [node, &factory, &pass](const auto& concrete) noexcept
+      -> ast::Node* {
+        using T = std::decay_t<decltype(concrete)>;
+        const auto map = [&factory, &pass](const auto children,
+                                           NodeList& mapped) noexcept {
+          auto changed = false;
+          for (const auto child : children) {
+            mapped.push_back(Transform(child, factory, pass));
+            changed = changed || mapped.back() != child;
+          }
+          return changed;
+        };
+
+        NodeList mapped;
+        if constexpr (std::is_same_v<T, ast::Sequence>) {
+          if (map(concrete.GetExpressions(), mapped)) {
+            return factory.MakeSequence(mapped);
+          }
+        } else if constexpr (std::is_same_v<T, ast::OrderedChoice>) {
+          if (map(concrete.GetAlternatives(), mapped)) {
+            return factory.MakeChoice(std::move(mapped));
+          }
+        } else if constexpr (UnaryNode<T>) {
+          const auto child =
+              Transform(concrete.GetExpression(), factory, pass);
+          if (child != concrete.GetExpression()) {
+            return factory.MakeUnary<T>(child);
+          }
+        } else if constexpr (std::is_same_v<T, ast::Group>) {
+          const auto child =
+              Transform(concrete.GetExpression(), factory, pass);
+          if (child != concrete.GetExpression()) {
+            return factory.MakeGroup(child);
+          }
+        }
+        return node;
+      });
+  return pass(rebuilt);
+}
+
+class InlineRules {
+public:
+  InlineRules(const ast::RuleSet& rule_set, NodeFactory& factory,
+              const size_t max_nodes) noexcept
+      : rule_set_{rule_set}, factory_{factory}, max_nodes_{max_nodes},
+        recursive_(rule_set.GetRules().size()),
+        bodies_(rule_set.GetRules().size()) {
+    const auto rules = rule_set.GetRules();
+    std::vector<std::vector<uint32_t>> calls(rules.size());
+    for (size_t i{}; i < rules.size(); ++i) {
+      auto add = [this, &calls, i](const ast::Node& node) noexcept {
+        if (const auto call = ast::As<ast::NonTerminal>(node)) {
+          calls[i].push_back(rule_set_.GetRuleIndex(call->GetSymbol()));
+        }
+      };
+      ForEachNode(*GetExpression(i), add);
+    }
+
+    // A rule is recursive if a search from its callees reaches it.
+    std::vector<bool> seen(rules.size());
+    std::vector<uint32_t> stack;
+    for (uint32_t root{}; root < rules.size(); ++root) {
+      std::fill(seen.begin(), seen.end(), false);
+      stack.assign(calls[root].begin(), calls[root].end());
+      while (!stack.empty() && !recursive_[root]) {
+        const auto rule = stack.back();
+        stack.pop_back();
+        recursive_[root] = rule == root;
+        if (!seen[rule]) {
+          seen[rule] = true;
+          stack.insert(stack.end(), calls[rule].begin(), calls[rule].end());
+        }
+      }
+    }
+  }
+
+  auto operator()(ast::Node* node) noexcept -> ast::Node* {
+    const auto call = ast::As<ast::NonTerminal>(*node);
+    if (!call) {
+      return node;
+    }
+
+    const auto body = GetInlinedBody(rule_set_.GetRuleIndex(call->GetSymbol()));
+    return body ? factory_.MakeGroup(body) : node;
+  }
+
+  // The expression of the rule at `rule_index` with its own calls inlined,
+  // or nullptr if it is not to be inlined.
+  auto GetInlinedBody(const uint32_t rule_index) noexcept -> ast::Node* {
+    auto& body = bodies_[rule_index];
+    if (!body) {
+      body = nullptr;
+      const auto expression = GetExpression(rule_index);
+      if (!recursive_[rule_index] &&
+          !ast::Contains(*expression, ast::NodeKind::kCut)) {
+        // Terminates as the callees cannot reach this rule.
+        const auto inlined = Transform(expression, factory_, *this);
+        if (CountNodes(*inlined) <= max_nodes_) {
+          body = inlined;
+        }
+      }
+    }
+    return *body;
+  }
+
+private:
+  auto GetExpression(const size_t rule_index) const noexcept -> ast::Node* {
+    return static_cast<const ast::Rule*>(rule_set_.GetRules()[rule_index])
+        ->GetExpression();
+  }
+
+  const ast::RuleSet& rule_set_;
+  NodeFactory& factory_;
+  size_t max_nodes_;
+  std::vector<bool> recursive_;
+  std::vector<std::optional<ast::Node*>> bodies_;
+};
+
+class RemoveGroups {
+public:
+  auto operator()(ast::Node* node) noexcept -> ast::Node* {
+    return ast::Visit(
+        *node, [this, node](const auto& concrete) noexcept -> ast::Node* {
+          using T = std::decay_t<decltype(concrete)>;
+          if constexpr (std::is_same_v<T, ast::Group>) {
+            return concrete.GetExpression();
+          } else if constexpr (std::is_same_v<T, ast::Sequence> ||
+                               std::is_same_v<T, ast::OrderedChoice>) {
+            return Splice(node, concrete);
+          } else {
+            return node;
+          }
+        });
+  }
+
+  NodeFactory& factory_;
+
+private:
+  auto Splice(ast::Node* node, const ast::Sequence& sequence) noexcept
+      -> ast::Node* {
+    const auto expressions = sequence.GetExpressions();
+    NodeList spliced;
+    for (const auto expression : expressions) {
+      if (const auto inner = ast::As<ast::Sequence>(*expression)) {
+        spliced.insert(spliced.end(), inner->GetExpressions().begin(),
+                       inner->GetExpressions().end());
+      } else {
+        spliced.push_back(expression);
+      }
+    }
+    return spliced.size() == expressions.size()
+               ? node
+               : factory_.MakeSequence(spliced);
+  }
+
+  // `(A ^ B / C) / D` would commit past D once spliced, unless nothing
+  // follows the inner choice.
+  auto Splice(ast::Node* node, const ast::OrderedChoice& choice) noexcept
+      -> ast::Node* {
+    const auto alternatives = choice.GetAlternatives();
+    NodeList spliced;
+    for (size_t i{}; i < alternatives.size(); ++i) {
+      const auto alternative = alternatives[i];
+      const auto inner = ast::As<ast::OrderedChoice>(*alternative);
+      if (inner && (i + 1 == alternatives.size() ||
+                    !ast::Contains(*alternative, ast::NodeKind::kCut))) {
+        spliced.insert(spliced.end(), inner->GetAlternatives().begin(),
+                       inner->GetAlternatives().end());
+      } else {
+        spliced.push_back(alternative);
+      }
+    }
+    return spliced.size() == alternatives.size()
+               ? node
+               : factory_.MakeChoice(std::move(spliced));
+  }
+};
+
+class MergeLiterals {
+public:
+  auto operator()(ast::Node* node) noexcept -> ast::Node* {
+    const auto sequence = ast::As<ast::Sequence>(*node);
+    if (!sequence) {
+      return node;
+    }
+
+    const auto expressions = sequence->GetExpressions();
+    NodeList merged;
+    size_t run_start{};
+    const auto flush = [this, &merged, &run_start]() noexcept {
+      if (merged.size() - run_start < 2) {
+        return;
+      }
+      std::string value;
+      for (auto i = run_start; i < merged.size(); ++i) {
+        value += ast::As<ast::QuotedTerminal>(*merged[i])->GetValue();
+      }
+      merged.resize(run_start);
+      merged.push_back(factory_.MakeLiteral(factory_.CopyText(value)));
+    };
+    for (const auto expression : expressions) {
+      if (!ast::As<ast::QuotedTerminal>(*expression)) {
+        flush();
+        merged.push_back(expression);
+        run_start = merged.size();
+        continue;
+      }
+      merged.push_back(expression);
+    }
+    flush();
+    return merged.size() == expressions.size()
+               ? node
+               : factory_.MakeSequence(merged);
+  }
+
+  NodeFactory& factory_;
+};
+
+class LeftFactor {
+public:
+  auto operator()(ast::Node* node) noexcept -> ast::Node* {
+    const auto choice = ast::As<ast::OrderedChoice>(*node);
+    if (!choice || ast::Contains(*node, ast::NodeKind::kCut)) {
+      return node;
+    }
+
+    const auto alternatives = choice->GetAlternatives();
+    NodeList factored;
+    for (size_t i{}; i < alternatives.size();) {
+      const auto head = GetHead(alternatives[i]);
+      auto prefix_size = head ? GetLiteralSize(*head) : 0;
+      auto end = i + 1;
+      for (; head && end < alternatives.size(); ++end) {
+        const auto other = GetHead(alternatives[end]);
+        if (!other) {
+          break;
+        }
+        if (prefix_size != kNotLiteral) {
+          const auto common = GetCommonPrefix(*head, *other, prefix_size);
+          if (common == 0) {
+            break;
+          }
+          prefix_size = common;
+        } else if (!IsSameExpression(*head, *other)) {
+          break;
+        }
+      }
+
+      if (end - i < 2) {
+        factored.push_back(alternatives[i]);
+        ++i;
+        continue;
+      }
+
+      NodeList remainders;
+      for (auto k = i; k < end; ++k) {
+        remainders.push_back(GetRemainder(alternatives[k], prefix_size));
+      }
+      const auto prefix =
+          prefix_size == kNotLiteral
+              ? head
+              : factory_.MakeLiteral(GetValue(*head).substr(0, prefix_size));
+      factored.push_back(factory_.MakeSequence(
+          {prefix, (*this)(factory_.MakeChoice(std::move(remainders)))}));
+      i = end;
+    }
+    return factored.size() == alternatives.size()
+               ? node
+               : factory_.MakeChoice(std::move(factored));
+  }
+
+  NodeFactory& factory_;
+
+private:
+  static constexpr size_t kNotLiteral = std::numeric_limits<size_t>::max();
+
+  // The first expression `alternative` matches, or nullptr if it matches
+  // nothing.
+  static auto GetHead(ast::Node* alternative) noexcept -> ast::Node* {
+    const auto sequence = ast::As<ast::Sequence>(*alternative);
+    if (!sequence) {
+      return alternative;
+    }
+    const auto expressions = sequence->GetExpressions();
+    return expressions.empty() ? nullptr : expressions[0];
+  }
+
+  static auto GetValue(const ast::Node& node) noexcept -> std::string_view {
+    return ast::As<ast::QuotedTerminal>(node)->GetValue();
+  }
+
+  static auto GetLiteralSize(const ast::Node& node) noexcept -> size_t {
+    const auto literal = ast::As<ast::QuotedTerminal>(node);
+    return literal ? literal->GetValue().size() : kNotLiteral;
+  }
+
+  static auto GetCommonPrefix(const ast::Node& head, const ast::Node& other,
+                              const size_t limit) noexcept -> size_t {
+    const auto literal = ast::As<ast::QuotedTerminal>(other);
+    if (!literal) {
+      return 0;
+    }
+    const auto a = GetValue(head).substr(0, limit);
+    const auto b = literal->GetValue();
+    const auto mismatch = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+    return static_cast<size_t>(mismatch.first - a.begin());
+  }
+
+  // `alternative` without its first `prefix_size` bytes, or without its head
+  // if that is not a literal.
+  auto GetRemainder(ast::Node* alternative, const size_t prefix_size) noexcept
+      -> ast::Node* {
+    NodeList rest;
+    if (const auto sequence = ast::As<ast::Sequence>(*alternative)) {
+      const auto expressions = sequence->GetExpressions();
+      rest.assign(expressions.begin() + 1, expressions.end());
+    }
+    const auto head = GetHead(alternative);
+    if (prefix_size != kNotLiteral && GetValue(*head).size() > prefix_size) {
+      rest.insert(rest.begin(),
+                  factory_.MakeLiteral(GetValue(*head).substr(prefix_size)));
+    }
+    return factory_.MakeSequence(rest);
+  }
+};
+
+class CharClassChoices {
+public:
+  auto operator()(ast::Node* node) noexcept -> ast::Node* {
+    const auto choice = ast::As<ast::OrderedChoice>(*node);
+    if (!choice) {
+      return node;
+    }
+
+    const auto alternatives = choice->GetAlternatives();
+    NodeList merged;
+    for (size_t i{}; i < alternatives.size();) {
+      auto end = i;
+      std::string members;
+      while (end < alternatives.size() &&
+             AddSingleByte(*alternatives[end], members)) {
+        ++end;
+      }
+      if (end - i < 2) {
+        merged.push_back(alternatives[i]);
+        i = std::max(end, i + 1);
+        continue;
+      }
+
+      // Every byte on its own, so no '-' reads as a range.
+      std::string value;
+      for (const auto byte : members) {
+        value += byte;
+        value += '-';
+        value += byte;
+      }
+      merged.push_back(factory_.MakeClass(CharClass::Compile(value)));
+      i = end;
+    }
+    return merged.size() == alternatives.size()
+               ? node
+               : factory_.MakeChoice(std::move(merged));
+  }
+
+  NodeFactory& factory_;
+
+private:
+  // Appends the bytes `node` matches if it matches exactly one byte.
+  static auto AddSingleByte(const ast::Node& node,
+                            std::string& members) noexcept -> bool {
+    return ast::Visit(node, [&members](const auto& concrete) noexcept {
+      using T = std::decay_t<decltype(concrete)>;
+      if constexpr (std::is_same_v<T, ast::QuotedTerminal>) {
+        if (concrete.GetValue().size() != 1) {
+          return false;
+        }
+        members += concrete.GetValue();
+        return true;
+      } else if constexpr (std::is_same_v<T, ast::BracketedTerminal>) {
+        for (unsigned byte{}; byte < 256; ++byte) {
+          if (concrete.GetCharClass().Contains(static_cast<char>(byte))) {
+            members += static_cast<char>(byte);
+          }
+        }
+        return true;
+      } else {
+        return false;
+      }
+    });
+  }
+};
+
+} // namespace
+
+auto OptimizeRuleSet(const ast::RuleSet& rule_set, Arena& arena,
+                     const OptimizerOptions& options) noexcept
+    -> const ast::RuleSet* {
+  NodeFactory factory{arena};
+  const auto rules = rule_set.GetRules();
+  NodeList optimized(rules.begin(), rules.end());
+  const auto run = [&arena, &factory, &optimized](auto&& pass) noexcept {
+    for (auto& node : optimized) {
+      const auto rule = static_cast<const ast::Rule*>(node);
+      const auto expression = Transform(rule->GetExpression(), factory, pass);
+      if (expression != rule->GetExpression()) {
+        node = arena.New<ast::Rule>(rule->GetNonTerminal(), expression);
+      }
+    }
+  };
+
+  const auto run_local_passes = [&options, &factory, &run]() noexcept {
+    if (options.remove_groups) {
+      run(RemoveGroups{factory});
+    }
+    if (options.merge_literals) {
+      run(MergeLiterals{factory});
+    }
+    if (options.left_factor) {
+      run(LeftFactor{factory});
+    }
+    if (options.char_class_choices) {
+      run(CharClassChoices{factory});
+    }
+  };
+
+  // Inlining measures rules once the other passes shrank them, and they
+  // then run again over what inlining spliced together.
+  run_local_passes();
+  if (options.inline_rules) {
+    const auto shrunk = arena.New<ast::RuleSet>(factory.Copy(optimized),
+                                                rule_set.GetRuleIndices());
+    run(InlineRules{*shrunk, factory, options.max_inline_nodes});
+    run_local_passes();
+  }
+  return arena.New<ast::RuleSet>(factory.Copy(optimized),
+                                 rule_set.GetRuleIndices());
+}
+
+} // namespace peg
+} // namespace kero
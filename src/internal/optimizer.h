@@ -0,0 +1,48 @@
+#ifndef KERO_PEG_INTERNAL_OPTIMIZER_H
+#define KERO_PEG_INTERNAL_OPTIMIZER_H
+
+#include <cstddef>
+
+#include "./arena.h"
+#include "./ast.h"
+
+namespace kero {
+namespace peg {
+
+// Passes of OptimizeRuleSet. Each keeps what every rule matches, though a
+// merged or factored terminal may report a failure at its start rather than
+// partway in. The passes run in this order, then inlining, then the others
+// once more over the inlined rules.
+struct OptimizerOptions {
+  // Drops Groups, splicing a grouped Sequence into its parent Sequence and a
+  // grouped OrderedChoice into its parent choice where no Cut tells them
+  // apart.
+  bool remove_groups{true};
+  // `'a' 'bc'` -> `'abc'`.
+  bool merge_literals{true};
+  // `'ab' X / 'ac' Y` -> `'a' ('b' X / 'c' Y)`, and likewise for adjacent
+  // alternatives starting with the same expression, so the prefix is matched
+  // once. Choices with a Cut are kept.
+  bool left_factor{true};
+  // `'a' / [0-9] / 'b'` -> `[a0-9b]`, for adjacent alternatives each matching
+  // a single byte.
+  bool char_class_choices{true};
+  // Replaces calls to small rules that cannot reach themselves with the
+  // rule's expression. Rules with a Cut are kept, as inlined the Cut would
+  // commit the caller's choice.
+  bool inline_rules{true};
+  // Inlined rules have at most this many nodes, counted after inlining.
+  size_t max_inline_nodes{12};
+};
+
+// Returns a RuleSet matching the same inputs as `rule_set`, with new nodes
+// allocated in `arena` and unchanged ones shared. Rules keep their indices
+// and names, so every rule can still be parsed from.
+auto OptimizeRuleSet(const ast::RuleSet& rule_set, Arena& arena,
+                     const OptimizerOptions& options = {}) noexcept
+    -> const ast::RuleSet*;
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_OPTIMIZER_H
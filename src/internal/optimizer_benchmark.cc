@@ -0,0 +1,114 @@
+#include "./optimizer.h"
+
+#include <string>
+
+#include "./bytecode_vm.h"
+#include "./testing/grammar.h"
+#include "benchmark/benchmark.h"
+
+// Written the way grammars often are, without regard for how they run.
+static constexpr std::string_view kVerboseGrammar =
+    "Doc <- Stmt* !.\n"
+    "Stmt <- Keyword Space Ident Space? '=' Space? Value ';' Newline\n"
+    "Keyword <- ('l' 'e' 't' / 'v' 'a' 'r') / 'c' 'o' 'n' 's' 't' / "
+    "'c' 'o' 'n' 't' 'i' 'n' 'u' 'e'\n"
+    "Ident <- Letter (Letter / Digit)*\n"
+    "Letter <- [a-z] / [A-Z] / '_'\n"
+    "Digit <- '0' / '1' / '2' / '3' / '4' / '5' / '6' / '7' / '8' / '9'\n"
+    "Value <- ('t' 'r' 'u' 'e' / 't' 'y' 'p' 'e') / 'f' 'a' 'l' 's' 'e' / "
+    "'n' 'u' 'l' 'l' / Number / String\n"
+    "Number <- ('-')? Digit+ (('.') Digit+)?\n"
+    "String <- '\"' (!'\"' .)* '\"'\n"
+    "Space <- (' ')+\n"
+    "Newline <- ([\n])\n";
+
+static auto MakeStatements(const size_t count) noexcept -> std::string {
+  std::string input;
+  for (size_t i{}; i < count; ++i) {
+    switch (i % 4) {
+    case 0:
+      input += "let width_" + std::to_string(i) + " = -12.5;\n";
+      break;
+    case 1:
+      input += "const Label = \"statement " + std::to_string(i) + "\";\n";
+      break;
+    case 2:
+      input += "var enabled = false;\n";
+      break;
+    default:
+      input += "let  count" + std::to_string(i) + "=null;\n";
+      break;
+    }
+  }
+  return input;
+}
+
+// Arg 0 runs no pass, 1 to 5 one pass each in OptimizerOptions order, and 6
+// all of them.
+static auto MakeOptions(const int64_t config) noexcept
+    -> kero::peg::OptimizerOptions {
+  if (config == 6) {
+    return {};
+  }
+  kero::peg::OptimizerOptions options{false, false, false, false, false};
+  switch (config) {
+  case 1:
+    options.remove_groups = true;
+    break;
+  case 2:
+    options.merge_literals = true;
+    break;
+  case 3:
+    options.left_factor = true;
+    break;
+  case 4:
+    options.char_class_choices = true;
+    break;
+  case 5:
+    options.inline_rules = true;
+    break;
+  }
+  return options;
+}
+
+static auto BM_OptimizedBytecodeVm(benchmark::State& state) -> void {
+  kero::peg::ParsedGrammar grammar{kVerboseGrammar};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto optimized =
+      kero::peg::OptimizeRuleSet(grammar.GetRuleSet(), grammar.GetArena(),
+                                 MakeOptions(state.range(0)));
+  const auto program = kero::peg::CompileBytecode(*optimized);
+  const auto input = MakeStatements(10000);
+  auto vm = kero::peg::BytecodeVm{program};
+  for (auto _ : state) {
+    auto res = vm.Run(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+  state.counters["instructions"] =
+      static_cast<double>(program.code.size());
+}
+BENCHMARK(BM_OptimizedBytecodeVm)->DenseRange(0, 6);
+
+// The cost of the passes themselves.
+static auto BM_OptimizeRuleSet(benchmark::State& state) -> void {
+  const kero::peg::ParsedGrammar grammar{kVerboseGrammar};
+  if (!grammar.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  for (auto _ : state) {
+    kero::peg::Arena arena;
+    benchmark::DoNotOptimize(
+        kero::peg::OptimizeRuleSet(grammar.GetRuleSet(), arena));
+  }
+}
+BENCHMARK(BM_OptimizeRuleSet);
@@ -0,0 +1,176 @@
+#include "./optimizer.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./bytecode_vm.h"
+#include "./testing/grammar.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Owns a parsed grammar and its optimized copies.
+class Grammar {
+public:
+  explicit Grammar(const std::string_view source) noexcept
+      : grammar_{source} {
+    EXPECT_TRUE(grammar_.IsOk());
+  }
+
+  // The first rule after the given passes, printed.
+  auto Optimize(const kero::peg::OptimizerOptions& options) noexcept
+      -> std::string {
+    const auto optimized = kero::peg::OptimizeRuleSet(
+        grammar_.GetRuleSet(), grammar_.GetArena(), options);
+    std::ostringstream oss;
+    oss << *static_cast<const kero::peg::ast::Rule*>(optimized->GetRules()[0])
+                ->GetExpression();
+    return oss.str();
+  }
+
+  // Checks the optimized grammar matches every input like the original.
+  auto ExpectSameMatches(const std::vector<std::string_view>& inputs,
+                         const kero::peg::OptimizerOptions& options = {})
+      -> void {
+    const auto& rule_set = grammar_.GetRuleSet();
+    const auto optimized =
+        kero::peg::OptimizeRuleSet(rule_set, grammar_.GetArena(), options);
+    const auto expected = kero::peg::CompileBytecode(rule_set);
+    const auto actual = kero::peg::CompileBytecode(*optimized);
+    for (uint32_t rule{}; rule < rule_set.GetRules().size(); ++rule) {
+      for (const auto input : inputs) {
+        auto want = kero::peg::BytecodeVm{expected}.Run(input, rule);
+        auto got = kero::peg::BytecodeVm{actual}.Run(input, rule);
+        ASSERT_EQ(got.IsOk(), want.IsOk()) << input;
+        if (want.IsOk()) {
+          EXPECT_EQ(*got.Ok(), *want.Ok()) << input;
+        }
+      }
+    }
+  }
+
+private:
+  kero::peg::ParsedGrammar grammar_;
+};
+
+// Options with only the pass `field` enabled.
+auto Only(bool kero::peg::OptimizerOptions::* field) noexcept
+    -> kero::peg::OptimizerOptions {
+  kero::peg::OptimizerOptions options{false, false, false, false, false};
+  options.*field = true;
+  return options;
+}
+
+using Options = kero::peg::OptimizerOptions;
+
+} // namespace
+
+TEST(OptimizerTest, NoPasses) {
+  Grammar grammar{"A <- ('a' 'b') / 'c'"};
+  EXPECT_EQ(grammar.Optimize(Options{false, false, false, false, false}),
+            "OrderedChoice{Group{Sequence{QuotedTerminal{a}, "
+            "QuotedTerminal{b}}}, QuotedTerminal{c}}");
+}
+
+TEST(OptimizerTest, InlineRules) {
+  Grammar grammar{"A <- B C D\nB <- 'b'\nC <- 'c' B\nD <- 'd' D / 'e'\n"};
+  // D calls itself, so only B and C are inlined, B also into C.
+  EXPECT_EQ(grammar.Optimize(Only(&Options::inline_rules)),
+            "Sequence{Group{QuotedTerminal{b}}, Group{Sequence{"
+            "QuotedTerminal{c}, Group{QuotedTerminal{b}}}}, NonTerminal{D}}");
+  grammar.ExpectSameMatches({"bcbde", "bcbdde", "bcb", "bcde", ""},
+                            Only(&Options::inline_rules));
+}
+
+TEST(OptimizerTest, InlineRulesLimits) {
+  // B has a Cut and C is too large.
+  Grammar grammar{"A <- B C\nB <- 'a' ^ 'b'\n"
+                  "C <- 'c' 'c' 'c' 'c' 'c' 'c' 'c' 'c' 'c' 'c' 'c' 'c'\n"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::inline_rules)),
+            "Sequence{NonTerminal{B}, NonTerminal{C}}");
+}
+
+TEST(OptimizerTest, RemoveGroups) {
+  Grammar grammar{"A <- 'a' ('b' ('c' 'd')) / ('e' / ('f' / 'g'))"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::remove_groups)),
+            "OrderedChoice{Sequence{QuotedTerminal{a}, QuotedTerminal{b}, "
+            "QuotedTerminal{c}, QuotedTerminal{d}}, QuotedTerminal{e}, "
+            "QuotedTerminal{f}, QuotedTerminal{g}}");
+}
+
+TEST(OptimizerTest, RemoveGroupsKeepsCutScopes) {
+  // The inner choice's Cut must not commit the outer choice past 'a' 'c'.
+  Grammar grammar{"A <- ('a' ^ 'b' / 'x') / 'a' 'c'"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::remove_groups)),
+            "OrderedChoice{OrderedChoice{Sequence{QuotedTerminal{a}, Cut, "
+            "QuotedTerminal{b}}, QuotedTerminal{x}}, Sequence{"
+            "QuotedTerminal{a}, QuotedTerminal{c}}}");
+  grammar.ExpectSameMatches({"ab", "ac", "x", "a"});
+}
+
+TEST(OptimizerTest, MergeLiterals) {
+  Grammar grammar{"A <- 'a' 'bc' [x] 'd' 'e' 'f' . 'g'"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::merge_literals)),
+            "Sequence{QuotedTerminal{abc}, BracketedTerminal{x}, "
+            "QuotedTerminal{def}, AnyCharacter, QuotedTerminal{g}}");
+  grammar.ExpectSameMatches({"abcxdef.g", "abcxdefzg", "abcxde", "ab"},
+                            Only(&Options::merge_literals));
+}
+
+TEST(OptimizerTest, LeftFactor) {
+  Grammar grammar{"A <- 'ab' 'x' / 'ac' / 'ab' / [0-9] 'y' / [0-9] 'z' / 'q'"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::left_factor)),
+            "OrderedChoice{Sequence{QuotedTerminal{a}, OrderedChoice{"
+            "Sequence{QuotedTerminal{b}, QuotedTerminal{x}}, "
+            "QuotedTerminal{c}, QuotedTerminal{b}}}, "
+            "Sequence{BracketedTerminal{0-9}, OrderedChoice{"
+            "QuotedTerminal{y}, QuotedTerminal{z}}}, QuotedTerminal{q}}");
+  grammar.ExpectSameMatches({"abx", "ac", "ab", "a", "1y", "1z", "1q", "q"},
+                            Only(&Options::left_factor));
+}
+
+TEST(OptimizerTest, LeftFactorPrefixOfAnother) {
+  // 'if' always wins over 'ifx', as before factoring.
+  Grammar grammar{"A <- 'if' / 'ifx'"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::left_factor)),
+            "QuotedTerminal{if}");
+  grammar.ExpectSameMatches({"if", "ifx", "i"}, Only(&Options::left_factor));
+}
+
+TEST(OptimizerTest, LeftFactorKeepsCuts) {
+  Grammar grammar{"A <- 'a' ^ 'b' / 'a' 'c'"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::left_factor)),
+            "OrderedChoice{Sequence{QuotedTerminal{a}, Cut, "
+            "QuotedTerminal{b}}, Sequence{QuotedTerminal{a}, "
+            "QuotedTerminal{c}}}");
+}
+
+TEST(OptimizerTest, CharClassChoices) {
+  Grammar grammar{"A <- 'a' / [0-9] / '-' / 'bc' / 'x' / 'y'"};
+  EXPECT_EQ(grammar.Optimize(Only(&Options::char_class_choices)),
+            "OrderedChoice{BracketedTerminal{-0-9a}, QuotedTerminal{bc}, "
+            "BracketedTerminal{x-y}}");
+  grammar.ExpectSameMatches({"a", "5", "-", "bc", "b", "x", "y", "z", ","},
+                            Only(&Options::char_class_choices));
+}
+
+TEST(OptimizerTest, AllPasses) {
+  Grammar grammar{"Value <- Number / Keyword / '(' Value ')'\n"
+                  "Number <- Digit+ ('.' Digit+)?\n"
+                  "Digit <- '0' / '1' / '2' / '3' / '4' / '5' / '6' / '7' / "
+                  "'8' / '9'\n"
+                  "Keyword <- 't' 'r' 'u' 'e' / 't' 'y' 'p' 'e' / 'n' 'u' 'l' "
+                  "'l'\n"};
+  EXPECT_EQ(grammar.Optimize(Options{}),
+            "OrderedChoice{Sequence{OneOrMore{BracketedTerminal{0-9}}, "
+            "Optional{Sequence{QuotedTerminal{.}, "
+            "OneOrMore{BracketedTerminal{0-9}}}}}, "
+            "Sequence{QuotedTerminal{t}, OrderedChoice{QuotedTerminal{rue}, "
+            "QuotedTerminal{ype}}}, QuotedTerminal{null}, "
+            "Sequence{QuotedTerminal{(}, NonTerminal{Value}, "
+            "QuotedTerminal{)}}}");
+  grammar.ExpectSameMatches({"12", "1.5", "1.", "true", "type", "tru", "null",
+                             "((3))", "(true", "x", ""});
+}
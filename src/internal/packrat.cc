@@ -0,0 +1,566 @@
+#include "./packrat.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
+#include <type_traits>
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+// Memo entries. Anything from kMemoEnd on is a match ending at
+// `entry - kMemoEnd`.
+constexpr uint32_t kMemoUnknown = 0;
+constexpr uint32_t kMemoInProgress = 1;
+constexpr uint32_t kMemoFailure = 2;
+constexpr uint32_t kMemoEnd = 3;
+
+constexpr size_t kNoMatch = std::numeric_limits<size_t>::max();
+
+// What a Cut commits: the innermost enclosing choice alternative, repetition
+// iteration or option. Rules and predicates open scopes that cannot be cut,
+// so a Cut never reaches past them.
+struct CutScope {
+  // Whether failing here resumes an earlier position.
+  bool backtracks;
+  bool cuttable;
+  bool cut{};
+};
+
+// One parse. Every Match returns the end of the match or kNoMatch.
+class PackratInterpreter {
+public:
+  PackratInterpreter(const ast::RuleSet& rule_set,
+                     const std::string_view input,
+                     std::vector<PackratRule>& rules,
+                     const std::unordered_map<const ast::Node*, uint32_t>&
+                         repetitions,
+                     const uint32_t column_count, const bool has_cut,
+                     const size_t max_depth, std::vector<uint32_t>& memo,
+                     PackratStats& stats) noexcept
+      : rule_set_{rule_set}, input_{input}, rules_{rules},
+        repetitions_{repetitions}, column_count_{column_count},
+        has_cut_{has_cut}, max_depth_{max_depth},
+        max_reruns_{kPackratMaxRerunsPerByte * (input.size() + 1)},
+        memo_{memo}, stats_{stats} {}
+
+  // Once the nesting limit is hit every match fails, which unwinds the parse
+  // without trying the remaining alternatives.
+  auto Match(const ast::Node& node, const size_t position) noexcept -> size_t {
+    if (depth_ >= max_depth_) {
+      stack_overflow_ = true;
+      return kNoMatch;
+    }
+
+    ++depth_;
+    const auto end =
+        ast::Visit(node, [this, position](const auto& concrete) noexcept {
+          return Match(concrete, position);
+        });
+    --depth_;
+    return end;
+  }
+
+  auto MatchRule(const uint32_t rule_index, const size_t position) noexcept
+      -> size_t {
+    auto& rule = rules_[rule_index];
+    ++rule.calls;
+    if (rule.column == kPackratNoColumn) {
+      if (rule.terminal_only || ++rule.reruns <= max_reruns_) {
+        return MatchUnmemoized(rule_index, position);
+      }
+      // Reruns add up to more than the memo entries would cost, however
+      // rarely the rule hit in earlier parses.
+      AddColumn(rule);
+    }
+
+    // Nothing backtracks to a dropped row, but keep going without the table
+    // should it happen.
+    if (position < base_) {
+      return Evaluate(rule_index, position);
+    }
+
+    const auto column = rule.column;
+    auto& entry = GetEntry(position, column);
+    switch (entry) {
+    case kMemoUnknown:
+      break;
+    case kMemoInProgress:
+      left_recursion_ = true;
+      return kNoMatch;
+    case kMemoFailure:
+      ++rule.hits;
+      ++stats_.memo_hits;
+      return kNoMatch;
+    default:
+      ++rule.hits;
+      ++stats_.memo_hits;
+      return entry - kMemoEnd;
+    }
+
+    ++stats_.memo_misses;
+    entry = kMemoInProgress;
+    const auto end = Evaluate(rule_index, position);
+    // A Cut inside the rule may have dropped the row.
+    if (position >= base_) {
+      GetEntry(position, column) = ToEntry(end);
+    }
+    return end;
+  }
+
+  auto HasLeftRecursion() const noexcept -> bool { return left_recursion_; }
+
+  auto HasStackOverflow() const noexcept -> bool { return stack_overflow_; }
+
+  auto GetFarthest() const noexcept -> size_t { return farthest_; }
+
+private:
+  // The memo entry of `column` at `position`, which must not be before
+  // `base_`. Adds rows up to `position` as needed.
+  auto GetEntry(const size_t position, const uint32_t column) noexcept
+      -> uint32_t& {
+    const auto index = (position - base_) * column_count_ + column;
+    if (index >= memo_.size()) {
+      memo_.resize((position - base_ + 1) * column_count_, kMemoUnknown);
+      stats_.peak_memo_entries =
+          std::max(stats_.peak_memo_entries, memo_.size());
+    }
+    return memo_[index];
+  }
+
+  // Gives `rule` the next column in the middle of the parse by widening every
+  // row. Columns are only ever added, so those already handed out stay put.
+  auto AddColumn(PackratRule& rule) noexcept -> void {
+    const auto rows = column_count_ == 0 ? 0 : memo_.size() / column_count_;
+    std::vector<uint32_t> memo(rows * (column_count_ + 1), kMemoUnknown);
+    for (size_t row{}; row < rows; ++row) {
+      std::copy_n(memo_.begin() +
+                      static_cast<std::ptrdiff_t>(row * column_count_),
+                  column_count_,
+                  memo.begin() +
+                      static_cast<std::ptrdiff_t>(row * (column_count_ + 1)));
+    }
+    memo_ = std::move(memo);
+    rule.column = static_cast<uint32_t>(column_count_++);
+    stats_.peak_memo_entries =
+        std::max(stats_.peak_memo_entries, memo_.size());
+  }
+
+  static auto ToEntry(const size_t end) noexcept -> uint32_t {
+    return end == kNoMatch ? kMemoFailure
+                           : static_cast<uint32_t>(end + kMemoEnd);
+  }
+
+  auto Evaluate(const uint32_t rule_index, const size_t position) noexcept
+      -> size_t {
+    const auto& rule =
+        static_cast<const ast::Rule&>(*rule_set_.GetRules()[rule_index]);
+    if (!has_cut_) {
+      return Match(*rule.GetExpression(), position);
+    }
+
+    auto scope = CutScope{.backtracks = false, .cuttable = false};
+    const auto outer = std::exchange(scope_, &scope);
+    const auto end = Match(*rule.GetExpression(), position);
+    scope_ = outer;
+    return end;
+  }
+
+  // Runs `expression` in a new CutScope and returns its end and whether it
+  // was cut. Grammars without cuts skip the bookkeeping.
+  auto MatchScoped(const ast::Node& expression, const size_t position,
+                   const bool backtracks, const bool cuttable) noexcept
+      -> std::pair<size_t, bool> {
+    if (!has_cut_) {
+      return {Match(expression, position), false};
+    }
+
+    auto scope = CutScope{.backtracks = backtracks, .cuttable = cuttable};
+    const auto outer = std::exchange(scope_, &scope);
+    backtrack_points_ += backtracks;
+    const auto end = Match(expression, position);
+    scope_ = outer;
+    backtrack_points_ -= scope.backtracks && !scope.cut;
+    return {end, scope.cut};
+  }
+
+  // Nested calls of a rule never move backwards, so a call at the position of
+  // the innermost running call of the same rule is left recursion.
+  auto MatchUnmemoized(const uint32_t rule_index,
+                       const size_t position) noexcept -> size_t {
+    auto& rule = rules_[rule_index];
+    ++stats_.unmemoized_calls;
+    if (rule.active_position == position) {
+      left_recursion_ = true;
+      return kNoMatch;
+    }
+
+    if (rule.last_position == position) {
+      ++rule.repeats;
+    }
+    rule.last_position = position;
+    const auto outer = rule.active_position;
+    rule.active_position = position;
+    const auto end = Evaluate(rule_index, position);
+    // `rule` is still valid: the rule list never grows during a parse.
+    rule.active_position = outer;
+    return end;
+  }
+
+  auto Match(const ast::RuleSet&, const size_t) noexcept -> size_t {
+    return kNoMatch;
+  }
+
+  auto Match(const ast::Rule& node, const size_t position) noexcept -> size_t {
+    return Match(*node.GetExpression(), position);
+  }
+
+  auto Match(const ast::NonTerminal& node, const size_t position) noexcept
+      -> size_t {
+    return MatchRule(rule_set_.GetRuleIndex(node.GetSymbol()), position);
+  }
+
+  auto Match(const ast::Sequence& node, size_t position) noexcept -> size_t {
+    for (const auto expression : node.GetExpressions()) {
+      position = Match(*expression, position);
+      if (position == kNoMatch) {
+        return kNoMatch;
+      }
+    }
+    return position;
+  }
+
+  // A cut alternative that fails fails the whole choice.
+  auto Match(const ast::OrderedChoice& node, const size_t position) noexcept
+      -> size_t {
+    const auto alternatives = node.GetAlternatives();
+    for (size_t i{}; i < alternatives.size(); ++i) {
+      const auto [end, cut] =
+          MatchScoped(*alternatives[i], position,
+                      i + 1 < alternatives.size(), true);
+      if (end != kNoMatch || cut) {
+        return end;
+      }
+    }
+    return kNoMatch;
+  }
+
+  // Repetitions stop once an iteration consumes nothing, so `e*` terminates
+  // even if `e` matches the empty string. A cut iteration that fails fails
+  // the whole repetition.
+  auto Match(const ast::ZeroOrMore& node, size_t position) noexcept -> size_t {
+    return Repeat(repetitions_.find(&node)->second, *node.GetExpression(),
+                  position);
+  }
+
+  auto Match(const ast::OneOrMore& node, const size_t position) noexcept
+      -> size_t {
+    const auto [end, cut] =
+        MatchScoped(*node.GetExpression(), position, false, true);
+    if (end == kNoMatch || end == position) {
+      return end;
+    }
+    return Repeat(repetitions_.find(&node)->second, *node.GetExpression(), end);
+  }
+
+  // Every position an iteration of a memoized repetition starts at ends up
+  // with the end of the whole run, which is where `e*` from there ends too.
+  // The positions are kept on `starts_` above those of the enclosing runs.
+  //
+  // An unmemoized repetition that runs too many iterations gets its column
+  // on the spot, as rescans of the same input would otherwise add up.
+  auto Repeat(const uint32_t index, const ast::Node& expression,
+              size_t position) noexcept -> size_t {
+    auto& repetition = rules_[index];
+    ++repetition.calls;
+    const auto first = starts_.size();
+    auto end = kNoMatch;
+    while (true) {
+      // A nested run of the same repetition may have added the column.
+      const auto column = repetition.column;
+      if (column == kPackratNoColumn) {
+        if (++repetition.reruns > max_reruns_) {
+          AddColumn(repetition);
+          continue;
+        }
+      } else if (position >= base_) {
+        if (const auto entry = GetEntry(position, column);
+            entry != kMemoUnknown) {
+          ++repetition.hits;
+          ++stats_.memo_hits;
+          end = entry == kMemoFailure ? kNoMatch : entry - kMemoEnd;
+          break;
+        }
+        if (starts_.size() == first) {
+          ++stats_.memo_misses;
+        }
+        starts_.push_back(position);
+      }
+
+      ++stats_.iterations;
+      const auto [next, cut] = MatchScoped(expression, position, true, true);
+      if (next == kNoMatch || next == position) {
+        end = next == kNoMatch && cut ? kNoMatch : position;
+        break;
+      }
+      position = next;
+    }
+
+    // A Cut inside an iteration may have dropped some of the rows.
+    for (auto i = first; i < starts_.size(); ++i) {
+      if (starts_[i] >= base_) {
+        GetEntry(starts_[i], repetition.column) = ToEntry(end);
+      }
+    }
+    starts_.resize(first);
+    return end;
+  }
+
+  auto Match(const ast::Optional& node, const size_t position) noexcept
+      -> size_t {
+    const auto [end, cut] =
+        MatchScoped(*node.GetExpression(), position, true, true);
+    return end == kNoMatch && !cut ? position : end;
+  }
+
+  auto Match(const ast::AndPredicate& node, const size_t position) noexcept
+      -> size_t {
+    const auto [end, cut] =
+        MatchScoped(*node.GetExpression(), position, true, false);
+    return end == kNoMatch ? kNoMatch : position;
+  }
+
+  auto Match(const ast::NotPredicate& node, const size_t position) noexcept
+      -> size_t {
+    const auto [end, cut] =
+        MatchScoped(*node.GetExpression(), position, true, false);
+    return end == kNoMatch ? position : kNoMatch;
+  }
+
+  // Commits the innermost scope. Once nothing can backtrack, no rule will be
+  // asked about an earlier position again, so the rows before this one go.
+  auto Match(const ast::Cut&, const size_t position) noexcept -> size_t {
+    if (scope_->cuttable && !scope_->cut) {
+      scope_->cut = true;
+      backtrack_points_ -= scope_->backtracks;
+    }
+
+    if (backtrack_points_ == 0 && position > base_) {
+      const auto entries =
+          std::min((position - base_) * column_count_, memo_.size());
+      memo_.erase(memo_.begin(),
+                  memo_.begin() + static_cast<std::ptrdiff_t>(entries));
+      base_ = position;
+    }
+    return position;
+  }
+
+  auto Match(const ast::Group& node, const size_t position) noexcept
+      -> size_t {
+    return Match(*node.GetExpression(), position);
+  }
+
+  auto Match(const ast::AnyCharacter&, const size_t position) noexcept
+      -> size_t {
+    Reach(position);
+    return position < input_.size() ? position + 1 : kNoMatch;
+  }
+
+  auto Match(const ast::QuotedTerminal& node, const size_t position) noexcept
+      -> size_t {
+    Reach(position);
+    const auto value = node.GetValue();
+    return input_.substr(position).starts_with(value) ? position + value.size()
+                                                      : kNoMatch;
+  }
+
+  auto Match(const ast::BracketedTerminal& node, const size_t position) noexcept
+      -> size_t {
+    Reach(position);
+    return position < input_.size() &&
+                   node.GetCharClass().Contains(input_[position])
+               ? position + 1
+               : kNoMatch;
+  }
+
+  auto Reach(const size_t position) noexcept -> void {
+    farthest_ = std::max(farthest_, position);
+  }
+
+  const ast::RuleSet& rule_set_;
+  std::string_view input_;
+  std::vector<PackratRule>& rules_;
+  const std::unordered_map<const ast::Node*, uint32_t>& repetitions_;
+  size_t column_count_;
+  bool has_cut_;
+  size_t max_depth_;
+  uint64_t max_reruns_;
+  std::vector<uint32_t>& memo_;
+  PackratStats& stats_;
+  // Position of the first row of `memo_`.
+  size_t base_{};
+  // Iteration starts of the running memoized repetitions.
+  std::vector<size_t> starts_;
+  // The innermost scope, which lives in the frame that opened it.
+  CutScope* scope_{};
+  // Open scopes that can still backtrack.
+  size_t backtrack_points_{};
+  size_t farthest_{};
+  // Expressions being matched, innermost included.
+  size_t depth_{};
+  bool left_recursion_{};
+  bool stack_overflow_{};
+};
+
+} // namespace
+
+auto operator<<(std::ostream& os, const PackratErrorCode code) noexcept
+    -> std::ostream& {
+  switch (code) {
+  case PackratErrorCode::kNoMatch:
+    os << "NoMatch";
+    break;
+  case PackratErrorCode::kInputTooLarge:
+    os << "InputTooLarge";
+    break;
+  case PackratErrorCode::kLeftRecursion:
+    os << "LeftRecursion";
+    break;
+  case PackratErrorCode::kStackOverflow:
+    os << "StackOverflow";
+    break;
+  }
+  return os;
+}
+
+auto operator<<(std::ostream& os, const PackratError& error) noexcept
+    -> std::ostream& {
+  os << "PackratError{";
+  os << "code=" << error.code << ", ";
+  os << "position=" << error.position;
+  os << "}";
+  return os;
+}
+
+auto operator<<(std::ostream& os, const PackratStats& stats) noexcept
+    -> std::ostream& {
+  os << "PackratStats{";
+  os << "memo_hits=" << stats.memo_hits << ", ";
+  os << "memo_misses=" << stats.memo_misses << ", ";
+  os << "unmemoized_calls=" << stats.unmemoized_calls << ", ";
+  os << "iterations=" << stats.iterations << ", ";
+  os << "peak_memo_entries=" << stats.peak_memo_entries;
+  os << "}";
+  return os;
+}
+
+PackratParser::PackratParser(const ast::RuleSet& rule_set,
+                             const PackratMemoPolicy policy,
+                             const size_t max_depth) noexcept
+    : rule_set_{rule_set}, policy_{policy}, max_depth_{max_depth} {
+  rules_.reserve(rule_set.GetRules().size());
+  for (const auto node : rule_set.GetRules()) {
+    const auto& rule = static_cast<const ast::Rule&>(*node);
+    const auto terminal_only =
+        policy == PackratMemoPolicy::kAdaptive &&
+        !ast::Contains(*rule.GetExpression(), ast::NodeKind::kNonTerminal);
+    has_cut_ = has_cut_ ||
+               ast::Contains(*rule.GetExpression(), ast::NodeKind::kCut);
+    rules_.push_back(PackratRule{
+        .column = terminal_only ? kPackratNoColumn : column_count_++,
+        .terminal_only = terminal_only,
+    });
+  }
+
+  std::vector<const ast::Node*> stack;
+  for (const auto node : rule_set.GetRules()) {
+    stack.push_back(static_cast<const ast::Rule&>(*node).GetExpression());
+    while (!stack.empty()) {
+      const auto expression = stack.back();
+      stack.pop_back();
+      if (expression->Kind() == ast::NodeKind::kZeroOrMore ||
+          expression->Kind() == ast::NodeKind::kOneOrMore) {
+        repetitions_.emplace(expression,
+                             static_cast<uint32_t>(rules_.size()));
+        rules_.push_back(PackratRule{
+            .column = policy == PackratMemoPolicy::kAll ? column_count_++
+                                                        : kPackratNoColumn,
+        });
+      }
+      ast::PushChildren(*expression, stack);
+    }
+  }
+}
+
+auto PackratParser::Parse(const std::string_view input,
+                          const uint32_t rule_index) noexcept
+    -> Result<size_t, PackratError> {
+  assert(rule_index < rule_set_.GetRules().size());
+  if (input.size() >= std::numeric_limits<uint32_t>::max() - kMemoEnd) {
+    return Result<size_t, PackratError>{
+        PackratError{PackratErrorCode::kInputTooLarge, 0}};
+  }
+
+  // One row of memoized rules per position. Without cuts every position up
+  // to the end of input gets one up front; with cuts rows are added as
+  // positions are reached and dropped once nothing can backtrack to them.
+  if (has_cut_) {
+    memo_.clear();
+  } else {
+    memo_.assign((input.size() + 1) * column_count_, kMemoUnknown);
+  }
+  stats_ = PackratStats{.peak_memo_entries = memo_.size()};
+  for (auto& rule : rules_) {
+    rule.calls = 0;
+    rule.hits = 0;
+    rule.repeats = 0;
+    rule.reruns = 0;
+    rule.last_position = kNoMatch;
+    rule.active_position = kNoMatch;
+  }
+
+  auto interpreter = PackratInterpreter{
+      rule_set_, input,      rules_, repetitions_, column_count_,
+      has_cut_,  max_depth_, memo_,  stats_};
+  const auto end = interpreter.MatchRule(rule_index, 0);
+  if (policy_ == PackratMemoPolicy::kAdaptive) {
+    Adapt();
+  }
+  if (interpreter.HasStackOverflow()) {
+    return Result<size_t, PackratError>{PackratError{
+        PackratErrorCode::kStackOverflow, interpreter.GetFarthest()}};
+  }
+  if (interpreter.HasLeftRecursion()) {
+    return Result<size_t, PackratError>{PackratError{
+        PackratErrorCode::kLeftRecursion, interpreter.GetFarthest()}};
+  }
+
+  if (end == kNoMatch) {
+    return Result<size_t, PackratError>{
+        PackratError{PackratErrorCode::kNoMatch, interpreter.GetFarthest()}};
+  }
+
+  return Result<size_t, PackratError>{size_t{end}};
+}
+
+auto PackratParser::Adapt() noexcept -> void {
+  column_count_ = 0;
+  for (auto& rule : rules_) {
+    if (rule.terminal_only) {
+      continue;
+    }
+
+    auto memoize = rule.column != kPackratNoColumn;
+    if (rule.calls >= kPackratMinCalls) {
+      memoize = memoize ? rule.hits * kPackratMinHitRatio >= rule.calls
+                        : rule.repeats * kPackratMinHitRatio >= rule.calls;
+    }
+    rule.column = memoize ? column_count_++ : kPackratNoColumn;
+  }
+}
+
+} // namespace peg
+} // namespace kero
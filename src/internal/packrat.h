@@ -1,18 +1,178 @@
 #ifndef KERO_PEG_INTERNAL_PACKRAT_H
 #define KERO_PEG_INTERNAL_PACKRAT_H
 
-#include "./core.h"
-#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "./ast.h"
+#include "./core.h"
+
 namespace kero {
 namespace peg {
 
+enum class PackratErrorCode : int32_t {
+  kNoMatch = 0,
+  kInputTooLarge,
+  kLeftRecursion,
+  kStackOverflow,
+};
+
+auto operator<<(std::ostream& os, const PackratErrorCode code) noexcept
+    -> std::ostream&;
+
+struct PackratError {
+  PackratErrorCode code;
+  // The farthest input position any terminal was tried at, which is where a
+  // syntax error usually is.
+  size_t position;
+};
+
+auto operator<<(std::ostream& os, const PackratError& error) noexcept
+    -> std::ostream&;
+
+enum class PackratMemoPolicy : int32_t {
+  // Memoize every rule and repetition.
+  kAll = 0,
+  // Skip rules that reference no other rule and repetitions until they prove
+  // expensive, and retune the rest after every parse from their hit rates.
+  kAdaptive,
+};
+
+// A memoized rule keeps its column while at least 1 in this many calls is a
+// memo hit...
+constexpr uint64_t kPackratMinHitRatio = 32;
+// ...and only rules with at least this many calls in a parse are judged.
+constexpr uint64_t kPackratMinCalls = 256;
+// An unmemoized rule that references other rules and is called more often
+// than this per input byte in one parse, or an unmemoized repetition that runs
+// more iterations, gets a column for the rest of it.
+constexpr uint64_t kPackratMaxRerunsPerByte = 4;
+
+// Expressions a parse may nest before it fails with kStackOverflow. The
+// interpreter recurses once per nested expression, which this keeps under
+// 2 MiB of stack even in unoptimized builds.
+constexpr size_t kPackratDefaultMaxDepth = size_t{1} << 13;
+
+// Counters for one parse.
+struct PackratStats {
+  // Calls to memoized rules and repetitions answered from the memo table,
+  // including repetitions that ran into the end of an earlier run.
+  uint64_t memo_hits{};
+  // Calls to memoized rules and repetitions that had to run them.
+  uint64_t memo_misses{};
+  // Calls to rules without a memo column.
+  uint64_t unmemoized_calls{};
+  // Iterations run by repetitions. Together with the rule runs they bound the
+  // work of a parse.
+  uint64_t iterations{};
+  // Most entries the memo table held at once.
+  size_t peak_memo_entries{};
+};
+
+auto operator<<(std::ostream& os, const PackratStats& stats) noexcept
+    -> std::ostream&;
+
+constexpr uint32_t kPackratNoColumn = std::numeric_limits<uint32_t>::max();
+
+// Memoization state of one rule or repetition.
+struct PackratRule {
+  // Column of the rule in the memo table, or kPackratNoColumn.
+  uint32_t column{};
+  // The rule references no other rule, so rerunning it is cheap. Always false
+  // for repetitions, whose reruns scan the input again.
+  bool terminal_only{};
+  // Counters of the current parse.
+  uint64_t calls{};
+  uint64_t hits{};
+  // Calls to an unmemoized rule at the position of its previous call, which
+  // a memo entry would have answered.
+  uint64_t repeats{};
+  // Calls of an unmemoized rule, or iterations of an unmemoized repetition.
+  uint64_t reruns{};
+  size_t last_position{};
+  // Position of the innermost running call, to catch left recursion without
+  // a memo entry.
+  size_t active_position{};
+};
+
+// Interprets an ast::RuleSet against an input with packrat memoization: the
+// result of every rule at every position is kept in a flat rule x position
+// table of 32-bit entries, so each rule runs at most once per position and a
+// parse takes time linear in the input for a fixed grammar.
+//
+// Repetitions get columns of their own, as they would as the rule
+// `R <- e R / ε`: a run of `e*` records where it ends at every position an
+// iteration starts at, and a later run that reaches one of them stops there.
+// Otherwise `X <- 'a'*` called at every position of `aaaa...` would rescan
+// the rest of the input each time. With kAdaptive a repetition starts without
+// a column and gets one in the middle of a parse once its iterations exceed
+// kPackratMaxRerunsPerByte per input byte.
+//
+// With PackratMemoPolicy::kAdaptive only rules that pay for their entries get
+// a column. Rules that reference no other rule are rerun instead, and a rule
+// whose calls almost never hit loses its column for the next parse. It gets
+// the column back once it is called again at the same position often enough,
+// or in the middle of a parse once its calls exceed kPackratMaxRerunsPerByte
+// per input byte, so an input unlike the earlier ones cannot make reruns
+// blow up.
+//
+// A Cut (`^`) commits its innermost choice alternative, repetition iteration
+// or option. When no enclosing construct can backtrack any more, the rows
+// before the cut are dropped, so a grammar such as `File <- (Line ^)* !.`
+// parses with a memo table the size of one line rather than the input.
+//
+// The interpreter recurses on the native stack. An input that nests deeper
+// than `max_depth` expressions, such as a long run of open parentheses, fails
+// the parse with kStackOverflow instead of overflowing it.
+//
+// Quoted terminals match their text byte for byte; there are no escapes.
 class PackratParser {
 public:
+  // `rule_set` must outlive the parser.
+  PackratParser(
+      const ast::RuleSet& rule_set,
+      const PackratMemoPolicy policy = PackratMemoPolicy::kAdaptive,
+      const size_t max_depth = kPackratDefaultMaxDepth) noexcept;
+
+  // Matches the rule at `rule_index` (the first rule by default) at the start
+  // of `input` and returns the length it consumed, which may be less than the
+  // whole input. A rule that calls itself at the same position fails the
+  // parse with kLeftRecursion.
+  auto Parse(const std::string_view input,
+             const uint32_t rule_index = 0) noexcept
+      -> Result<size_t, PackratError>;
+
+  // Entries in the memo table of the last parse.
+  auto GetMemoSize() const noexcept -> size_t { return memo_.size(); }
+
+  // Counters of the last parse.
+  auto GetStats() const noexcept -> const PackratStats& { return stats_; }
+
+  // Whether the next parse memoizes the rule at `rule_index`.
+  auto IsMemoized(const uint32_t rule_index) const noexcept -> bool {
+    return rules_[rule_index].column != kPackratNoColumn;
+  }
+
 private:
+  // Hands out memo columns for the next parse from the counters of the last.
+  auto Adapt() noexcept -> void;
+
+  const ast::RuleSet& rule_set_;
+  PackratMemoPolicy policy_;
+  size_t max_depth_;
+  // The rules in order, then the repetitions.
+  std::vector<PackratRule> rules_;
+  // Entry of each ZeroOrMore and OneOrMore node in `rules_`.
+  std::unordered_map<const ast::Node*, uint32_t> repetitions_;
+  uint32_t column_count_{};
+  bool has_cut_{};
+  std::vector<uint32_t> memo_;
+  PackratStats stats_{};
 };
 
 } // namespace peg
@@ -0,0 +1,53 @@
+#include "./packrat.h"
+
+#include <string_view>
+
+#include "./testing/grammar.h"
+#include "benchmark/benchmark.h"
+
+// kCsvGrammar with every line cut, so the memo table keeps one line.
+static constexpr std::string_view kCsvCutGrammar =
+    "File <- (Line ^)* !.\n"
+    "Line <- Field (',' Field)* [\n]\n"
+    "Field <- '\"' (!'\"' .)* '\"' / [a-zA-Z0-9_ .]*\n";
+
+// Parse a CSV document with the packrat interpreter; reports MB/s and the
+// peak memo table size. The second argument is the PackratMemoPolicy.
+static auto RunPackratCsv(benchmark::State& state,
+                          const std::string_view grammar) -> void {
+  const kero::peg::ParsedGrammar parsed{grammar};
+  if (!parsed.IsOk()) {
+    state.SkipWithError("grammar failed");
+    return;
+  }
+  const auto input = kero::peg::MakeCsv(static_cast<size_t>(state.range(0)));
+  auto packrat = kero::peg::PackratParser{
+      parsed.GetRuleSet(),
+      static_cast<kero::peg::PackratMemoPolicy>(state.range(1))};
+  for (auto _ : state) {
+    auto res = packrat.Parse(input);
+    if (res.IsErr() || *res.Ok() != input.size()) {
+      state.SkipWithError("parse failed");
+      break;
+    }
+    benchmark::DoNotOptimize(*res.Ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(input.size()));
+  state.counters["memo_bytes"] = static_cast<double>(
+      packrat.GetStats().peak_memo_entries * sizeof(uint32_t));
+}
+
+static auto BM_PackratParseCsv(benchmark::State& state) -> void {
+  RunPackratCsv(state, kero::peg::kCsvGrammar);
+}
+BENCHMARK(BM_PackratParseCsv)
+    ->Args({10000, static_cast<int64_t>(kero::peg::PackratMemoPolicy::kAll)})
+    ->Args({10000,
+            static_cast<int64_t>(kero::peg::PackratMemoPolicy::kAdaptive)});
+
+static auto BM_PackratParseCsvCut(benchmark::State& state) -> void {
+  RunPackratCsv(state, kCsvCutGrammar);
+}
+BENCHMARK(BM_PackratParseCsvCut)
+    ->Args({10000, static_cast<int64_t>(kero::peg::PackratMemoPolicy::kAll)});
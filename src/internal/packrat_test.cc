@@ -0,0 +1,324 @@
+#include "./packrat.h"
+
+#include <string>
+#include <string_view>
+
+#include "./testing/grammar.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Owns the parsed grammar and a packrat parser over it.
+class Grammar {
+public:
+  explicit Grammar(const std::string_view source) noexcept
+      : grammar_{source} {
+    EXPECT_TRUE(grammar_.IsOk());
+  }
+
+  // The length matched by the first rule, or -1 on failure.
+  auto Match(const std::string_view input) noexcept -> int64_t {
+    auto parser = kero::peg::PackratParser{grammar_.GetRuleSet()};
+    auto res = parser.Parse(input);
+    return res.IsOk() ? static_cast<int64_t>(*res.Ok()) : -1;
+  }
+
+  auto Error(const std::string_view input) noexcept
+      -> kero::peg::PackratError {
+    auto parser = kero::peg::PackratParser{grammar_.GetRuleSet()};
+    auto res = parser.Parse(input);
+    EXPECT_TRUE(res.IsErr());
+    if (res.IsOk()) {
+      return {kero::peg::PackratErrorCode::kNoMatch, 0};
+    }
+    return *res.Err();
+  }
+
+  auto GetRuleSet() const noexcept -> const kero::peg::ast::RuleSet& {
+    return grammar_.GetRuleSet();
+  }
+
+private:
+  kero::peg::ParsedGrammar grammar_;
+};
+
+} // namespace
+
+TEST(PackratTest, Terminals) {
+  Grammar grammar{"A <- 'ab' [0-9] ."};
+  EXPECT_EQ(grammar.Match("ab1x"), 4);
+  EXPECT_EQ(grammar.Match("ab1xyz"), 4);
+  EXPECT_EQ(grammar.Match("ab1"), -1);
+  EXPECT_EQ(grammar.Match("ax1x"), -1);
+  EXPECT_EQ(grammar.Match("abxx"), -1);
+}
+
+TEST(PackratTest, OrderedChoice) {
+  // The first alternative that matches wins, even if a later one is longer.
+  Grammar grammar{"A <- 'a' / 'ab'"};
+  EXPECT_EQ(grammar.Match("ab"), 1);
+  EXPECT_EQ(grammar.Match("b"), -1);
+}
+
+TEST(PackratTest, Repetition) {
+  Grammar star{"A <- 'a'*"};
+  EXPECT_EQ(star.Match(""), 0);
+  EXPECT_EQ(star.Match("aaab"), 3);
+
+  Grammar plus{"A <- 'a'+"};
+  EXPECT_EQ(plus.Match(""), -1);
+  EXPECT_EQ(plus.Match("aaab"), 3);
+
+  Grammar optional{"A <- 'a'? 'b'"};
+  EXPECT_EQ(optional.Match("ab"), 2);
+  EXPECT_EQ(optional.Match("b"), 1);
+}
+
+TEST(PackratTest, EmptyRepetition) {
+  Grammar star{"A <- ('a'?)*"};
+  EXPECT_EQ(star.Match("aab"), 2);
+  EXPECT_EQ(star.Match("b"), 0);
+
+  Grammar plus{"A <- ('a'?)+"};
+  EXPECT_EQ(plus.Match("b"), 0);
+}
+
+TEST(PackratTest, Predicates) {
+  Grammar grammar{"A <- &'a' [a-z] !'c' ."};
+  EXPECT_EQ(grammar.Match("ab"), 2);
+  EXPECT_EQ(grammar.Match("ac"), -1);
+  EXPECT_EQ(grammar.Match("bb"), -1);
+
+  Grammar end{"A <- 'a'* !."};
+  EXPECT_EQ(end.Match("aaa"), 3);
+  EXPECT_EQ(end.Match("aab"), -1);
+}
+
+TEST(PackratTest, Arithmetic) {
+  Grammar grammar{"Expr <- Sum !.\n"
+                  "Sum <- Product (('+' / '-') Product)*\n"
+                  "Product <- Value (('*' / '/') Value)*\n"
+                  "Value <- [0-9]+ / '(' Sum ')'\n"};
+  EXPECT_EQ(grammar.Match("1"), 1);
+  EXPECT_EQ(grammar.Match("1+2*3"), 5);
+  EXPECT_EQ(grammar.Match("(1+2)*(3-4)/56"), 14);
+  EXPECT_EQ(grammar.Match("((((7))))"), 9);
+  EXPECT_EQ(grammar.Match("1+"), -1);
+  EXPECT_EQ(grammar.Match("(1+2"), -1);
+}
+
+TEST(PackratTest, Backtracking) {
+  // Both alternatives start with the same rule, which the memo table makes
+  // cheap to retry.
+  Grammar grammar{"A <- B 'x' / B 'y'\nB <- [a-c]+\n"};
+  EXPECT_EQ(grammar.Match("abcy"), 4);
+  EXPECT_EQ(grammar.Match("abcz"), -1);
+}
+
+TEST(PackratTest, StartRule) {
+  const Grammar grammar{"A <- 'a' B\nB <- 'b'"};
+  auto packrat = kero::peg::PackratParser{grammar.GetRuleSet(),
+                                          kero::peg::PackratMemoPolicy::kAll};
+  auto res = packrat.Parse("b", 1);
+  ASSERT_TRUE(res.IsOk());
+  EXPECT_EQ(*res.Ok(), 1);
+  EXPECT_EQ(packrat.GetMemoSize(), 4);
+}
+
+TEST(PackratTest, Error) {
+  Grammar grammar{"A <- 'ab' 'cd' / 'a' 'x'"};
+  const auto error = grammar.Error("abce");
+  EXPECT_EQ(error.code, kero::peg::PackratErrorCode::kNoMatch);
+  EXPECT_EQ(error.position, 2);
+}
+
+TEST(PackratTest, LeftRecursion) {
+  Grammar direct{"A <- A 'a' / 'a'"};
+  EXPECT_EQ(direct.Error("aa").code,
+            kero::peg::PackratErrorCode::kLeftRecursion);
+
+  Grammar indirect{"A <- B 'a'\nB <- 'b'? A\n"};
+  EXPECT_EQ(indirect.Error("ba").code,
+            kero::peg::PackratErrorCode::kLeftRecursion);
+}
+
+TEST(PackratTest, DeepNesting) {
+  // Every parenthesis nests a few rules, each of which recurses on the native
+  // stack, so the parse has to stop before the stack runs out.
+  Grammar grammar{"Expr <- Sum !.\n"
+                  "Sum <- Product (('+' / '-') Product)*\n"
+                  "Product <- Value (('*' / '/') Value)*\n"
+                  "Value <- [0-9]+ / '(' Sum ')'\n"};
+  const auto nested = [](const size_t depth) noexcept {
+    return std::string(depth, '(') + "1" + std::string(depth, ')');
+  };
+  EXPECT_EQ(grammar.Match(nested(500)), 1001);
+  EXPECT_EQ(grammar.Error(nested(100000)).code,
+            kero::peg::PackratErrorCode::kStackOverflow);
+}
+
+TEST(PackratTest, LongInput) {
+  Grammar grammar{"List <- Item (',' Item)* !.\nItem <- [a-z]+ / '\"' "
+                  "[a-z ]* '\"'\n"};
+  std::string input{"a"};
+  for (int i = 0; i < 10000; ++i) {
+    input += i % 2 ? ",abc" : ",\"x y\"";
+  }
+  EXPECT_EQ(grammar.Match(input), static_cast<int64_t>(input.size()));
+}
+
+TEST(PackratTest, SelectiveMemo) {
+  const Grammar grammar{"S <- (L ';' / L ',')* !.\nL <- I\nI <- [a-z]+\n"};
+  auto packrat = kero::peg::PackratParser{grammar.GetRuleSet()};
+
+  // I references no rule, so it never gets a column.
+  EXPECT_TRUE(packrat.IsMemoized(0));
+  EXPECT_TRUE(packrat.IsMemoized(1));
+  EXPECT_FALSE(packrat.IsMemoized(2));
+
+  std::string semicolons;
+  std::string commas;
+  for (int i = 0; i < 300; ++i) {
+    semicolons += "ab;";
+    commas += "ab,";
+  }
+
+  // L is called once per item and only hit at the end, so it loses its
+  // column.
+  ASSERT_TRUE(packrat.Parse(semicolons).IsOk());
+  EXPECT_EQ(packrat.GetStats().memo_hits, 1);
+  EXPECT_EQ(packrat.GetStats().memo_misses, 302);
+  EXPECT_EQ(packrat.GetStats().unmemoized_calls, 301);
+  EXPECT_EQ(packrat.GetStats().peak_memo_entries, (semicolons.size() + 1) * 2);
+  EXPECT_FALSE(packrat.IsMemoized(1));
+
+  // Now every item calls L twice at the same position, so it gets it back.
+  ASSERT_TRUE(packrat.Parse(commas).IsOk());
+  EXPECT_EQ(packrat.GetStats().memo_misses, 1);
+  EXPECT_EQ(packrat.GetStats().unmemoized_calls, 602 + 602);
+  EXPECT_EQ(packrat.GetStats().peak_memo_entries, commas.size() + 1);
+  EXPECT_TRUE(packrat.IsMemoized(1));
+
+  ASSERT_TRUE(packrat.Parse(commas).IsOk());
+  EXPECT_EQ(packrat.GetStats().memo_hits, 301);
+  EXPECT_EQ(packrat.GetStats().memo_misses, 302);
+  EXPECT_EQ(packrat.GetStats().peak_memo_entries, (commas.size() + 1) * 2);
+}
+
+TEST(PackratTest, MemoizedRepetitions) {
+  // X is tried at every position and would rescan the rest of the input each
+  // time if its repetition had no column.
+  Grammar grammar{"S <- (X ';' / .)* !.\nX <- 'a'*\n"};
+  const std::string input(10000, 'a');
+  for (const auto policy : {kero::peg::PackratMemoPolicy::kAll,
+                            kero::peg::PackratMemoPolicy::kAdaptive}) {
+    auto packrat = kero::peg::PackratParser{grammar.GetRuleSet(), policy};
+    auto res = packrat.Parse(input);
+    ASSERT_TRUE(res.IsOk());
+    EXPECT_EQ(*res.Ok(), input.size());
+    const auto& stats = packrat.GetStats();
+    EXPECT_LE(stats.memo_misses + stats.unmemoized_calls + stats.iterations,
+              input.size() * 8);
+  }
+}
+
+TEST(PackratTest, BoundedReruns) {
+  // A never hits on the flat input and loses its column, but on nested input
+  // every level tries it twice at the same position.
+  Grammar grammar{"L <- (A ';')* !.\n"
+                  "A <- '(' A ')' 'x' / '(' A ')' 'y' / 'z'\n"};
+  auto packrat = kero::peg::PackratParser{grammar.GetRuleSet()};
+  std::string flat;
+  for (int i = 0; i < 300; ++i) {
+    flat += "z;";
+  }
+  ASSERT_TRUE(packrat.Parse(flat).IsOk());
+  EXPECT_FALSE(packrat.IsMemoized(1));
+
+  std::string nested;
+  for (int i = 0; i < 100; ++i) {
+    nested = "(" + nested + ")y";
+  }
+  nested.insert(100, "z");
+  nested += ";";
+  auto res = packrat.Parse(nested);
+  ASSERT_TRUE(res.IsOk());
+  EXPECT_EQ(*res.Ok(), nested.size());
+  EXPECT_LE(packrat.GetStats().unmemoized_calls,
+            (nested.size() + 1) * kero::peg::kPackratMaxRerunsPerByte + 1);
+  EXPECT_TRUE(packrat.IsMemoized(1));
+}
+
+TEST(PackratTest, PoliciesAgree) {
+  const Grammar grammar{"Expr <- Sum !.\n"
+                       "Sum <- Product (('+' / '-') Product)*\n"
+                       "Product <- Value (('*' / '/') Value)*\n"
+                       "Value <- Number / '(' Sum ')'\n"
+                       "Number <- [0-9]+\n"};
+  auto all = kero::peg::PackratParser{grammar.GetRuleSet(),
+                                      kero::peg::PackratMemoPolicy::kAll};
+  auto adaptive = kero::peg::PackratParser{grammar.GetRuleSet()};
+
+  std::string long_sum{"1"};
+  for (int i = 0; i < 1000; ++i) {
+    long_sum += "+(2*3)";
+  }
+  for (const std::string_view input :
+       {std::string_view{"1+2*3"}, std::string_view{"(1+2"},
+        std::string_view{long_sum}, std::string_view{long_sum}}) {
+    auto expected = all.Parse(input);
+    auto actual = adaptive.Parse(input);
+    ASSERT_EQ(expected.IsOk(), actual.IsOk());
+    if (expected.IsOk()) {
+      EXPECT_EQ(*expected.Ok(), *actual.Ok());
+    } else {
+      EXPECT_EQ(expected.Err()->position, actual.Err()->position);
+    }
+    EXPECT_LT(adaptive.GetStats().peak_memo_entries,
+              all.GetStats().peak_memo_entries);
+  }
+}
+
+TEST(PackratTest, Cut) {
+  Grammar choice{"A <- 'a' ^ 'b' / 'a' 'c'"};
+  EXPECT_EQ(choice.Match("ab"), 2);
+  EXPECT_EQ(choice.Match("ac"), -1);
+
+  Grammar repetition{"A <- ('a' ^ 'b')* 'a'? 'c'"};
+  EXPECT_EQ(repetition.Match("ababc"), 5);
+  EXPECT_EQ(repetition.Match("c"), 1);
+  EXPECT_EQ(repetition.Match("abac"), -1);
+
+  Grammar optional{"A <- ('a' ^ 'b')? 'a' 'c'"};
+  EXPECT_EQ(optional.Match("ac"), -1);
+  EXPECT_EQ(optional.Match("abac"), 4);
+
+  // A cut commits nothing past its rule or predicate.
+  Grammar rule{"A <- B / 'ac'\nB <- 'a' ^ 'b'\n"};
+  EXPECT_EQ(rule.Match("ac"), 2);
+  Grammar predicate{"A <- !('a' ^ 'b') ."};
+  EXPECT_EQ(predicate.Match("ac"), 1);
+  EXPECT_EQ(predicate.Match("ab"), -1);
+}
+
+TEST(PackratTest, CutBoundsMemo) {
+  const Grammar grammar{"File <- (Line ^)* !.\n"
+                       "Line <- Field (',' Field)* [\n]\n"
+                       "Field <- [a-z]*\n"};
+  auto packrat = kero::peg::PackratParser{grammar.GetRuleSet(),
+                                          kero::peg::PackratMemoPolicy::kAll};
+
+  // Once a line is cut, only the rows of the next line are kept, with a
+  // column for each of the three rules and three repetitions.
+  const std::string line{"abc,de,,fgh\n"};
+  for (const auto line_count : {10, 10000}) {
+    std::string input;
+    for (int i = 0; i < line_count; ++i) {
+      input += line;
+    }
+    auto res = packrat.Parse(input);
+    ASSERT_TRUE(res.IsOk());
+    EXPECT_EQ(*res.Ok(), input.size());
+    EXPECT_LE(packrat.GetStats().peak_memo_entries, (line.size() + 1) * 6);
+  }
+}
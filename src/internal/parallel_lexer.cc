@@ -0,0 +1,187 @@
+#include "./parallel_lexer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <limits>
+#include <optional>
+#include <system_error>
+#include <thread>
+
+#include "./scan.h"
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+auto IsInlineWhitespace(const char ch) noexcept -> bool {
+  return ch == ' ' || ch == '\t';
+}
+
+// Matches `[ \t]* Name [ \t]* "<-"` at `position`.
+auto IsRuleStart(const std::string_view source, size_t position) noexcept
+    -> bool {
+  while (position < source.size() && IsInlineWhitespace(source[position])) {
+    ++position;
+  }
+
+  if (position >= source.size() ||
+      !std::isalpha(static_cast<unsigned char>(source[position]))) {
+    return false;
+  }
+
+  ++position;
+  while (position < source.size() &&
+         (std::isalnum(static_cast<unsigned char>(source[position])) ||
+          source[position] == '_')) {
+    ++position;
+  }
+
+  while (position < source.size() && IsInlineWhitespace(source[position])) {
+    ++position;
+  }
+
+  return source.substr(position, 2) == "<-";
+}
+
+struct Chunk {
+  TokenBuffer tokens;
+  size_t start;
+  size_t stop; // where tokenizing stopped, at or after the chunk end
+  std::optional<TokenizeError> error;
+};
+
+// Tokenizes from `start` until the lexer reaches `end`, EndOfInput or an
+// error. EndOfInput itself is not pushed.
+auto TokenizeChunk(const std::string_view source, const size_t start,
+                   const size_t end) noexcept -> Chunk {
+  auto chunk{Chunk{TokenBuffer{source}, start, start, std::nullopt}};
+  auto lexer{Lexer{source, start}};
+  while (lexer.GetPosition() < end) {
+    auto res = lexer.Next();
+    if (res.IsErr()) {
+      chunk.error = *res.Err();
+      break;
+    }
+
+    const auto token = *res.Ok();
+    if (token.kind == TokenKind::kEndOfInput) {
+      break;
+    }
+
+    chunk.tokens.Push(token.kind, token.original_start, token.original.size());
+  }
+
+  chunk.stop = lexer.GetPosition();
+  return chunk;
+}
+
+} // namespace
+
+auto FindRuleBoundaries(const std::string_view source,
+                        const size_t chunk_count) noexcept
+    -> std::vector<size_t> {
+  std::vector<size_t> boundaries;
+  for (size_t k = 1; k < chunk_count; ++k) {
+    auto position = std::max(source.size() / chunk_count * k,
+                             boundaries.empty() ? 0 : boundaries.back());
+    while (true) {
+      const auto found = FindByte(source.substr(position), '\n');
+      if (found == std::string_view::npos) {
+        return boundaries;
+      }
+
+      position += found + 1;
+      if (IsRuleStart(source, position)) {
+        boundaries.push_back(position);
+        break;
+      }
+    }
+  }
+
+  return boundaries;
+}
+
+auto TokenizeParallel(const std::string_view source, const size_t thread_count,
+                      const size_t min_chunk_size) noexcept
+    -> Result<TokenBuffer, TokenizeError> {
+  const auto max_chunk_count =
+      std::max<size_t>(source.size() / std::max<size_t>(min_chunk_size, 1), 1);
+  const auto chunk_count =
+      std::min(std::max<size_t>(thread_count, 1), max_chunk_count);
+  const auto boundaries = FindRuleBoundaries(source, chunk_count);
+  if (boundaries.empty()) {
+    return Lexer{source}.TokenizeAll();
+  }
+
+  if (source.size() > std::numeric_limits<uint32_t>::max()) {
+    return TokenizeError{TokenizeErrorCode::kSourceTooLarge,
+                         Location{0, 1, 1}};
+  }
+
+  const auto chunk_start = [&boundaries](const size_t i) -> size_t {
+    return i == 0 ? 0 : boundaries[i - 1];
+  };
+  const auto chunk_end = [&boundaries, &source](const size_t i) -> size_t {
+    return i < boundaries.size() ? boundaries[i] : source.size();
+  };
+
+  std::vector<std::optional<Chunk>> chunks(boundaries.size() + 1);
+  std::atomic<size_t> next_chunk{};
+  const auto work = [&]() noexcept {
+    while (true) {
+      const auto i = next_chunk.fetch_add(1, std::memory_order_relaxed);
+      if (i >= chunks.size()) {
+        return;
+      }
+
+      chunks[i].emplace(TokenizeChunk(source, chunk_start(i), chunk_end(i)));
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const auto worker_count = std::min(thread_count, chunks.size());
+  workers.reserve(worker_count);
+  for (size_t i = 1; i < worker_count; ++i) {
+    // std::thread reports a thread it cannot start only by throwing. The
+    // chunks are claimed from a shared counter, so the threads already
+    // running, down to this one alone, take the rest.
+    try {
+      workers.emplace_back(work);
+    } catch (const std::system_error&) {
+      break;
+    }
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  auto buffer{TokenBuffer{source}};
+  size_t position{};
+  for (size_t i{}; i < chunks.size(); ++i) {
+    auto& chunk = *chunks[i];
+    if (chunk.start != position) {
+      // The previous chunk ran past this boundary, so this chunk did not
+      // start where the serial lexer would have.
+      assert(chunk.start < position);
+      chunk =
+          TokenizeChunk(source, position, std::max(position, chunk_end(i)));
+    }
+
+    buffer.Append(chunk.tokens);
+    if (chunk.error) {
+      return std::move(*chunk.error);
+    }
+
+    position = chunk.stop;
+  }
+
+  buffer.Push(TokenKind::kEndOfInput, source.size(), 0);
+  return buffer;
+}
+
+} // namespace peg
+} // namespace kero
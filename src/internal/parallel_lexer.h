@@ -0,0 +1,36 @@
+#ifndef KERO_PEG_INTERNAL_PARALLEL_LEXER_H
+#define KERO_PEG_INTERNAL_PARALLEL_LEXER_H
+
+#include <string_view>
+#include <vector>
+
+#include "./core.h"
+#include "./lexer.h"
+
+namespace kero {
+namespace peg {
+
+constexpr size_t kParallelLexerMinChunkSize = 64 * 1024;
+
+// Returns up to `chunk_count - 1` ascending split positions. Each one is the
+// start of a line that begins a rule, i.e. a newline followed by a
+// NonTerminal and `<-`, as in docs/grammar.py.
+auto FindRuleBoundaries(const std::string_view source,
+                        const size_t chunk_count) noexcept
+    -> std::vector<size_t>;
+
+// Tokenizes `source` in chunks on `thread_count` threads and stitches them
+// into one stream. The result is the same as calling Lexer::Next until
+// EndOfInput or the first error: a chunk whose start was not reached by the
+// previous chunk (e.g. the boundary was inside a quoted terminal) is
+// tokenized again from where the previous chunk stopped. If threads cannot
+// be started, the calling thread tokenizes the chunks they would have taken.
+auto TokenizeParallel(
+    const std::string_view source, const size_t thread_count,
+    const size_t min_chunk_size = kParallelLexerMinChunkSize) noexcept
+    -> Result<TokenBuffer, TokenizeError>;
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_PARALLEL_LEXER_H
@@ -0,0 +1,94 @@
+#include "./parallel_lexer.h"
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+auto ExpectSameAsSerial(const std::string_view source, const size_t threads,
+                        const size_t min_chunk_size) noexcept -> void {
+  auto parallel_res =
+      kero::peg::TokenizeParallel(source, threads, min_chunk_size);
+  auto lexer{kero::peg::Lexer{source}};
+  if (parallel_res.IsErr()) {
+    const auto error = *parallel_res.Err();
+    while (true) {
+      auto token_res = lexer.Next();
+      if (token_res.IsErr()) {
+        const auto expected = *token_res.Err();
+        EXPECT_EQ(error.code, expected.code);
+        EXPECT_EQ(error.location.position, expected.location.position);
+        EXPECT_EQ(error.location.line, expected.location.line);
+        EXPECT_EQ(error.location.column, expected.location.column);
+        return;
+      }
+      ASSERT_NE(token_res.Ok()->kind, kero::peg::TokenKind::kEndOfInput)
+          << source;
+    }
+  }
+
+  const auto buffer = std::move(*parallel_res.Ok());
+  for (size_t i{}; i < buffer.Size(); ++i) {
+    auto token_res = lexer.Next();
+    ASSERT_TRUE(token_res.IsOk()) << source;
+    const auto expected = *token_res.Ok();
+    const auto token = buffer.GetToken(i);
+    ASSERT_EQ(token.kind, expected.kind) << source;
+    ASSERT_EQ(token.original_start, expected.original_start) << source;
+    ASSERT_EQ(token.original_end, expected.original_end) << source;
+    ASSERT_EQ(token.value, expected.value) << source;
+  }
+  ASSERT_GT(buffer.Size(), 0);
+  EXPECT_EQ(buffer.GetKind(buffer.Size() - 1),
+            kero::peg::TokenKind::kEndOfInput);
+}
+
+TEST(ParallelLexerTest, FindRuleBoundaries) {
+  const std::string_view source{"A <- B\n"
+                                "  'x\n"
+                                "C <- D\n"
+                                "E <- F\n"};
+  const auto boundaries = kero::peg::FindRuleBoundaries(source, 8);
+  ASSERT_EQ(boundaries.size(), 2);
+  EXPECT_EQ(boundaries[0], 12);
+  EXPECT_EQ(boundaries[1], 19);
+}
+
+TEST(ParallelLexerTest, BoundaryInsideQuotedTerminal) {
+  ExpectSameAsSerial("A <- 'x\nB <- y'\nC <- D\n", 4, 1);
+}
+
+TEST(ParallelLexerTest, ErrorInLaterChunk) {
+  ExpectSameAsSerial("A <- B\nC <- [b-a]\nD <- E\n", 4, 1);
+  ExpectSameAsSerial("A <- B\nC <- @\nD <- E\n", 4, 1);
+}
+
+TEST(ParallelLexerTest, Randomized) {
+  // Multi-line terminals put rule-like lines inside a single token.
+  constexpr std::string_view kPieces[] = {
+      "A",           "Rule_1",        "<-",         "'a'",       "\"b c\"",
+      "[a-z0-9]",    "(",             ")",          "/",         "*",
+      "+",           "?",             "&",          "!",         ".",
+      "^",           " ",             "\t",         "\n",        "\r\n",
+      "\nR <- ",     "\n  N <- ",     "'x\nQ <- y'", "\"\nP <- \"", "[\nO <- ]",
+      "[b-a]",       "@",
+  };
+  auto rng{std::mt19937{7}};
+  auto piece{std::uniform_int_distribution<size_t>{0, std::size(kPieces) - 1}};
+  auto length{std::uniform_int_distribution<size_t>{0, 200}};
+  for (size_t round{}; round < 500; ++round) {
+    std::string source;
+    const auto size = length(rng);
+    for (size_t i{}; i < size; ++i) {
+      // Keep most inputs valid so the stitched stream is long.
+      const auto index = piece(rng);
+      if ((kPieces[index] == "@" || kPieces[index] == "[b-a]") &&
+          round % 4 != 0) {
+        continue;
+      }
+      source += kPieces[index];
+      source += ' ';
+    }
+    ExpectSameAsSerial(source, 1 + round % 4, 1 + round % 32);
+  }
+}
@@ -0,0 +1,155 @@
+#include "./scan.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERO_PEG_SCAN_X86_64
+#include <immintrin.h>
+#endif
+
+namespace kero {
+namespace peg {
+
+namespace {
+
+auto FindByteScalar(const std::string_view haystack, const char needle) noexcept
+    -> size_t {
+  for (size_t i{}; i < haystack.size(); ++i) {
+    if (haystack[i] == needle) {
+      return i;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+auto FindByteMemchr(const std::string_view haystack, const char needle) noexcept
+    -> size_t {
+  if (haystack.empty()) {
+    return std::string_view::npos;
+  }
+
+  const auto found = std::memchr(haystack.data(), needle, haystack.size());
+  if (!found) {
+    return std::string_view::npos;
+  }
+
+  return static_cast<size_t>(static_cast<const char*>(found) - haystack.data());
+}
+
+#ifdef KERO_PEG_SCAN_X86_64
+
+auto FindByteSse2(const std::string_view haystack, const char needle) noexcept
+    -> size_t {
+  const auto data = haystack.data();
+  const auto size = haystack.size();
+  const auto pattern = _mm_set1_epi8(needle);
+  size_t i{};
+  for (; i + 16 <= size; i += 16) {
+    const auto chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const auto mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+    if (mask != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+  }
+
+  if (const auto found = FindByteScalar(haystack.substr(i), needle);
+      found != std::string_view::npos) {
+    return i + found;
+  }
+
+  return std::string_view::npos;
+}
+
+__attribute__((target("avx2"))) auto
+FindByteAvx2(const std::string_view haystack, const char needle) noexcept
+    -> size_t {
+  const auto data = haystack.data();
+  const auto size = haystack.size();
+  const auto pattern = _mm256_set1_epi8(needle);
+  size_t i{};
+  for (; i + 32 <= size; i += 32) {
+    const auto chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    const auto mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern)));
+    if (mask != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+  }
+
+  if (const auto found = FindByteSse2(haystack.substr(i), needle);
+      found != std::string_view::npos) {
+    return i + found;
+  }
+
+  return std::string_view::npos;
+}
+
+#endif // KERO_PEG_SCAN_X86_64
+
+auto DetectScanMode() noexcept -> ScanMode {
+#ifdef KERO_PEG_SCAN_X86_64
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanMode::kAvx2;
+  }
+
+  return ScanMode::kSse2;
+#else
+  return ScanMode::kMemchr;
+#endif
+}
+
+} // namespace
+
+auto GetScanMode() noexcept -> ScanMode {
+  static const auto mode = DetectScanMode();
+  return mode;
+}
+
+auto IsScanModeSupported(const ScanMode mode) noexcept -> bool {
+  switch (mode) {
+  case ScanMode::kScalar:
+  case ScanMode::kMemchr:
+    return true;
+  case ScanMode::kSse2:
+  case ScanMode::kAvx2:
+    return GetScanMode() >= mode;
+  }
+
+  return false;
+}
+
+auto FindByte(const std::string_view haystack, const char needle) noexcept
+    -> size_t {
+  return FindByte(haystack, needle, GetScanMode());
+}
+
+auto FindByte(const std::string_view haystack, const char needle,
+              const ScanMode mode) noexcept -> size_t {
+  assert(IsScanModeSupported(mode));
+  switch (mode) {
+  case ScanMode::kScalar:
+    return FindByteScalar(haystack, needle);
+  case ScanMode::kMemchr:
+    return FindByteMemchr(haystack, needle);
+#ifdef KERO_PEG_SCAN_X86_64
+  case ScanMode::kSse2:
+    return FindByteSse2(haystack, needle);
+  case ScanMode::kAvx2:
+    return FindByteAvx2(haystack, needle);
+#else
+  case ScanMode::kSse2:
+  case ScanMode::kAvx2:
+    break;
+#endif
+  }
+
+  return FindByteMemchr(haystack, needle);
+}
+
+} // namespace peg
+} // namespace kero
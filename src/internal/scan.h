@@ -0,0 +1,33 @@
+#ifndef KERO_PEG_INTERNAL_SCAN_H
+#define KERO_PEG_INTERNAL_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace kero {
+namespace peg {
+
+enum class ScanMode : int32_t {
+  kScalar = 0,
+  kMemchr,
+  kSse2,
+  kAvx2,
+};
+
+// The fastest mode supported by the running CPU.
+auto GetScanMode() noexcept -> ScanMode;
+
+auto IsScanModeSupported(const ScanMode mode) noexcept -> bool;
+
+// Returns the index of the first `needle` in `haystack`, or
+// std::string_view::npos. `FindByte` dispatches to `GetScanMode()`.
+auto FindByte(const std::string_view haystack, const char needle) noexcept
+    -> size_t;
+auto FindByte(const std::string_view haystack, const char needle,
+              const ScanMode mode) noexcept -> size_t;
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_SCAN_H
@@ -0,0 +1,69 @@
+#include "./scan.h"
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+constexpr kero::peg::ScanMode kScanModes[] = {
+    kero::peg::ScanMode::kScalar,
+    kero::peg::ScanMode::kMemchr,
+    kero::peg::ScanMode::kSse2,
+    kero::peg::ScanMode::kAvx2,
+};
+
+TEST(ScanTest, FindByteEmpty) {
+  for (const auto mode : kScanModes) {
+    if (!kero::peg::IsScanModeSupported(mode)) {
+      continue;
+    }
+    EXPECT_EQ(kero::peg::FindByte("", 'a', mode), std::string_view::npos);
+  }
+}
+
+TEST(ScanTest, FindByteEveryPosition) {
+  for (size_t size = 1; size < 100; ++size) {
+    for (size_t at{}; at < size; ++at) {
+      auto haystack = std::string(size, 'a');
+      haystack[at] = '\'';
+      for (const auto mode : kScanModes) {
+        if (!kero::peg::IsScanModeSupported(mode)) {
+          continue;
+        }
+        EXPECT_EQ(kero::peg::FindByte(haystack, '\'', mode), at);
+        EXPECT_EQ(kero::peg::FindByte(haystack, '"', mode),
+                  std::string_view::npos);
+      }
+    }
+  }
+}
+
+TEST(ScanTest, FindByteDifferential) {
+  auto rng{std::mt19937{42}};
+  auto byte{std::uniform_int_distribution<int>{0, 255}};
+  auto size{std::uniform_int_distribution<size_t>{0, 300}};
+  for (size_t round{}; round < 1000; ++round) {
+    auto haystack = std::string(size(rng), '\0');
+    for (auto& ch : haystack) {
+      ch = static_cast<char>(byte(rng));
+    }
+    // Probe from every offset so unaligned loads are covered.
+    const auto needle = static_cast<char>(byte(rng));
+    for (size_t offset{}; offset < std::min<size_t>(haystack.size(), 33);
+         ++offset) {
+      const auto view = std::string_view{haystack}.substr(offset);
+      const auto expected =
+          kero::peg::FindByte(view, needle, kero::peg::ScanMode::kScalar);
+      for (const auto mode : kScanModes) {
+        if (!kero::peg::IsScanModeSupported(mode)) {
+          continue;
+        }
+        EXPECT_EQ(kero::peg::FindByte(view, needle, mode), expected);
+      }
+    }
+  }
+}
+
+TEST(ScanTest, GetScanModeSupported) {
+  EXPECT_TRUE(kero::peg::IsScanModeSupported(kero::peg::GetScanMode()));
+}
@@ -0,0 +1,570 @@
+#ifndef KERO_PEG_INTERNAL_STATIC_LEXER_H
+#define KERO_PEG_INTERNAL_STATIC_LEXER_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "./core.h"
+#include "./lexer.h"
+#include "./scan.h"
+
+namespace kero {
+namespace peg {
+
+// ASCII only, like the "C" locale the <cctype> functions use by default.
+constexpr auto IsDigit(const char ch) noexcept -> bool {
+  return ch >= '0' && ch <= '9';
+}
+
+constexpr auto IsLower(const char ch) noexcept -> bool {
+  return ch >= 'a' && ch <= 'z';
+}
+
+constexpr auto IsUpper(const char ch) noexcept -> bool {
+  return ch >= 'A' && ch <= 'Z';
+}
+
+constexpr auto IsAlpha(const char ch) noexcept -> bool {
+  return IsLower(ch) || IsUpper(ch);
+}
+
+constexpr auto IsAlnum(const char ch) noexcept -> bool {
+  return IsAlpha(ch) || IsDigit(ch);
+}
+
+// Same result as LineIndex::GetLocation, by walking the source. Used where a
+// LineIndex cannot be built, e.g. at compile time.
+constexpr auto ComputeLocation(const std::string_view source,
+                               const size_t position) noexcept -> Location {
+  size_t line{1};
+  size_t column{1};
+  for (size_t i{}; i < position; ++i) {
+    if (source[i] == '\r') {
+      continue;
+    }
+
+    if (source[i] == '\n') {
+      ++line;
+      column = 1;
+    } else {
+      ++column;
+    }
+  }
+
+  return Location{position, line, column};
+}
+
+// Position based error of a matcher. The lexer turns it into a TokenizeError.
+struct MatcherError {
+  TokenizeErrorCode code;
+  size_t position;
+};
+
+// Matchers used by both Lexer and StaticLexer. Each one provides:
+//   kKind, kSkip
+//   IsFirst(ch): whether a match can start with `ch`. A matcher that accepts
+//     no byte only matches at the end of input.
+//   Match(source, position): the matched text, if any.
+//   Parse(source, original): optional, the token value or an error.
+namespace matcher {
+
+template <TokenKind Kind, char Ch> struct Char {
+  static constexpr TokenKind kKind = Kind;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return ch == Ch;
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    if (position < source.size() && source[position] == Ch) {
+      return source.substr(position, 1);
+    }
+
+    return std::nullopt;
+  }
+};
+
+struct EndOfInput {
+  static constexpr TokenKind kKind = TokenKind::kEndOfInput;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char) noexcept -> bool { return false; }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    if (position < source.size()) {
+      return std::nullopt;
+    }
+
+    return source.substr(position, 0);
+  }
+};
+
+struct Whitespace {
+  static constexpr TokenKind kKind = TokenKind::kWhitespace;
+  static constexpr bool kSkip = true;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return ch == ' ' || ch == '\t';
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    if (position < source.size() && IsFirst(source[position])) {
+      return source.substr(position, 1);
+    }
+
+    return std::nullopt;
+  }
+};
+
+struct NewLine {
+  static constexpr TokenKind kKind = TokenKind::kNewLine;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return ch == '\n' || ch == '\r';
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    const auto rest = source.substr(position);
+    if (rest.starts_with('\n')) {
+      return rest.substr(0, 1);
+    }
+
+    if (rest.starts_with("\r\n")) {
+      return rest.substr(0, 2);
+    }
+
+    return std::nullopt;
+  }
+};
+
+struct LeftArrow {
+  static constexpr TokenKind kKind = TokenKind::kLeftArrow;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return ch == '<';
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    const auto rest = source.substr(position);
+    if (rest.starts_with("<-")) {
+      return rest.substr(0, 2);
+    }
+
+    return std::nullopt;
+  }
+};
+
+// Text from `open` up to and including the next `close`.
+constexpr auto MatchAround(const std::string_view source, const size_t position,
+                           const char close) noexcept
+    -> std::optional<std::string_view> {
+  const auto rest = source.substr(position + 1);
+  size_t found{std::string_view::npos};
+  if (std::is_constant_evaluated()) {
+    found = rest.find(close);
+  } else {
+    found = FindByte(rest, close);
+  }
+
+  if (found == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  return source.substr(position, found + 2);
+}
+
+struct QuotedTerminal {
+  static constexpr TokenKind kKind = TokenKind::kQuotedTerminal;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return ch == '\'' || ch == '"';
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    if (position < source.size() && IsFirst(source[position])) {
+      return MatchAround(source, position, source[position]);
+    }
+
+    return std::nullopt;
+  }
+
+  static constexpr auto Parse(const std::string_view,
+                              const std::string_view original) noexcept
+      -> Result<std::string_view, MatcherError> {
+    return original.substr(1, original.size() - 2);
+  }
+};
+
+struct BracketedTerminal {
+  static constexpr TokenKind kKind = TokenKind::kBracketedTerminal;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return ch == '[';
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    if (position < source.size() && IsFirst(source[position])) {
+      return MatchAround(source, position, ']');
+    }
+
+    return std::nullopt;
+  }
+
+  // Validates ranges like `a-z`, `A-Z` and `0-9`.
+  static constexpr auto Parse(const std::string_view source,
+                              const std::string_view original) noexcept
+      -> Result<std::string_view, MatcherError> {
+    auto value{original.substr(1, original.size() - 2)};
+    const auto value_start =
+        static_cast<size_t>(original.data() - source.data()) + 1;
+
+    if (value.empty()) {
+      return MatcherError{TokenizeErrorCode::kBracketedTerminalEmpty,
+                          value_start};
+    }
+
+    for (size_t i = 0; i < value.size(); ++i) {
+      if (value[i] != '-') {
+        continue;
+      }
+
+      const auto error = [value_start, i](const TokenizeErrorCode code)
+          -> Result<std::string_view, MatcherError> {
+        return MatcherError{code, value_start + i};
+      };
+
+      if (i == 0) {
+        return error(
+            TokenizeErrorCode::kBracketedTerminalMinusSignLeftNotFound);
+      }
+
+      if (i == value.size() - 1) {
+        return error(
+            TokenizeErrorCode::kBracketedTerminalMinusSignRightNotFound);
+      }
+
+      const auto left = value[i - 1];
+      const auto right = value[i + 1];
+      if (IsDigit(left)) {
+        if (!IsDigit(right)) {
+          return error(
+              TokenizeErrorCode::kBracketedTerminalMinusSignRightNotNumber);
+        }
+
+        if (left == right) {
+          return error(TokenizeErrorCode::
+                           kBracketedTerminalMinusSignRightNumberEqualWithLeft);
+        }
+
+        if (left > right) {
+          return error(TokenizeErrorCode::
+                           kBracketedTerminalMinusSignRightNumberLessThanLeft);
+        }
+      } else if (IsLower(left)) {
+        if (!IsLower(right)) {
+          return error(
+              TokenizeErrorCode::kBracketedTerminalMinusSignRightNotLowercase);
+        }
+
+        if (left == right) {
+          return error(
+              TokenizeErrorCode::
+                  kBracketedTerminalMinusSignRightLowercaseEqualWithLeft);
+        }
+
+        if (left > right) {
+          return error(
+              TokenizeErrorCode::
+                  kBracketedTerminalMinusSignRightLowercaseLessThanLeft);
+        }
+      } else if (IsUpper(left)) {
+        if (!IsUpper(right)) {
+          return error(
+              TokenizeErrorCode::kBracketedTerminalMinusSignRightNotUppercase);
+        }
+
+        if (left == right) {
+          return error(
+              TokenizeErrorCode::
+                  kBracketedTerminalMinusSignRightUppercaseEqualWithLeft);
+        }
+
+        if (left > right) {
+          return error(
+              TokenizeErrorCode::
+                  kBracketedTerminalMinusSignRightUppercaseLessThanLeft);
+        }
+      }
+    }
+
+    return value;
+  }
+};
+
+struct NonTerminal {
+  static constexpr TokenKind kKind = TokenKind::kNonTerminal;
+  static constexpr bool kSkip = false;
+
+  static constexpr auto IsFirst(const char ch) noexcept -> bool {
+    return IsAlpha(ch);
+  }
+
+  static constexpr auto Match(const std::string_view source,
+                              const size_t position) noexcept
+      -> std::optional<std::string_view> {
+    if (position >= source.size() || !IsFirst(source[position])) {
+      return std::nullopt;
+    }
+
+    auto end = position + 1;
+    while (end < source.size() &&
+           (IsAlnum(source[end]) || source[end] == '_')) {
+      ++end;
+    }
+
+    return source.substr(position, end - position);
+  }
+};
+
+template <typename Matcher>
+concept HasParse = requires(const std::string_view text) {
+  Matcher::Parse(text, text);
+};
+
+template <typename Matcher>
+constexpr auto IsEndOfInputMatcher() noexcept -> bool {
+  for (int ch{}; ch < 256; ++ch) {
+    if (Matcher::IsFirst(static_cast<char>(ch))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template <typename Matcher>
+inline constexpr bool kIsEndOfInputMatcher = IsEndOfInputMatcher<Matcher>();
+
+template <typename... Matchers> struct List {};
+
+// The matchers of the PEG grammar in docs/grammar.py, in priority order.
+using Default = List<EndOfInput, Whitespace, NewLine, LeftArrow,
+                     Char<TokenKind::kLeftParenthesis, '('>,
+                     Char<TokenKind::kRightParenthesis, ')'>,
+                     Char<TokenKind::kAsterisk, '*'>,
+                     Char<TokenKind::kPlus, '+'>,
+                     Char<TokenKind::kQuestionMark, '?'>,
+                     Char<TokenKind::kAmpersand, '&'>,
+                     Char<TokenKind::kExclamationMark, '!'>,
+                     Char<TokenKind::kSlash, '/'>, Char<TokenKind::kDot, '.'>,
+                     Char<TokenKind::kCaret, '^'>, QuotedTerminal,
+                     BracketedTerminal, NonTerminal>;
+
+} // namespace matcher
+
+// Lexer whose matcher set is fixed at compile time. The first byte of the
+// input selects the candidate matchers from a constant table, and Next()
+// switches on the candidate index into fully inlined matchers, so there are
+// no indirect calls. The whole lexer can run in constant evaluation.
+template <typename... Matchers> class StaticLexer {
+public:
+  static_assert(sizeof...(Matchers) <= 32, "Candidates are a 32-bit mask");
+
+  constexpr StaticLexer(const std::string_view source) noexcept
+      : source_{source} {}
+
+  constexpr auto Next() noexcept -> Result<Token, TokenizeError> {
+    while (true) {
+      const auto start = position_;
+      auto candidates =
+          kCandidates[start < source_.size()
+                          ? static_cast<unsigned char>(source_[start])
+                          : kEndOfInputIndex];
+      std::optional<Token> token;
+      std::optional<TokenizeError> error;
+      bool skip{};
+      bool matched{};
+      while (candidates != 0 && !matched) {
+        const auto index = static_cast<size_t>(std::countr_zero(candidates));
+        candidates &= candidates - 1;
+        matched = TryMatchAt(index, start, token, error, skip,
+                             std::index_sequence_for<Matchers...>{});
+      }
+
+      if (!matched) {
+        return TokenizeError{TokenizeErrorCode::kMatchFailed,
+                             GetLocation(start)};
+      }
+
+      if (skip) {
+        continue;
+      }
+
+      if (error) {
+        return std::move(*error);
+      }
+
+      return std::move(*token);
+    }
+  }
+
+  constexpr auto GetPosition() const noexcept -> size_t { return position_; }
+
+  constexpr auto GetLocation(const size_t position) const noexcept
+      -> Location {
+    return ComputeLocation(source_, position);
+  }
+
+private:
+  static constexpr size_t kEndOfInputIndex = 256;
+
+  // Bit i of entry ch is set if matcher i can start with ch. The last entry
+  // is for the end of input.
+  static constexpr auto kCandidates = [] {
+    std::array<uint32_t, kEndOfInputIndex + 1> candidates{};
+    uint32_t bit{1};
+    (
+        [&candidates, &bit] {
+          for (size_t ch{}; ch < kEndOfInputIndex; ++ch) {
+            if (Matchers::IsFirst(static_cast<char>(ch))) {
+              candidates[ch] |= bit;
+            }
+          }
+
+          if (matcher::kIsEndOfInputMatcher<Matchers>) {
+            candidates[kEndOfInputIndex] |= bit;
+          }
+
+          bit <<= 1;
+        }(),
+        ...);
+    return candidates;
+  }();
+
+  template <size_t... Indices>
+  constexpr auto TryMatchAt(const size_t index, const size_t start,
+                            std::optional<Token>& token,
+                            std::optional<TokenizeError>& error, bool& skip,
+                            std::index_sequence<Indices...>) noexcept -> bool {
+    return ((index == Indices &&
+             TryMatch<Matchers>(start, token, error, skip)) ||
+            ...);
+  }
+
+  template <typename Matcher>
+  constexpr auto TryMatch(const size_t start, std::optional<Token>& token,
+                          std::optional<TokenizeError>& error,
+                          bool& skip) noexcept -> bool {
+    const auto original = Matcher::Match(source_, start);
+    if (!original) {
+      return false;
+    }
+
+    position_ = start + original->size();
+    if constexpr (Matcher::kSkip) {
+      skip = true;
+      return true;
+    }
+
+    auto value = *original;
+    if constexpr (matcher::HasParse<Matcher>) {
+      auto res = Matcher::Parse(source_, *original);
+      if (res.IsErr()) {
+        const auto matcher_error = *res.Err();
+        error.emplace(matcher_error.code,
+                      GetLocation(matcher_error.position));
+        return true;
+      }
+
+      value = *res.Ok();
+    }
+
+    token = Token{start, position_, *original, value, Matcher::kKind};
+    return true;
+  }
+
+  std::string_view source_;
+  size_t position_{};
+};
+
+template <typename List> struct StaticLexerOf;
+
+template <typename... Matchers>
+struct StaticLexerOf<matcher::List<Matchers...>> {
+  using Type = StaticLexer<Matchers...>;
+};
+
+using DefaultStaticLexer = StaticLexerOf<matcher::Default>::Type;
+
+template <size_t Size> struct StaticTokens {
+  std::array<Token, Size> tokens{};
+  std::optional<TokenizeError> error;
+};
+
+// Number of tokens up to and including EndOfInput, or up to the first error.
+constexpr auto CountStaticTokens(const std::string_view source) noexcept
+    -> size_t {
+  auto lexer{DefaultStaticLexer{source}};
+  size_t count{};
+  while (true) {
+    auto res = lexer.Next();
+    if (res.IsErr()) {
+      return count;
+    }
+
+    ++count;
+    if (res.Ok()->kind == TokenKind::kEndOfInput) {
+      return count;
+    }
+  }
+}
+
+// Tokenizes `Source` at compile time, e.g.
+//   constexpr auto tokens = TokenizeAtCompileTime<"A <- 'b'">();
+//   static_assert(!tokens.error);
+template <FixedString Source>
+consteval auto TokenizeAtCompileTime() noexcept {
+  constexpr auto source = Source.View();
+  StaticTokens<CountStaticTokens(source)> result;
+  auto lexer{DefaultStaticLexer{source}};
+  for (auto& token : result.tokens) {
+    token = *lexer.Next().Ok();
+  }
+
+  if (result.tokens.empty() ||
+      result.tokens.back().kind != TokenKind::kEndOfInput) {
+    result.error = *lexer.Next().Err();
+  }
+
+  return result;
+}
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_STATIC_LEXER_H
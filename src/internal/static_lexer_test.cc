@@ -0,0 +1,78 @@
+#include "./static_lexer.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+constexpr auto kTokens =
+    kero::peg::TokenizeAtCompileTime<"A <- 'b' / [c-d]*">();
+static_assert(!kTokens.error);
+static_assert(kTokens.tokens.size() == 7);
+static_assert(kTokens.tokens[0].kind == kero::peg::TokenKind::kNonTerminal);
+static_assert(kTokens.tokens[0].value == "A");
+static_assert(kTokens.tokens[1].kind == kero::peg::TokenKind::kLeftArrow);
+static_assert(kTokens.tokens[2].kind == kero::peg::TokenKind::kQuotedTerminal);
+static_assert(kTokens.tokens[2].value == "b");
+static_assert(kTokens.tokens[3].kind == kero::peg::TokenKind::kSlash);
+static_assert(kTokens.tokens[4].value == "c-d");
+static_assert(kTokens.tokens[4].original_start == 11);
+static_assert(kTokens.tokens[5].kind == kero::peg::TokenKind::kAsterisk);
+static_assert(kTokens.tokens[6].kind == kero::peg::TokenKind::kEndOfInput);
+
+constexpr auto kErrorTokens = kero::peg::TokenizeAtCompileTime<"A <-\n[b-a]">();
+static_assert(kErrorTokens.tokens.size() == 3);
+static_assert(kErrorTokens.error->code ==
+              kero::peg::TokenizeErrorCode::
+                  kBracketedTerminalMinusSignRightLowercaseLessThanLeft);
+static_assert(kErrorTokens.error->location.line == 2);
+static_assert(kErrorTokens.error->location.column == 3);
+
+auto ExpectSameAsLexer(const std::string_view source) noexcept -> void {
+  auto lexer{kero::peg::Lexer{source}};
+  auto static_lexer{kero::peg::DefaultStaticLexer{source}};
+  while (true) {
+    auto expected_res = lexer.Next();
+    auto res = static_lexer.Next();
+    ASSERT_EQ(res.IsOk(), expected_res.IsOk()) << source;
+    if (res.IsErr()) {
+      const auto expected = *expected_res.Err();
+      const auto error = *res.Err();
+      EXPECT_EQ(error.code, expected.code) << source;
+      EXPECT_EQ(error.location.position, expected.location.position);
+      EXPECT_EQ(error.location.line, expected.location.line);
+      EXPECT_EQ(error.location.column, expected.location.column);
+      return;
+    }
+
+    const auto expected = *expected_res.Ok();
+    const auto token = *res.Ok();
+    EXPECT_EQ(token.kind, expected.kind) << source;
+    EXPECT_EQ(token.original_start, expected.original_start) << source;
+    EXPECT_EQ(token.original_end, expected.original_end) << source;
+    EXPECT_EQ(token.value, expected.value) << source;
+    if (token.kind == kero::peg::TokenKind::kEndOfInput) {
+      return;
+    }
+  }
+}
+
+TEST(StaticLexerTest, SameAsLexer) {
+  ExpectSameAsLexer("Expr <- Sum\n"
+                    "Sum <- Product (('+' / '-') Product)*\n"
+                    "Product <- Power (('*' / '/') Power)*\n"
+                    "Power <- Value ('^' Power)?\n"
+                    "Value <- [0-9]+ / '(' Expr ')' / &. !\"x\"\r\n");
+  ExpectSameAsLexer("");
+  ExpectSameAsLexer(" \t");
+  ExpectSameAsLexer("A <- 'b");
+  ExpectSameAsLexer("A <- @");
+  ExpectSameAsLexer("A <- \r");
+}
+
+TEST(StaticLexerTest, SameAsLexerBracketedTerminalErrors) {
+  for (const auto source : {"[]", "[-a]", "[a-]", "[0-a]", "[0-0]", "[1-0]",
+                            "[a-A]", "[a-a]", "[b-a]", "[A-a]", "[A-A]",
+                            "[B-A]", "[_-a]", "[a-z0-9_]"}) {
+    ExpectSameAsLexer(source);
+  }
+}
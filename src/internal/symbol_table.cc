@@ -0,0 +1,72 @@
+#include "./symbol_table.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+namespace kero {
+namespace peg {
+
+constexpr size_t kSymbolTableMinSlots = 64;
+
+auto SymbolTable::Intern(const std::string_view name) noexcept -> uint32_t {
+  // Keep the load factor at most 1/2 so probe sequences stay short.
+  if (2 * (names_.size() + 1) > slots_.size()) {
+    Grow();
+  }
+
+  const auto slot = FindSlot(name);
+  if (slots_[slot] == kNoSymbol) {
+    assert(names_.size() < kNoSymbol);
+    slots_[slot] = static_cast<uint32_t>(names_.size());
+    names_.push_back(name);
+  }
+  return slots_[slot];
+}
+
+auto SymbolTable::Find(const std::string_view name) const noexcept
+    -> std::optional<uint32_t> {
+  if (slots_.empty()) {
+    return std::nullopt;
+  }
+
+  if (const auto symbol = slots_[FindSlot(name)]; symbol != kNoSymbol) {
+    return symbol;
+  }
+  return std::nullopt;
+}
+
+auto SymbolTable::GetName(const uint32_t symbol) const noexcept
+    -> std::string_view {
+  assert(symbol < names_.size());
+  return names_[symbol];
+}
+
+auto SymbolTable::Size() const noexcept -> size_t { return names_.size(); }
+
+auto SymbolTable::Clear() noexcept -> void {
+  std::fill(slots_.begin(), slots_.end(), kNoSymbol);
+  names_.clear();
+}
+
+auto SymbolTable::FindSlot(const std::string_view name) const noexcept
+    -> size_t {
+  assert(!slots_.empty());
+  const auto mask = slots_.size() - 1;
+  auto slot = std::hash<std::string_view>{}(name) & mask;
+  while (slots_[slot] != kNoSymbol && names_[slots_[slot]] != name) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+auto SymbolTable::Grow() noexcept -> void {
+  const auto size = slots_.empty() ? kSymbolTableMinSlots : 2 * slots_.size();
+  slots_.assign(size, kNoSymbol);
+  for (uint32_t symbol{}; symbol < names_.size(); ++symbol) {
+    slots_[FindSlot(names_[symbol])] = symbol;
+  }
+}
+
+} // namespace peg
+} // namespace kero
@@ -0,0 +1,54 @@
+#ifndef KERO_PEG_INTERNAL_SYMBOL_TABLE_H
+#define KERO_PEG_INTERNAL_SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace kero {
+namespace peg {
+
+constexpr uint32_t kNoSymbol = std::numeric_limits<uint32_t>::max();
+
+// Interns names to dense ids 0, 1, 2, ... in order of first appearance, so
+// anything keyed by name can be a vector indexed by id. Names are views into
+// the caller's source, which must outlive the table. Lookup is an
+// open-addressing hash table of ids, so interning allocates only when the
+// table grows.
+class SymbolTable {
+public:
+  SymbolTable() noexcept = default;
+  SymbolTable(SymbolTable&&) noexcept = default;
+  ~SymbolTable() = default;
+  auto operator=(SymbolTable&&) noexcept -> SymbolTable& = default;
+
+  SymbolTable(const SymbolTable&) = delete;
+  auto operator=(const SymbolTable&) -> SymbolTable& = delete;
+
+  // Returns the id of `name`, assigning the next one if it is new.
+  auto Intern(const std::string_view name) noexcept -> uint32_t;
+
+  auto Find(const std::string_view name) const noexcept
+      -> std::optional<uint32_t>;
+
+  auto GetName(const uint32_t symbol) const noexcept -> std::string_view;
+
+  auto Size() const noexcept -> size_t;
+
+  auto Clear() noexcept -> void;
+
+private:
+  // The slot holding `name`, or the empty slot where it would go.
+  auto FindSlot(const std::string_view name) const noexcept -> size_t;
+  auto Grow() noexcept -> void;
+
+  std::vector<uint32_t> slots_; // kNoSymbol if empty, size is a power of two
+  std::vector<std::string_view> names_;
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_SYMBOL_TABLE_H
@@ -0,0 +1,51 @@
+#include "./symbol_table.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(SymbolTableTest, Empty) {
+  const kero::peg::SymbolTable symbols;
+  EXPECT_EQ(symbols.Size(), 0);
+  EXPECT_FALSE(symbols.Find("A").has_value());
+}
+
+TEST(SymbolTableTest, Intern) {
+  kero::peg::SymbolTable symbols;
+  EXPECT_EQ(symbols.Intern("A"), 0);
+  EXPECT_EQ(symbols.Intern("B"), 1);
+  EXPECT_EQ(symbols.Intern("A"), 0);
+  EXPECT_EQ(symbols.Intern("AB"), 2);
+  EXPECT_EQ(symbols.Size(), 3);
+  EXPECT_EQ(symbols.GetName(0), "A");
+  EXPECT_EQ(symbols.GetName(1), "B");
+  EXPECT_EQ(symbols.GetName(2), "AB");
+  EXPECT_EQ(symbols.Find("B"), 1);
+  EXPECT_FALSE(symbols.Find("C").has_value());
+}
+
+TEST(SymbolTableTest, Clear) {
+  kero::peg::SymbolTable symbols;
+  symbols.Intern("A");
+  symbols.Intern("B");
+  symbols.Clear();
+  EXPECT_EQ(symbols.Size(), 0);
+  EXPECT_EQ(symbols.Intern("B"), 0);
+}
+
+TEST(SymbolTableTest, Grow) {
+  kero::peg::SymbolTable symbols;
+  auto names = std::vector<std::string>{};
+  for (size_t i{}; i < 1000; ++i) {
+    names.push_back("Rule" + std::to_string(i));
+  }
+  for (size_t i{}; i < names.size(); ++i) {
+    EXPECT_EQ(symbols.Intern(names[i]), i);
+  }
+  for (size_t i{}; i < names.size(); ++i) {
+    EXPECT_EQ(symbols.Find(names[i]), i);
+    EXPECT_EQ(symbols.GetName(static_cast<uint32_t>(i)), names[i]);
+  }
+  EXPECT_EQ(symbols.Size(), names.size());
+}
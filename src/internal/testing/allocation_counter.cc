@@ -0,0 +1,41 @@
+#include "./allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local size_t allocation_count{};
+
+} // namespace
+
+// Defined apart from the code under test, so the compiler cannot inline the
+// malloc and free behind them into call sites and mistake them for a
+// mismatched pair.
+auto operator new(const size_t size) -> void* {
+  ++allocation_count;
+  if (auto ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+auto operator delete(void* ptr) noexcept -> void { std::free(ptr); }
+
+auto operator delete(void* ptr, const size_t) noexcept -> void {
+  std::free(ptr);
+}
+
+namespace kero {
+namespace peg {
+
+AllocationCounter::AllocationCounter() noexcept : start_{allocation_count} {}
+
+auto AllocationCounter::GetCount() const noexcept -> size_t {
+  return allocation_count - start_;
+}
+
+auto AllocationCounter::Reset() noexcept -> void { start_ = allocation_count; }
+
+} // namespace peg
+} // namespace kero
@@ -0,0 +1,34 @@
+#ifndef KERO_PEG_INTERNAL_TESTING_ALLOCATION_COUNTER_H
+#define KERO_PEG_INTERNAL_TESTING_ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+namespace kero {
+namespace peg {
+
+// Counts the calls of global operator new on this thread while it is alive.
+//
+// allocation_counter.cc replaces global operator new and delete to do the
+// counting, which affects every allocation of the binary it is linked into,
+// so only dedicated test and benchmark targets link it.
+class AllocationCounter {
+public:
+  AllocationCounter() noexcept;
+  ~AllocationCounter() noexcept = default;
+
+  AllocationCounter(const AllocationCounter&) = delete;
+  auto operator=(const AllocationCounter&) -> AllocationCounter& = delete;
+
+  // Allocations since construction or the last Reset.
+  auto GetCount() const noexcept -> size_t;
+
+  auto Reset() noexcept -> void;
+
+private:
+  size_t start_;
+};
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_TESTING_ALLOCATION_COUNTER_H
@@ -0,0 +1,27 @@
+#include "./grammar.h"
+
+#include "../lexer.h"
+
+namespace kero {
+namespace peg {
+
+ParsedGrammar::ParsedGrammar(const std::string_view source) noexcept {
+  auto parser{ast::Parser{Lexer{source}}};
+  auto res = parser.ParseRuleSet();
+  if (res.IsOk()) {
+    rule_set_ = static_cast<const ast::RuleSet*>(res.Ok()->ToNode(arena_));
+  }
+}
+
+auto MakeCsv(const size_t line_count, const char terminator) noexcept
+    -> std::string {
+  std::string input;
+  for (size_t i{}; i < line_count; ++i) {
+    input += "id" + std::to_string(i) + ",\"Name, Quoted\",3.25,plain text";
+    input += terminator;
+  }
+  return input;
+}
+
+} // namespace peg
+} // namespace kero
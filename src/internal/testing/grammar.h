@@ -0,0 +1,53 @@
+#ifndef KERO_PEG_INTERNAL_TESTING_GRAMMAR_H
+#define KERO_PEG_INTERNAL_TESTING_GRAMMAR_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "../arena.h"
+#include "../ast.h"
+
+namespace kero {
+namespace peg {
+
+// Owns a grammar parsed from source and lowered to a RuleSet, for tests and
+// benchmarks.
+class ParsedGrammar {
+public:
+  explicit ParsedGrammar(const std::string_view source) noexcept;
+  ~ParsedGrammar() noexcept = default;
+
+  ParsedGrammar(const ParsedGrammar&) = delete;
+  auto operator=(const ParsedGrammar&) -> ParsedGrammar& = delete;
+
+  // False if `source` did not parse, in which case there is no RuleSet.
+  auto IsOk() const noexcept -> bool { return rule_set_ != nullptr; }
+
+  auto GetRuleSet() const noexcept -> const ast::RuleSet& {
+    return *rule_set_;
+  }
+
+  // The arena owning the RuleSet, for passes that build more nodes.
+  auto GetArena() noexcept -> Arena& { return arena_; }
+
+private:
+  Arena arena_;
+  const ast::RuleSet* rule_set_{};
+};
+
+// A CSV grammar whose File rule matches MakeCsv(n).
+constexpr std::string_view kCsvGrammar =
+    "File <- Line* !.\n"
+    "Line <- Field (',' Field)* [\n]\n"
+    "Field <- '\"' (!'\"' .)* '\"' / [a-zA-Z0-9_ .]*\n";
+
+// `line_count` CSV records of a plain, a quoted and a numeric field, each
+// ended by `terminator`.
+auto MakeCsv(size_t line_count, char terminator = '\n') noexcept
+    -> std::string;
+
+} // namespace peg
+} // namespace kero
+
+#endif // KERO_PEG_INTERNAL_TESTING_GRAMMAR_H
@@ -0,0 +1,122 @@
+// Generates a C++ parser from a grammar file, see src/internal/codegen.h.
+//
+//   kero_peg_codegen --grammar=g.peg --header=out/g.h --source=out/g.cc
+//       --namespace=my::grammar --include=out/g.h
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "internal/arena.h"
+#include "internal/ast.h"
+#include "internal/codegen.h"
+#include "internal/lexer.h"
+
+namespace {
+
+auto ReadFile(const std::string& path, std::string& contents) noexcept
+    -> bool {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    return false;
+  }
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  contents = buffer.str();
+  return true;
+}
+
+auto WriteFile(const std::string& path, const std::string_view contents)
+    noexcept -> bool {
+  std::ofstream file{path, std::ios::binary};
+  file << contents;
+  return static_cast<bool>(file);
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+  std::string grammar_path;
+  std::string header_path;
+  std::string source_path;
+  std::string name_space;
+  std::string include_path;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+    const auto flag = [arg](const std::string_view name,
+                            std::string& value) noexcept {
+      if (!arg.starts_with(name) || arg.substr(name.size(), 1) != "=") {
+        return false;
+      }
+      value = arg.substr(name.size() + 1);
+      return true;
+    };
+    if (!flag("--grammar", grammar_path) && !flag("--header", header_path) &&
+        !flag("--source", source_path) && !flag("--namespace", name_space) &&
+        !flag("--include", include_path)) {
+      std::cerr << "unknown flag: " << arg << "\n";
+      return 2;
+    }
+  }
+  if (grammar_path.empty() || header_path.empty() || source_path.empty() ||
+      name_space.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " --grammar=<file> --header=<file> --source=<file>"
+                 " --namespace=<ns> [--include=<path>]\n";
+    return 2;
+  }
+  if (include_path.empty()) {
+    include_path = header_path;
+  }
+
+  std::string grammar;
+  if (!ReadFile(grammar_path, grammar)) {
+    std::cerr << grammar_path << ": cannot read\n";
+    return 1;
+  }
+
+  auto parser{kero::peg::ast::Parser{kero::peg::Lexer{grammar}}};
+  auto tree = parser.ParseRuleSet();
+  if (tree.IsErr()) {
+    const auto error = *tree.Err();
+    std::cerr << grammar_path << ": " << error.error_code;
+    if (const auto token = std::get_if<kero::peg::Token>(&error.value)) {
+      std::cerr << " at " << *token;
+    } else if (const auto tokenize_error =
+                   std::get_if<kero::peg::TokenizeError>(&error.value)) {
+      std::cerr << " " << *tokenize_error;
+    }
+    std::cerr << "\n";
+    return 1;
+  }
+
+  kero::peg::Arena arena;
+  const auto& rule_set =
+      static_cast<const kero::peg::ast::RuleSet&>(*tree.Ok()->ToNode(arena));
+  auto generated = kero::peg::GenerateParser(
+      rule_set, kero::peg::CodegenOptions{name_space, include_path,
+                                          grammar_path});
+  if (generated.IsErr()) {
+    const auto error = *generated.Err();
+    const auto& rule = static_cast<const kero::peg::ast::Rule&>(
+        *rule_set.GetRules()[error.rule_index]);
+    std::cerr << grammar_path << ": " << error.code << " in rule "
+              << static_cast<const kero::peg::ast::NonTerminal&>(
+                     *rule.GetNonTerminal())
+                     .GetName()
+              << "\n";
+    return 1;
+  }
+
+  const auto files = *generated.Ok();
+  if (!WriteFile(header_path, files.header) ||
+      !WriteFile(source_path, files.source)) {
+    std::cerr << "cannot write " << header_path << " or " << source_path
+              << "\n";
+    return 1;
+  }
+  return 0;
+}